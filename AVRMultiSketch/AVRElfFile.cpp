@@ -27,9 +27,13 @@
 //
 
 #include "AVRElfFile.h"
+#include "BuildTrace.h"
+#include <algorithm>
+#include <string.h>
 
 /******************************** AVRElfFile **********************************/
 AVRElfFile::AVRElfFile(void)
+	: mLongInstructionsDecoded(false)
 {
 }
 
@@ -79,19 +83,20 @@ bool AVRElfFile::GetVectorIndexes(
 		// Get the symbol address of __bad_interrupt
 		const SSymbolTblEntry*	symTableEntry = NULL;
 		uint8_t*	symbolValuePtr = GetSymbolValuePtr("__bad_interrupt", &symTableEntry);
-		uint8_t*	textSectMem = GetTextPtr();
 		if (symbolValuePtr && symTableEntry)
 		{
-			uint32_t	jmpBadInterrupt = JmpInstructionFor(symTableEntry->value);
-			// Now jmpBadInterrupt can be used to scan for implemented vectors.
-			// (anything that isn't jmpBadInterrupt)
-			uint32_t*	vector = (uint32_t*)textSectMem;
+			uint32_t	badInterruptAddress = symTableEntry->value;
+			// Now badInterruptAddress can be used to scan for implemented vectors.
+			// (anything that doesn't jump to badInterruptAddress)
+			uint16_t*	vector = (uint16_t*)GetTextPtr();
+			uint16_t*	vectorEnd = GetCodeStart();
 			uint32_t vectorIndex = 1;
 			// Loop as long as the instruction is jmp
 			// (not 100% bulletproof, but close enough)
-			for (; (vector[vectorIndex] & 0xFE0E) == 0x940C; vectorIndex++)
+			for (vector += 2; vector < vectorEnd &&
+				AVRInstructionIterator::Decode(*vector) == AVRInstructionIterator::eJMP; vector += 2, vectorIndex++)
 			{
-				if (vector[vectorIndex] != jmpBadInterrupt)
+				if (AVRInstructionIterator::JmpAddressFor(vector) != badInterruptAddress)
 				{
 					//fprintf(stderr, "%d ", vectorIndex);
 					outVectorIndexes.Set(vectorIndex, vectorIndex);
@@ -104,65 +109,788 @@ bool AVRElfFile::GetVectorIndexes(
 	return(success);
 }
 
-/***************************** ReplaceTextAddress *****************************/
+/******************************** GetCodeStart ********************************/
 /*
-*	Replaces opcodes LDS and STS that reference inSymbolName with inNewAddress.
-*	When the address is hit in the code, the opcode preceding it is checked to
-*	see if it's an LDS or STS opcode.  If it is, the address it's replaced and the
-*	next N opcodes are checked for increments of inSymbolName's address, where
-*	N is the width of the value pointed to by the address.
+*	Returns the start of the code that follows the vector table and any
+*	progmem data in .text.  The avr-libc linker scripts place the progmem data
+*	and constructor tables after the vector table, followed by the init code
+*	that starts at __dtors_end.  If the symbols used to locate the start of the
+*	code don't exist, the start of .text is returned.
+*/
+uint16_t* AVRElfFile::GetCodeStart(void)
+{
+	static const char* const kCodeStartSymbols[] = {"__dtors_end", "__ctors_end"};
+	SSectEntry*	textSectEntry =	GetSectEntry(eText);
+	uint8_t*	codeStart = GetTextPtr();
+	for (uint32_t i = 0; i < sizeof(kCodeStartSymbols)/sizeof(char*); i++)
+	{
+		const SSymbolTblEntry*	symbolTblEntry = FindSymbol(kCodeStartSymbols[i]);
+		if (symbolTblEntry &&
+			symbolTblEntry->value >= textSectEntry->addrInMem &&
+			symbolTblEntry->value < textSectEntry->addrInMem + textSectEntry->size)
+		{
+			codeStart += ((symbolTblEntry->value - textSectEntry->addrInMem) & ~1);
+			break;
+		}
+	}
+	return((uint16_t*)codeStart);
+}
+
+/********************************** FreeMem ***********************************/
+/*
+*	ReadFile calls FreeMem, so the instructions decoded from the previous file
+*	are never used for the next one.
+*/
+void AVRElfFile::FreeMem(void)
+{
+	ElfFile::FreeMem();
+	mLongInstructions.clear();
+	mLongInstructionsDecoded = false;
+}
+
+/**************************** GetLongInstructions *****************************/
+/*
+*	Returns the .text word offsets of every two word instruction in the code.
+*	The code is only decoded once per file.
+*/
+const std::vector<uint32_t>& AVRElfFile::GetLongInstructions(void)
+{
+	if (!mLongInstructionsDecoded &&
+		mContent != NULL)
+	{
+		mLongInstructionsDecoded = true;
+		SSectEntry*	textSectEntry =	GetSectEntry(eText);
+		uint16_t*	textSectPtr = (uint16_t*)GetTextPtr();
+		AVRInstructionIterator	itr(GetCodeStart(), &textSectPtr[textSectEntry->size/2]);
+		while (itr.Next())
+		{
+			mLongInstructions.push_back((uint32_t)(itr.GetInstruction() - textSectPtr));
+		}
+	}
+	return(mLongInstructions);
+}
+
+/******************************* ReplaceAddress *******************************/
+/*
+*	Replaces the address of inSymbolName referenced by LDS and STS opcodes with
+*	inNewAddress.  See ReplaceAddresses.
+*	Returns the number of references replaced.
 */
 uint32_t AVRElfFile::ReplaceAddress(
 	const char*	inSymbolName,
 	uint16_t	inNewAddress)
+{
+	SAddressReplacement	replacement = {inSymbolName, inNewAddress};
+	return(ReplaceAddresses(&replacement, 1));
+}
+
+/****************************** ReplaceAddresses ******************************/
+/*
+*	Replaces the addresses of all of the symbols in inReplacements in a single
+*	pass of the relocations (or of the .text section.)  Symbols that don't exist in this file are
+*	ignored.  The width of each symbol is taken from its symbol table entry.
+*	Returns the number of operands replaced.
+*/
+uint32_t AVRElfFile::ReplaceAddresses(
+	const SAddressReplacement	inReplacements[],
+	uint32_t					inNumReplacements)
+{
+	AVRAddressMap	addressMap;
+	for (uint32_t i = 0; i < inNumReplacements; i++)
+	{
+		const SSymbolTblEntry*	symbolTblEntry = FindSymbol(inReplacements[i].symbolName);
+		if (symbolTblEntry)
+		{
+			addressMap.Insert((uint16_t)symbolTblEntry->value,
+				inReplacements[i].newAddress, symbolTblEntry->size);
+		}
+	}
+	return(addressMap.Empty() ? 0 : ReplaceAddresses(addressMap));
+}
+
+/****************************** ReplaceAddresses ******************************/
+/*
+*	Redirects references to the addresses in inAddressMap.  If the file was
+*	linked with --emit-relocs every reference is found using the relocations,
+*	otherwise only the operands of LDS and STS instructions are replaced.
+*/
+uint32_t AVRElfFile::ReplaceAddresses(
+	const AVRAddressMap&	inAddressMap)
+{
+	BuildSpan	span("ReplaceAddresses");
+	return(HasRelocations() ? RetargetRelocations(inAddressMap) :
+								ReplaceOperands(inAddressMap));
+}
+
+/****************************** ReplaceOperands *******************************/
+/*
+*	Replaces the operands of LDS and STS instructions found in inAddressMap.
+*	Only the code is examined, instruction by instruction, so progmem data that
+*	happens to look like an LDS or STS isn't touched.  JMP and CALL operands
+*	are flash addresses so they're skipped.
+*	Returns the number of operands replaced.
+*/
+uint32_t AVRElfFile::ReplaceOperands(
+	const AVRAddressMap&	inAddressMap)
 {
 	uint32_t	numAddressesReplaced = 0;
-	const SSymbolTblEntry*	symbolTblEntry = NULL;
-	GetSymbolValuePtr(inSymbolName, &symbolTblEntry);
-	if (symbolTblEntry)
+	if (mContent != NULL)
 	{
-		SSectEntry*	textSectEntry =	GetSectEntry(eText);
-		if (textSectEntry)
+		uint16_t*	textSectPtr = (uint16_t*)GetTextPtr();
+		const std::vector<uint32_t>&	longInstructions = GetLongInstructions();
+		std::vector<uint32_t>::const_iterator	itr = longInstructions.begin();
+		std::vector<uint32_t>::const_iterator	itrEnd = longInstructions.end();
+		uint16_t	newAddress;
+		for (; itr != itrEnd; ++itr)
 		{
-			uint16_t	oldAddress = symbolTblEntry->value;
-			uint32_t	valueSize = symbolTblEntry->size;
-			uint16_t*	textSectPtr = (uint16_t*)&mContent[GetSectEntry(eText)->offset];
-			uint16_t*	textSectEnd = &textSectPtr[textSectEntry->size/2];
-			for (; textSectPtr < textSectEnd; textSectPtr++)
+			uint16_t*	instruction = &textSectPtr[*itr];
+			AVRInstructionIterator::EOpcode	opcode = AVRInstructionIterator::Decode(instruction[0]);
+			if ((opcode == AVRInstructionIterator::eLDS ||
+				opcode == AVRInstructionIterator::eSTS) &&
+				inAddressMap.Lookup(instruction[1], newAddress))
 			{
-				if (*textSectPtr != oldAddress)
+				instruction[1] = newAddress;
+				MarkDirty(&instruction[1], sizeof(uint16_t));
+				numAddressesReplaced++;
+			}
+		}
+	}
+	return(numAddressesReplaced);
+}
+
+/**************************** RetargetRelocations *****************************/
+/*
+*	Makes a single pass of the relocations of the allocated sections.  Any
+*	relocation whose value (symbol + addend) is an SRAM address in inAddressMap
+*	is reapplied with the new address.  This finds every kind of reference the
+*	compiler generates: LDS/STS operands, lo8/hi8 LDI pairs used to load a
+*	pointer register for LD/LDD/ST/STD, and pointers initialized in .data.
+*	Because relocations against a section symbol plus an offset are resolved
+*	to the address, the symbol used by the relocation doesn't matter.
+*
+*	Each retargeted relocation is changed to an absolute relocation (symbol 0)
+*	of the new address so that Rebase leaves the reference where it is.
+*	Note that an address one past the end of a variable (e.g. the end of a loop
+*	over an array) isn't in inAddressMap so it isn't retargeted.
+*	Returns the number of relocations retargeted.
+*/
+uint32_t AVRElfFile::RetargetRelocations(
+	const AVRAddressMap&	inAddressMap)
+{
+	uint32_t	numRetargeted = 0;
+	uint32_t	numSymbols;
+	const SSymbolTblEntry*	symbolTable = GetSymbolTable(numSymbols);
+	const SSectEntry*	symTabSectEntry = GetSectEntry(eSymbolTable);
+	for (uint32_t shndx = 0; symbolTable && shndx < mNumSectEntries; shndx++)
+	{
+		const SSectEntry*	relaSectEntry = &mSectTable[shndx];
+		const SSectEntry*	targetSectEntry = GetSectEntryByIndex(relaSectEntry->info);
+		if (relaSectEntry->type != eSHT_RELA ||
+			!targetSectEntry ||
+			(targetSectEntry->flags & eSHF_ALLOC) == 0 ||
+			targetSectEntry->type == eSHT_NOBITS ||
+			relaSectEntry->entrySize != sizeof(SRelaEntry) ||
+			relaSectEntry->link != (uint32_t)(symTabSectEntry - mSectTable))
+		{
+			continue;
+		}
+		SRelaEntry*	relaEntry = (SRelaEntry*)&mContent[relaSectEntry->offset];
+		SRelaEntry*	relaEnd = &relaEntry[relaSectEntry->size/sizeof(SRelaEntry)];
+		for (; relaEntry < relaEnd; relaEntry++)
+		{
+			uint32_t	type = relaEntry->info & 0xFF;
+			uint32_t	symbolIndex = relaEntry->info >> 8;
+			uint32_t	placeOffset = relaEntry->offset - targetSectEntry->addrInMem;
+			uint32_t	size = RelocationSize(type);
+			if (type == eR_AVR_NONE ||
+				(type >= eR_AVR_DIFF8 && type <= eR_AVR_DIFF32) ||
+				symbolIndex >= numSymbols ||
+				placeOffset >= targetSectEntry->size ||
+				size > targetSectEntry->size - placeOffset)
+			{
+				continue;
+			}
+			uint32_t	value = symbolTable[symbolIndex].value + relaEntry->addend;
+			uint16_t	newAddress;
+			if (value >= kDataSpaceStart && value < kEEPROMSpaceStart &&
+				inAddressMap.Lookup((uint16_t)value, newAddress))
+			{
+				uint8_t*	place = &mContent[targetSectEntry->offset + placeOffset];
+				int32_t	newValue = kDataSpaceStart + newAddress;
+				if (ApplyRelocation(type, place, relaEntry->offset, newValue))
 				{
-					continue;
+					MarkDirty(place, size);
+					relaEntry->info = type;
+					relaEntry->addend = newValue;
+					MarkDirty(relaEntry, sizeof(SRelaEntry));
+					numRetargeted++;
 				}
-				uint16_t	opcode = textSectPtr[-1] & 0xFE0F;
-				switch(opcode)
+			}
+		}
+	}
+	return(numRetargeted);
+}
+
+/******************************* GetFlashChunks *******************************/
+/*
+*	Returns the content of every loadable section other than .eeprom at its
+*	load address.  The same content avr-objcopy -O ihex -R .eeprom outputs.
+*/
+void AVRElfFile::GetFlashChunks(
+	HexChunks&	outChunks)
+{
+	outChunks.clear();
+	for (uint32_t i = 0; i < mNumSectEntries; i++)
+	{
+		const SSectEntry*	sectEntry = &mSectTable[i];
+		if ((sectEntry->flags & eSHF_ALLOC) &&
+			sectEntry->type != eSHT_NOBITS &&
+			sectEntry->type != eSHT_NULL &&
+			sectEntry->size &&
+			strcmp(GetSectName(sectEntry), ".eeprom") != 0)
+		{
+			SHexChunk	chunk = {GetSectLoadAddress(sectEntry), &mContent[sectEntry->offset], sectEntry->size};
+			outChunks.push_back(chunk);
+		}
+	}
+}
+
+/****************************** GetEEPROMChunks *******************************/
+/*
+*	Returns the content of .eeprom, if any, at address 0.  The same content
+*	avr-objcopy -O ihex -j .eeprom --set-section-flags=.eeprom=alloc,load
+*	--change-section-lma .eeprom=0 outputs.
+*/
+void AVRElfFile::GetEEPROMChunks(
+	HexChunks&	outChunks)
+{
+	outChunks.clear();
+	const SSectEntry*	sectEntry = GetSectEntry(".eeprom");
+	if (sectEntry &&
+		sectEntry->type != eSHT_NOBITS &&
+		sectEntry->size)
+	{
+		SHexChunk	chunk = {0, &mContent[sectEntry->offset], sectEntry->size};
+		outChunks.push_back(chunk);
+	}
+}
+
+/******************************** WriteHexFile ********************************/
+/*
+*	Writes the flash content to inPath as Intel HEX.  The output is identical
+*	to that of the recipe.objcopy.hex.pattern recipe.
+*/
+bool AVRElfFile::WriteHexFile(
+	const char*	inPath)
+{
+	bool	success = false;
+	if (mContent != NULL)
+	{
+		IntelHexWriter	hexWriter;
+		HexChunks		chunks;
+		GetFlashChunks(chunks);
+		hexWriter.AddChunks(chunks);
+		hexWriter.SetStartAddress(GetEntryPoint());
+		success = hexWriter.WriteFile(inPath);
+	}
+	return(success);
+}
+
+/******************************** WriteEepFile ********************************/
+/*
+*	Writes the EEPROM content to inPath as Intel HEX.  The output is identical
+*	to that of the recipe.objcopy.eep.pattern recipe.
+*/
+bool AVRElfFile::WriteEepFile(
+	const char*	inPath)
+{
+	bool	success = false;
+	if (mContent != NULL)
+	{
+		IntelHexWriter	hexWriter;
+		HexChunks		chunks;
+		GetEEPROMChunks(chunks);
+		hexWriter.AddChunks(chunks);
+		hexWriter.SetStartAddress(GetEntryPoint());
+		success = hexWriter.WriteFile(inPath);
+	}
+	return(success);
+}
+
+/******************************* HasRelocations *******************************/
+bool AVRElfFile::HasRelocations(void)
+{
+	bool	hasRelocations = false;
+	for (uint32_t shndx = 0; !hasRelocations && shndx < mNumSectEntries; shndx++)
+	{
+		const SSectEntry*	relaSectEntry = &mSectTable[shndx];
+		const SSectEntry*	targetSectEntry = GetSectEntryByIndex(relaSectEntry->info);
+		hasRelocations = relaSectEntry->type == eSHT_RELA &&
+			targetSectEntry && (targetSectEntry->flags & eSHF_ALLOC) != 0;
+	}
+	return(hasRelocations);
+}
+
+/******************************** SymbolDelta *********************************/
+/*
+*	Returns the distance the symbol moves when rebased.  Absolute symbols don't
+*	move, other than the flash addresses of the .data initializers, which are
+*	defined by the linker script outside of any section.
+*/
+int32_t AVRElfFile::SymbolDelta(
+	const SSymbolTblEntry*	inSymTblEntry,
+	int32_t					inTextDelta,
+	int32_t					inDataDelta)
+{
+	int32_t	delta = 0;
+	if (inSymTblEntry->shndx == eSHN_ABS)
+	{
+		const char*	name = GetSymbolName(inSymTblEntry);
+		if (strcmp(name, "__data_load_start") == 0 ||
+			strcmp(name, "__data_load_end") == 0)
+		{
+			delta = inTextDelta;
+		}
+	} else if (inSymTblEntry->shndx != eSHN_UNDEF &&
+		inSymTblEntry->shndx < eSHN_LORESERVE)
+	{
+		const SSectEntry*	sectEntry = GetSectEntryByIndex(inSymTblEntry->shndx);
+		if (sectEntry &&
+			(sectEntry->flags & eSHF_ALLOC) != 0)
+		{
+			delta = AddressDelta(inSymTblEntry->value, inTextDelta, inDataDelta);
+		}
+	}
+	return(delta);
+}
+
+/********************************** Relocate **********************************/
+/*
+*	Applies every relocation of the loaded sections using the moved symbol and
+*	place addresses.  If !inApply, nothing is modified, each relocation is only
+*	checked to make sure it reproduces the current content and that the moved
+*	value is in range.
+*/
+bool AVRElfFile::Relocate(
+	int32_t	inTextDelta,
+	int32_t	inDataDelta,
+	bool	inApply)
+{
+	bool	success = true;
+	uint32_t	numSymbols;
+	const SSymbolTblEntry*	symbolTable = GetSymbolTable(numSymbols);
+	for (uint32_t shndx = 0; success && shndx < mNumSectEntries; shndx++)
+	{
+		const SSectEntry*	relaSectEntry = &mSectTable[shndx];
+		const SSectEntry*	targetSectEntry = GetSectEntryByIndex(relaSectEntry->info);
+		if (relaSectEntry->type != eSHT_RELA ||
+			!targetSectEntry ||
+			(targetSectEntry->flags & eSHF_ALLOC) == 0)
+		{
+			continue;
+		}
+		success = targetSectEntry->type != eSHT_NOBITS &&
+			relaSectEntry->entrySize == sizeof(SRelaEntry) &&
+			relaSectEntry->link == (uint32_t)(GetSectEntry(eSymbolTable) - mSectTable);
+		SRelaEntry*	relaEntry = (SRelaEntry*)&mContent[relaSectEntry->offset];
+		SRelaEntry*	relaEnd = &relaEntry[relaSectEntry->size/sizeof(SRelaEntry)];
+		for (; success && relaEntry < relaEnd; relaEntry++)
+		{
+			uint32_t	type = relaEntry->info & 0xFF;
+			uint32_t	symbolIndex = relaEntry->info >> 8;
+			uint32_t	placeOffset = relaEntry->offset - targetSectEntry->addrInMem;
+			uint32_t	size = RelocationSize(type);
+			success = symbolIndex < numSymbols &&
+				placeOffset < targetSectEntry->size &&
+				size <= targetSectEntry->size - placeOffset;
+			if (success)
+			{
+				const SSymbolTblEntry*	symTblEntry = &symbolTable[symbolIndex];
+				uint8_t*	place = &mContent[targetSectEntry->offset + placeOffset];
+				int32_t	value = symTblEntry->value + relaEntry->addend;
+				int32_t	newValue = value + SymbolDelta(symTblEntry, inTextDelta, inDataDelta);
+				uint32_t	newPlaceAddress = relaEntry->offset + AddressDelta(relaEntry->offset, inTextDelta, inDataDelta);
+				if (inApply)
 				{
-					case 0x9000:	// LDS
-					case 0x9200:	// STS
-					{
-						*textSectPtr = inNewAddress;
-						numAddressesReplaced++;
-						for (uint32_t k = 1; k < valueSize; k++)
-						{
-							textSectPtr+=2;
-							if (*textSectPtr == oldAddress + k)
-							{
-								opcode = textSectPtr[-1] & 0xFE0F;
-								if (opcode == 0x9000 ||
-									opcode == 0x9200)
-								{
-									*textSectPtr = inNewAddress + k;
-									continue;
-								}
-							}
-							break;
-						}
-						break;
-					}
+					ApplyRelocation(type, place, newPlaceAddress, newValue);
+					MarkDirty(place, size);
+					relaEntry->offset = newPlaceAddress;
+				} else
+				{
+					uint8_t	scratch[4];
+					memcpy(scratch, place, size);
+					success = ApplyRelocation(type, scratch, relaEntry->offset, value) &&
+						memcmp(scratch, place, size) == 0 &&
+						ApplyRelocation(type, scratch, newPlaceAddress, newValue);
 				}
 			}
 		}
+		if (inApply)
+		{
+			MarkDirty(&mContent[relaSectEntry->offset], relaSectEntry->size);
+		}
 	}
-	return(numAddressesReplaced);
+	return(success);
+}
+
+/*********************************** Rebase ***********************************/
+bool AVRElfFile::Rebase(
+	uint32_t	inTextBase,
+	uint32_t	inDataBase)
+{
+	BuildSpan	span("Rebase");
+	SSectEntry*	textSectEntry = mContent ? GetSectEntry(eText) : NULL;
+	SSectEntry*	dataSectEntry = mContent ? GetSectEntry(eData) : NULL;
+	bool	success = textSectEntry && dataSectEntry && HasRelocations();
+	if (success)
+	{
+		int32_t	textDelta = inTextBase - textSectEntry->addrInMem;
+		int32_t	dataDelta = inDataBase - dataSectEntry->addrInMem;
+		/*
+		*	Check every relocation before applying any of them so that the file
+		*	is either completely rebased or left unchanged.
+		*/
+		success = Relocate(textDelta, dataDelta, false);
+		if (success)
+		{
+			Relocate(textDelta, dataDelta, true);
+			/*
+			*	The symbols are moved after the relocations because the
+			*	relocations are applied using the original symbol values.
+			*/
+			uint32_t	numSymbols;
+			SSymbolTblEntry*	symbolTable = GetSymbolTable(numSymbols);
+			for (uint32_t i = 0; i < numSymbols; i++)
+			{
+				symbolTable[i].value += SymbolDelta(&symbolTable[i], textDelta, dataDelta);
+			}
+			MarkDirty(symbolTable, numSymbols * sizeof(SSymbolTblEntry));
+			for (uint32_t shndx = 0; shndx < mNumSectEntries; shndx++)
+			{
+				if (mSectTable[shndx].flags & eSHF_ALLOC)
+				{
+					mSectTable[shndx].addrInMem += AddressDelta(mSectTable[shndx].addrInMem, textDelta, dataDelta);
+				}
+			}
+			MarkDirty(mSectTable, mNumSectEntries * sizeof(SSectEntry));
+			/*
+			*	The physical (load) address of the .data segment is in flash
+			*	so it moves with .text.
+			*/
+			for (uint32_t i = 0; i < mHeader->numProgEntries; i++)
+			{
+				SProgEntry*	progEntry = GetProgEntry(i);
+				progEntry->virtualAddr += AddressDelta(progEntry->virtualAddr, textDelta, dataDelta);
+				progEntry->physicalAddr += AddressDelta(progEntry->physicalAddr, textDelta, dataDelta);
+				MarkDirty(progEntry, sizeof(SProgEntry));
+			}
+			mHeader->entryPoint += AddressDelta(mHeader->entryPoint, textDelta, dataDelta);
+			MarkDirty(mHeader, sizeof(SElfHeader));
+		}
+	}
+	return(success);
+}
+
+/******************************* RelocationSize *******************************/
+uint32_t AVRElfFile::RelocationSize(
+	uint32_t	inType)
+{
+	uint32_t	size = 2;
+	switch (inType)
+	{
+		case eR_AVR_NONE:
+			size = 0;
+			break;
+		case eR_AVR_8:
+		case eR_AVR_8_LO8:
+		case eR_AVR_8_HI8:
+		case eR_AVR_8_HLO8:
+		case eR_AVR_DIFF8:
+			size = 1;
+			break;
+		case eR_AVR_32:
+		case eR_AVR_CALL:
+		case eR_AVR_DIFF32:
+		case eR_AVR_32_PCREL:
+			size = 4;
+			break;
+	}
+	return(size);
+}
+
+/****************************** ApplyRelocation *******************************/
+/*
+*	Encodes inValue (the symbol's address + the addend) at ioPlace the same
+*	way the linker does (see avr_final_link_relocate in binutils' elf32-avr.c.)
+*	inPlaceAddress is only used by the PC relative types.
+*/
+bool AVRElfFile::ApplyRelocation(
+	uint32_t	inType,
+	uint8_t*	ioPlace,
+	uint32_t	inPlaceAddress,
+	int32_t		inValue)
+{
+	bool	success = true;
+	int32_t	value = inValue;
+	uint16_t	word = ioPlace[0] | (ioPlace[1] << 8);
+	bool	isWord = true;	// Write word back to ioPlace
+	switch (inType)
+	{
+		case eR_AVR_NONE:
+		case eR_AVR_DIFF8:	// The difference of two addresses that move together
+		case eR_AVR_DIFF16:
+		case eR_AVR_DIFF32:
+			isWord = false;
+			break;
+		case eR_AVR_7_PCREL:
+			value -= inPlaceAddress + 2;
+			success = (value & 1) == 0 && value >= -126 && value <= 126;
+			word = (word & 0xFC07) | (((value >> 1) << 3) & 0x03F8);
+			break;
+		case eR_AVR_13_PCREL:
+			value -= inPlaceAddress + 2;
+			success = (value & 1) == 0;
+			value >>= 1;
+			success = success && value >= -4096 && value <= 4095;
+			word = (word & 0xF000) | (value & 0x0FFF);
+			break;
+		case eR_AVR_16:
+			word = value;
+			break;
+		case eR_AVR_16_PM:
+			word = (uint32_t)value >> 1;
+			break;
+		case eR_AVR_LO8_LDI_NEG:
+		case eR_AVR_HI8_LDI_NEG:
+		case eR_AVR_HH8_LDI_NEG:
+		case eR_AVR_MS8_LDI_NEG:
+			value = -value;
+			// fall through
+		case eR_AVR_LO8_LDI:
+		case eR_AVR_HI8_LDI:
+		case eR_AVR_HH8_LDI:
+		case eR_AVR_MS8_LDI:
+		{
+			uint32_t	shift = (inType == eR_AVR_LO8_LDI || inType == eR_AVR_LO8_LDI_NEG) ? 0 :
+				((inType == eR_AVR_HI8_LDI || inType == eR_AVR_HI8_LDI_NEG) ? 8 :
+				((inType == eR_AVR_HH8_LDI || inType == eR_AVR_HH8_LDI_NEG) ? 16 : 24));
+			value = ((uint32_t)value >> shift) & 0xFF;
+			word = (word & 0xF0F0) | (value & 0x0F) | ((value << 4) & 0x0F00);
+			break;
+		}
+		case eR_AVR_LO8_LDI_PM_NEG:
+		case eR_AVR_HI8_LDI_PM_NEG:
+		case eR_AVR_HH8_LDI_PM_NEG:
+			value = -value;
+			// fall through
+		case eR_AVR_LO8_LDI_PM:
+		case eR_AVR_HI8_LDI_PM:
+		case eR_AVR_HH8_LDI_PM:
+		case eR_AVR_LO8_LDI_GS:	// Same as PM when there are no stubs (< 128K)
+		case eR_AVR_HI8_LDI_GS:
+		{
+			success = (value & 1) == 0;
+			uint32_t	shift = (inType == eR_AVR_LO8_LDI_PM || inType == eR_AVR_LO8_LDI_PM_NEG ||
+				inType == eR_AVR_LO8_LDI_GS) ? 1 :
+				((inType == eR_AVR_HH8_LDI_PM || inType == eR_AVR_HH8_LDI_PM_NEG) ? 17 : 9);
+			value = ((uint32_t)value >> shift) & 0xFF;
+			word = (word & 0xF0F0) | (value & 0x0F) | ((value << 4) & 0x0F00);
+			break;
+		}
+		case eR_AVR_CALL:
+		{
+			success = (value & 1) == 0;
+			uint32_t	wordAddress = (uint32_t)value >> 1;
+			word = (word & 0xFE0E) | ((((wordAddress & 0x10000) | ((wordAddress << 3) & 0x1F00000))) >> 16);
+			ioPlace[2] = wordAddress;
+			ioPlace[3] = wordAddress >> 8;
+			break;
+		}
+		case eR_AVR_LDI:
+			success = value >= -128 && value <= 255;
+			value &= 0xFF;
+			word = (word & 0xF0F0) | (value & 0x0F) | ((value << 4) & 0x0F00);
+			break;
+		case eR_AVR_6:
+			success = value >= 0 && value <= 63;
+			word = (word & 0xD3F8) | (value & 7) | ((value & (3 << 3)) << 7) | ((value & (1 << 5)) << 8);
+			break;
+		case eR_AVR_6_ADIW:
+			success = value >= 0 && value <= 63;
+			word = (word & 0xFF30) | (value & 0x0F) | ((value & 0x30) << 2);
+			break;
+		case eR_AVR_8:
+		case eR_AVR_8_LO8:
+			ioPlace[0] = value;
+			isWord = false;
+			break;
+		case eR_AVR_8_HI8:
+			ioPlace[0] = (uint32_t)value >> 8;
+			isWord = false;
+			break;
+		case eR_AVR_8_HLO8:
+			ioPlace[0] = (uint32_t)value >> 16;
+			isWord = false;
+			break;
+		case eR_AVR_32_PCREL:
+			value -= inPlaceAddress;
+			// fall through
+		case eR_AVR_32:
+			word = value;
+			ioPlace[2] = (uint32_t)value >> 16;
+			ioPlace[3] = (uint32_t)value >> 24;
+			break;
+		case eR_AVR_LDS_STS_16:
+			success = (value & 0xFFFF) >= 0x40 && (value & 0xFFFF) <= 0xBF;
+			value &= 0x7F;
+			word = (word & 0xF8F0) | (value & 0x0F) | ((value & 0x30) << 5) | ((value & 0x40) << 2);
+			break;
+		case eR_AVR_PORT6:
+			success = (value & 0xFFFF) <= 0x3F;
+			word = (word & 0xF9F0) | ((value & 0x30) << 5) | (value & 0x0F);
+			break;
+		case eR_AVR_PORT5:
+			success = (value & 0xFFFF) <= 0x1F;
+			word = (word & 0xFF07) | ((value & 0x1F) << 3);
+			break;
+		default:
+			success = false;
+			isWord = false;
+			break;
+	}
+	if (isWord)
+	{
+		ioPlace[0] = word;
+		ioPlace[1] = word >> 8;
+	}
+	return(success);
+}
+
+#pragma mark - AVRInstructionIterator
+/*************************** AVRInstructionIterator ***************************/
+AVRInstructionIterator::AVRInstructionIterator(
+	uint16_t*	inStart,
+	uint16_t*	inEnd)
+	: mInstruction(inStart), mEnd(inEnd), mLength(0), mOpcode(eOther)
+{
+}
+
+/************************************ Next ************************************/
+/*
+*	Advances to the next two word instruction.  Returns eOther when the end
+*	is reached.
+*/
+AVRInstructionIterator::EOpcode AVRInstructionIterator::Next(void)
+{
+	mInstruction = FindLongOpcode(mInstruction + mLength, mEnd);
+	mLength = 0;
+	mOpcode = eOther;
+	if (mInstruction < mEnd)
+	{
+		if (&mInstruction[1] < mEnd)
+		{
+			mOpcode = Decode(*mInstruction);
+			mLength = 2;
+		} else
+		{
+			mInstruction = mEnd;
+		}
+	}
+	return(mOpcode);
+}
+
+/******************************* FindLongOpcode *******************************/
+/*
+*	Returns the first word in [inStart, inEnd) that is the opcode of a two word
+*	instruction, or inEnd if there isn't one.  inStart must be on an
+*	instruction boundary.  Because every word that doesn't match one of the two
+*	word opcode masks is a single word instruction, the first match is the next
+*	two word instruction.
+*/
+uint16_t* AVRInstructionIterator::FindLongOpcode(
+	uint16_t*	inStart,
+	uint16_t*	inEnd)
+{
+	uint16_t*	word = inStart;
+	for (; word < inEnd; word++)
+	{
+		if (Decode(*word) != eOther)
+		{
+			break;
+		}
+	}
+	return(word);
+}
+
+/******************************* JmpAddressFor ********************************/
+/*
+*	Returns the byte address of a JMP or CALL instruction.  The inverse of
+*	AVRElfFile::JmpInstructionFor.
+*/
+uint32_t AVRInstructionIterator::JmpAddressFor(
+	const uint16_t*	inInstruction)
+{
+	uint32_t	addressH = ((inInstruction[0] >> 3) & 0x3E) | (inInstruction[0] & 1);
+	return(((addressH << 16) | inInstruction[1]) << 1);
+}
+
+#pragma mark - AVRAddressMap
+/******************************* AVRAddressMap ********************************/
+AVRAddressMap::AVRAddressMap(void)
+{
+	memset(mFilter, 0, sizeof(mFilter));
 }
 
+/*********************************** Insert ***********************************/
+/*
+*	Maps each of the inSize bytes starting at inOldAddress to the corresponding
+*	byte starting at inNewAddress.  A size of 0 is treated as 1.
+*/
+void AVRAddressMap::Insert(
+	uint16_t	inOldAddress,
+	uint16_t	inNewAddress,
+	uint32_t	inSize)
+{
+	if (inSize == 0)
+	{
+		inSize = 1;
+	}
+	for (uint32_t k = 0; k < inSize; k++)
+	{
+		SAddressPair	pair = {(uint16_t)(inOldAddress + k), (uint16_t)(inNewAddress + k)};
+		AddressPairs::iterator	itr = std::lower_bound(mPairs.begin(), mPairs.end(), pair,
+			[](const SAddressPair& inA, const SAddressPair& inB)
+				{return(inA.oldAddress < inB.oldAddress);});
+		if (itr != mPairs.end() &&
+			itr->oldAddress == pair.oldAddress)
+		{
+			itr->newAddress = pair.newAddress;
+		} else
+		{
+			mPairs.insert(itr, pair);
+		}
+		mFilter[pair.oldAddress >> 3] |= (1 << (pair.oldAddress & 7));
+	}
+}
+
+/*********************************** Lookup ***********************************/
+bool AVRAddressMap::Lookup(
+	uint16_t	inOldAddress,
+	uint16_t&	outNewAddress) const
+{
+	bool	found = false;
+	if (MayContain(inOldAddress))
+	{
+		SAddressPair	pair = {inOldAddress, 0};
+		AddressPairs::const_iterator	itr = std::lower_bound(mPairs.begin(), mPairs.end(), pair,
+			[](const SAddressPair& inA, const SAddressPair& inB)
+				{return(inA.oldAddress < inB.oldAddress);});
+		if (itr != mPairs.end() &&
+			itr->oldAddress == inOldAddress)
+		{
+			outNewAddress = itr->newAddress;
+			found = true;
+		}
+	}
+	return(found);
+}
@@ -30,6 +30,7 @@
 #define AVRElfFile_h
 
 #include "ElfFile.h"
+#include "IntelHexWriter.h"
 #include "IndexVec.h"
 
 // The following struct was copied from:
@@ -68,6 +69,146 @@ struct SAVRDeviceInfo
 	} avr;
 };
 #endif
+
+// AVR relocation types (R_AVR_xxx)
+enum EAVRRelocType
+{
+	eR_AVR_NONE,
+	eR_AVR_32,
+	eR_AVR_7_PCREL,
+	eR_AVR_13_PCREL,
+	eR_AVR_16,
+	eR_AVR_16_PM,
+	eR_AVR_LO8_LDI,
+	eR_AVR_HI8_LDI,
+	eR_AVR_HH8_LDI,
+	eR_AVR_LO8_LDI_NEG,
+	eR_AVR_HI8_LDI_NEG,
+	eR_AVR_HH8_LDI_NEG,
+	eR_AVR_LO8_LDI_PM,
+	eR_AVR_HI8_LDI_PM,
+	eR_AVR_HH8_LDI_PM,
+	eR_AVR_LO8_LDI_PM_NEG,
+	eR_AVR_HI8_LDI_PM_NEG,
+	eR_AVR_HH8_LDI_PM_NEG,
+	eR_AVR_CALL,
+	eR_AVR_LDI,
+	eR_AVR_6,
+	eR_AVR_6_ADIW,
+	eR_AVR_MS8_LDI,
+	eR_AVR_MS8_LDI_NEG,
+	eR_AVR_LO8_LDI_GS,
+	eR_AVR_HI8_LDI_GS,
+	eR_AVR_8,
+	eR_AVR_8_LO8,
+	eR_AVR_8_HI8,
+	eR_AVR_8_HLO8,
+	eR_AVR_DIFF8,
+	eR_AVR_DIFF16,
+	eR_AVR_DIFF32,
+	eR_AVR_LDS_STS_16,
+	eR_AVR_PORT6,
+	eR_AVR_PORT5,
+	eR_AVR_32_PCREL
+};
+
+struct SAddressReplacement
+{
+	const char*	symbolName;
+	uint16_t	newAddress;
+};
+
+struct SAddressPair
+{
+	uint16_t	oldAddress;
+	uint16_t	newAddress;
+};
+typedef std::vector<SAddressPair> AddressPairs;
+
+/*
+*	Maps the SRAM addresses of one or more variables to replacement addresses.
+*	Every byte of a multi-byte variable is mapped, so an access to any byte of
+*	the variable, in any order, is found.  The bit filter lets the vast
+*	majority of operands that aren't in the map be rejected with a single test.
+*/
+class AVRAddressMap
+{
+public:
+							AVRAddressMap(void);
+	void					Insert(
+								uint16_t				inOldAddress,
+								uint16_t				inNewAddress,
+								uint32_t				inSize);
+	bool					MayContain(
+								uint16_t				inAddress) const
+								{return((mFilter[inAddress >> 3] & (1 << (inAddress & 7))) != 0);}
+	bool					Lookup(
+								uint16_t				inOldAddress,
+								uint16_t&				outNewAddress) const;
+	bool					Empty(void) const
+								{return(mPairs.empty());}
+protected:
+	uint8_t			mFilter[0x2000];	// One bit per 16 bit address
+	AddressPairs	mPairs;				// Sorted by oldAddress
+};
+
+/*
+*	Walks AVR code an instruction at a time.  Instructions are either one or two
+*	words.  The only two word instructions are LDS, STS, JMP and CALL, which are
+*	identified by opcode masks.  Any word that doesn't match one of the masks
+*	is a single word instruction.
+*
+*	Next() advances to the next two word instruction, which are the only ones
+*	that have an absolute address operand.
+*/
+class AVRInstructionIterator
+{
+public:
+	enum EOpcode
+	{
+		eOther,		// Any single word instruction
+		eLDS,
+		eSTS,
+		eJMP,
+		eCALL
+	};
+							AVRInstructionIterator(
+								uint16_t*				inStart,
+								uint16_t*				inEnd);
+	EOpcode					Next(void);
+	EOpcode					GetOpcode(void) const
+								{return(mOpcode);}
+	uint16_t*				GetInstruction(void) const
+								{return(mInstruction);}
+	uint16_t*				GetOperand(void) const
+								{return(&mInstruction[1]);}
+							// Returns the byte address of a JMP or CALL
+	uint32_t				GetJmpAddress(void) const
+								{return(JmpAddressFor(mInstruction));}
+	static EOpcode			Decode(
+								uint16_t				inWord)
+							{
+								if ((inWord & 0xFC0F) == 0x9000)
+								{
+									return((inWord & 0x0200) ? eSTS : eLDS);
+								} else if ((inWord & 0xFE0C) == 0x940C)
+								{
+									return((inWord & 0x0002) ? eCALL : eJMP);
+								}
+								return(eOther);
+							}
+	static uint32_t			JmpAddressFor(
+								const uint16_t*			inInstruction);
+	static uint16_t*		FindLongOpcode(
+								uint16_t*				inStart,
+								uint16_t*				inEnd);
+protected:
+	uint16_t*	mInstruction;
+	uint16_t*	mEnd;
+	uint32_t	mLength;	// Length in words of the current instruction
+	EOpcode		mOpcode;
+};
+
 class AVRElfFile : public ElfFile
 {
 public:
@@ -85,6 +226,75 @@ public:
 	uint32_t				ReplaceAddress(
 								const char*				inSymbolName,
 								uint16_t				inNewAddress);
+	uint32_t				ReplaceAddresses(
+								const SAddressReplacement inReplacements[],
+								uint32_t				inNumReplacements);
+	uint32_t				ReplaceAddresses(
+								const AVRAddressMap&	inAddressMap);
+	const std::vector<uint32_t>&	GetLongInstructions(void);
+							// Also clears the decoded long instructions.
+	virtual void			FreeMem(void);
+	uint16_t*				GetCodeStart(void);
+	bool					WriteHexFile(
+								const char*				inPath);
+	bool					WriteEepFile(
+								const char*				inPath);
+	void					GetFlashChunks(
+								HexChunks&				outChunks);
+	void					GetEEPROMChunks(
+								HexChunks&				outChunks);
+							// True if linked with --emit-relocs (-Wl,-q)
+	bool					HasRelocations(void);
+	/*
+	*	Moves the flash content (.text and the .data initializers) so .text
+	*	starts at inTextBase, and the SRAM content (.data, .bss, .noinit) so
+	*	.data starts at inDataBase.  This is the same as relinking with
+	*	--section-start=.text and -Tdata, but is done by reapplying the
+	*	relocations kept by --emit-relocs.  The section and program headers,
+	*	symbol table and relocations are updated too, so the file can be
+	*	rebased again.
+	*	Returns false, with the file unchanged, if there are no relocations,
+	*	or a relocation is unsupported, out of range, or doesn't match the
+	*	content (e.g. the file was relaxed.)
+	*/
+	bool					Rebase(
+								uint32_t				inTextBase,
+								uint32_t				inDataBase);
+							// Returns false if inType is unsupported or
+							// inValue is out of range for inType.
+	static bool				ApplyRelocation(
+								uint32_t				inType,
+								uint8_t*				ioPlace,
+								uint32_t				inPlaceAddress,
+								int32_t					inValue);
+							// The number of bytes at the place relocated.
+	static uint32_t			RelocationSize(
+								uint32_t				inType);
+protected:
+	std::vector<uint32_t>	mLongInstructions;	// .text word offsets of LDS, STS, JMP, CALL
+	bool					mLongInstructionsDecoded;
+
+	int32_t					SymbolDelta(
+								const SSymbolTblEntry*	inSymTblEntry,
+								int32_t					inTextDelta,
+								int32_t					inDataDelta);
+	bool					Relocate(
+								int32_t					inTextDelta,
+								int32_t					inDataDelta,
+								bool					inApply);
+	uint32_t				ReplaceOperands(
+								const AVRAddressMap&	inAddressMap);
+	uint32_t				RetargetRelocations(
+								const AVRAddressMap&	inAddressMap);
+							// The distance an address moves when rebased
+	static int32_t			AddressDelta(
+								uint32_t				inAddress,
+								int32_t					inTextDelta,
+								int32_t					inDataDelta)
+							{return(inAddress < kDataSpaceStart ? inTextDelta :
+								(inAddress < kEEPROMSpaceStart ? inDataDelta : 0));}
+	static const uint32_t	kDataSpaceStart = 0x800000;	// SRAM addresses in the elf file
+	static const uint32_t	kEEPROMSpaceStart = 0x810000;
 };
 
 #endif /* AVRElfFile_h */
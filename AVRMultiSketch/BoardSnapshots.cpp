@@ -0,0 +1,199 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  BoardSnapshots.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "BoardSnapshots.h"
+#include "BuildCache.h"
+#include "BuildTrace.h"
+#include "ConfigurationFile.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Changed whenever SHeader or the store image changes.
+static const char kSnapshotSignature[8] = {'A','V','R','M','S','B','S','2'};
+
+/******************************** SnapshotKey *********************************/
+std::string BoardSnapshots::SnapshotKey(
+	const std::string&		inBoardsTxtPath,
+	const std::string&		inPlatformTxtPath,
+	const BoardsConfigFile&	inConfigFile)
+{
+	std::string	key(inBoardsTxtPath);
+	key += '\n';
+	key.append(inPlatformTxtPath);
+	key += '\n';
+	key.append(inConfigFile.GetFQBN());
+	return(key);
+}
+
+/******************************** SnapshotPath ********************************/
+std::string BoardSnapshots::SnapshotPath(
+	const std::string&	inKey) const
+{
+	BuildCacheKey	keyHash;
+	keyHash.Add(inKey);
+	char	hashStr[32];
+	snprintf(hashStr, sizeof(hashStr), "%016llX.snapshot", (unsigned long long)keyHash.GetHash());
+	return(mFolderPath + "/" + hashStr);
+}
+
+/******************************** GetFileStamp ********************************/
+bool BoardSnapshots::GetFileStamp(
+	const std::string&	inPath,
+	SFileStamp&			outFileStamp)
+{
+	struct stat	pathStat;
+	bool	success = stat(inPath.c_str(), &pathStat) == 0;
+	if (success)
+	{
+		outFileStamp.size = pathStat.st_size;
+#ifdef __APPLE__
+		outFileStamp.seconds = pathStat.st_mtimespec.tv_sec;
+		outFileStamp.nanoseconds = pathStat.st_mtimespec.tv_nsec;
+#else
+		outFileStamp.seconds = pathStat.st_mtim.tv_sec;
+		outFileStamp.nanoseconds = pathStat.st_mtim.tv_nsec;
+#endif
+	}
+	return(success);
+}
+
+/************************************ Hash ************************************/
+uint64_t BoardSnapshots::Hash(
+	const std::string&	inKey,
+	const void*			inImage,
+	size_t				inImageSize)
+{
+	BuildCacheKey	hash;
+	hash.Add(inKey);
+	hash.Add(inImage, inImageSize);
+	return(hash.GetHash());
+}
+
+/************************************ Load ************************************/
+/*
+*	The file stamps are checked before the hash so that a snapshot of files
+*	that have changed is rejected without reading the rest of it.
+*/
+bool BoardSnapshots::Load(
+	const std::string&	inBoardsTxtPath,
+	const std::string&	inPlatformTxtPath,
+	BoardsConfigFile&	ioConfigFile) const
+{
+	bool	success = false;
+	if (IsEnabled())
+	{
+		std::string	key(SnapshotKey(inBoardsTxtPath, inPlatformTxtPath, ioConfigFile));
+		int	fd = open(SnapshotPath(key).c_str(), O_RDONLY);
+		if (fd >= 0)
+		{
+			struct stat	fileStat;
+			if (fstat(fd, &fileStat) == 0 &&
+				fileStat.st_size >= (off_t)sizeof(SHeader))
+			{
+				size_t	fileSize = (size_t)fileStat.st_size;
+				void*	mapped = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapped != MAP_FAILED)
+				{
+					const uint8_t*	snapshot = (const uint8_t*)mapped;
+					SHeader	header;
+					memcpy(&header, snapshot, sizeof(header));
+					SFileStamp	boardsTxt, platformTxt;
+					success = memcmp(header.signature, kSnapshotSignature, sizeof(kSnapshotSignature)) == 0 &&
+						fileSize == sizeof(header) + (uint64_t)header.keyLength + header.imageSize &&
+						header.keyLength == key.size() &&
+						memcmp(&snapshot[sizeof(header)], key.c_str(), key.size()) == 0 &&
+						GetFileStamp(inBoardsTxtPath, boardsTxt) &&
+						memcmp(&boardsTxt, &header.boardsTxt, sizeof(boardsTxt)) == 0 &&
+						GetFileStamp(inPlatformTxtPath, platformTxt) &&
+						memcmp(&platformTxt, &header.platformTxt, sizeof(platformTxt)) == 0;
+					if (success)
+					{
+						const uint8_t*	image = &snapshot[sizeof(header) + key.size()];
+						success = Hash(key, image, header.imageSize) == header.hash &&
+							ioConfigFile.SetKeyValuesImage(image, header.imageSize);
+						BuildTrace::Count(BuildTrace::eBytesRead, fileSize);
+					}
+					munmap(mapped, fileSize);
+				}
+			}
+			close(fd);
+		}
+	}
+	return(success);
+}
+
+/************************************ Save ************************************/
+/*
+*	The snapshot is written to a temporary file that is then renamed, so a
+*	build loading it never sees a partially written snapshot.
+*/
+bool BoardSnapshots::Save(
+	const std::string&		inBoardsTxtPath,
+	const SFileStamp&		inBoardsTxtStamp,
+	const std::string&		inPlatformTxtPath,
+	const SFileStamp&		inPlatformTxtStamp,
+	const BoardsConfigFile&	inConfigFile) const
+{
+	bool	success = false;
+	if (IsEnabled())
+	{
+		SHeader	header;
+		header.boardsTxt = inBoardsTxtStamp;
+		header.platformTxt = inPlatformTxtStamp;
+		std::string	key(SnapshotKey(inBoardsTxtPath, inPlatformTxtPath, inConfigFile));
+		const KeyValueStore&	store = inConfigFile.GetKeyValues();
+		std::vector<uint8_t>	image(store.GetImageSize());
+		store.GetImage(image.data());
+		memcpy(header.signature, kSnapshotSignature, sizeof(kSnapshotSignature));
+		header.keyLength = (uint32_t)key.size();
+		header.imageSize = (uint32_t)image.size();
+		header.hash = Hash(key, image.data(), image.size());
+		std::string	tempPath(mFolderPath + "/tmp.XXXXXX");
+		int	fd = mkstemp(&tempPath[0]);
+		if (fd >= 0)
+		{
+			success = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+				write(fd, key.c_str(), key.size()) == (ssize_t)key.size() &&
+				write(fd, image.data(), image.size()) == (ssize_t)image.size();
+			success = close(fd) == 0 && success &&
+				rename(tempPath.c_str(), SnapshotPath(key).c_str()) == 0;
+			if (success)
+			{
+				BuildTrace::Count(BuildTrace::eBytesWritten, sizeof(header) + key.size() + image.size());
+			} else
+			{
+				unlink(tempPath.c_str());
+			}
+		}
+	}
+	return(success);
+}
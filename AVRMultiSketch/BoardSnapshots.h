@@ -0,0 +1,117 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  BoardSnapshots.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef BoardSnapshots_h
+#define BoardSnapshots_h
+
+#include <inttypes.h>
+#include <string>
+
+class BoardsConfigFile;
+
+/*
+*	BoardSnapshots saves the configuration read from a board's platform.txt
+*	and boards.txt so that later builds load it rather than parse the files
+*	again.  The boards.txt of a third party package can define thousands of
+*	keys for dozens of boards, nearly all of which are parsed only to be
+*	filtered out.
+*
+*	A snapshot is the image of the configuration's KeyValueStore, so it holds
+*	only the keys kept for the FQBN, with the board ID and selected menu items
+*	already resolved.  It's saved to a file named by the hash of the boards.txt
+*	path, the platform.txt path, and the FQBN, which is memory mapped when the
+*	snapshot is loaded.  A snapshot is only used if the size and modification
+*	time of both files are the same as when it was saved, and the hash of its
+*	contents matches the hash saved with it.
+*/
+class BoardSnapshots
+{
+public:
+	struct SFileStamp
+	{
+		int64_t		size;
+		int64_t		seconds;
+		int64_t		nanoseconds;
+	};
+							BoardSnapshots(void){}
+	void					SetFolder(
+								const std::string&		inFolderPath)
+								{mFolderPath.assign(inFolderPath);}
+	bool					IsEnabled(void) const
+								{return(!mFolderPath.empty());}
+	/*
+	*	Replaces the key values of ioConfigFile with the snapshot of the files
+	*	for its FQBN.  Returns false, leaving ioConfigFile unchanged, if there
+	*	is no current snapshot.
+	*/
+	bool					Load(
+								const std::string&		inBoardsTxtPath,
+								const std::string&		inPlatformTxtPath,
+								BoardsConfigFile&		ioConfigFile) const;
+	/*
+	*	Saves the key values of inConfigFile, which must have just been read
+	*	from the files.  The stamps must be taken by GetFileStamp before the
+	*	files are read, so that a file changed while it was being read leaves
+	*	a snapshot that is rejected rather than one that is stale.
+	*/
+	bool					Save(
+								const std::string&		inBoardsTxtPath,
+								const SFileStamp&		inBoardsTxtStamp,
+								const std::string&		inPlatformTxtPath,
+								const SFileStamp&		inPlatformTxtStamp,
+								const BoardsConfigFile&	inConfigFile) const;
+	static bool				GetFileStamp(
+								const std::string&		inPath,
+								SFileStamp&				outFileStamp);
+protected:
+	/*
+	*	The snapshot file is the header followed by the key (the paths and
+	*	the FQBN) and the store image.
+	*/
+	struct SHeader
+	{
+		char		signature[8];
+		SFileStamp	boardsTxt;
+		SFileStamp	platformTxt;
+		uint32_t	keyLength;
+		uint32_t	imageSize;
+		uint64_t	hash;		// Of the key and the image
+	};
+	std::string	mFolderPath;
+
+	static std::string		SnapshotKey(
+								const std::string&		inBoardsTxtPath,
+								const std::string&		inPlatformTxtPath,
+								const BoardsConfigFile&	inConfigFile);
+	std::string				SnapshotPath(
+								const std::string&		inKey) const;
+	static uint64_t			Hash(
+								const std::string&		inKey,
+								const void*				inImage,
+								size_t					inImageSize);
+};
+
+#endif /* BoardSnapshots_h */
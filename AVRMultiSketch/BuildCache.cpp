@@ -0,0 +1,231 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  BuildCache.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "BuildCache.h"
+#include "BuildTrace.h"
+#include "FileStager.h"
+#include <algorithm>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+/************************************ Add *************************************/
+void BuildCacheKey::Add(
+	const void*	inData,
+	size_t		inLength)
+{
+	const uint8_t*	data = (const uint8_t*)inData;
+	const uint8_t*	dataEnd = &data[inLength];
+	uint64_t	hash = mHash;
+	for (; data < dataEnd; data++)
+	{
+		hash = (hash ^ *data) * kPrime;
+	}
+	mHash = hash;
+}
+
+/********************************** AddFile ***********************************/
+bool BuildCacheKey::AddFile(
+	const char*	inPath)
+{
+	bool	success = false;
+	FILE*    file = fopen(inPath, "rb");
+	if (file)
+	{
+		uint8_t	buffer[0x10000];
+		size_t	bytesRead;
+		while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			Add(buffer, bytesRead);
+			BuildTrace::Count(BuildTrace::eBytesRead, bytesRead);
+		}
+		success = ferror(file) == 0;
+		fclose(file);
+	}
+	return(success);
+}
+
+#pragma mark -
+/********************************* EntryPath **********************************/
+std::string BuildCache::EntryPath(
+	const BuildCacheKey&	inKey) const
+{
+	char	hashStr[20];
+	snprintf(hashStr, sizeof(hashStr), "%016llX", (unsigned long long)inKey.GetHash());
+	return(mFolderPath + "/" + hashStr);
+}
+
+/******************************** RemoveFolder ********************************/
+void BuildCache::RemoveFolder(
+	const std::string&	inFolderPath,
+	const char* const	inExtensions[])
+{
+	for (uint32_t i = 0; inExtensions[i]; i++)
+	{
+		unlink((inFolderPath + "/" + inExtensions[i]).c_str());
+	}
+	rmdir(inFolderPath.c_str());
+}
+
+/*********************************** Fetch ************************************/
+bool BuildCache::Fetch(
+	const BuildCacheKey&	inKey,
+	const std::string&		inDstFolder,
+	const std::string&		inBaseName,
+	const char* const		inExtensions[]) const
+{
+	BuildSpan	span("CacheFetch", inBaseName.c_str());
+	bool	success = IsEnabled();
+	if (success)
+	{
+		std::string	entryPath(EntryPath(inKey));
+		/*
+		*	Check that the entry exists before copying anything so that a miss
+		*	leaves inDstFolder untouched.
+		*/
+		for (uint32_t i = 0; success && inExtensions[i]; i++)
+		{
+			success = access((entryPath + "/" + inExtensions[i]).c_str(), R_OK) == 0;
+		}
+		for (uint32_t i = 0; success && inExtensions[i]; i++)
+		{
+			success = FileStager::CopyFile(entryPath + "/" + inExtensions[i],
+						inDstFolder + "/" + inBaseName + "." + inExtensions[i]);
+		}
+		if (success)
+		{
+			// Marks the entry as used for Prune.
+			utimes(entryPath.c_str(), NULL);
+		}
+	}
+	return(success);
+}
+
+/*********************************** Store ************************************/
+bool BuildCache::Store(
+	const BuildCacheKey&	inKey,
+	const std::string&		inSrcFolder,
+	const std::string&		inBaseName,
+	const char* const		inExtensions[]) const
+{
+	BuildSpan	span("CacheStore", inBaseName.c_str());
+	bool	success = false;
+	if (IsEnabled())
+	{
+		std::string	tempPath(mFolderPath + "/tmp.XXXXXX");
+		success = mkdtemp(&tempPath[0]) != NULL;
+		if (success)
+		{
+			for (uint32_t i = 0; success && inExtensions[i]; i++)
+			{
+				success = FileStager::CopyFile(inSrcFolder + "/" + inBaseName + "." + inExtensions[i],
+							tempPath + "/" + inExtensions[i]);
+			}
+			/*
+			*	If another build already stored an entry for this key the
+			*	rename fails, which is fine, the existing entry has the same
+			*	content.
+			*/
+			if (!success ||
+				rename(tempPath.c_str(), EntryPath(inKey).c_str()) != 0)
+			{
+				RemoveFolder(tempPath, inExtensions);
+			}
+		}
+	}
+	return(success);
+}
+
+/*********************************** Prune ************************************/
+void BuildCache::Prune(void) const
+{
+	struct SEntry
+	{
+		std::string	path;
+		int64_t		lastUsed;
+		uint64_t	size;
+	};
+	std::vector<SEntry>	entries;
+	uint64_t	totalSize = 0;
+	DIR*	dir = IsEnabled() ? opendir(mFolderPath.c_str()) : NULL;
+	if (dir)
+	{
+		struct dirent*	dirEntry;
+		while ((dirEntry = readdir(dir)) != NULL)
+		{
+			// An entry's name is the 16 hex digits of its key's hash.
+			const char*	name = dirEntry->d_name;
+			SEntry	entry;
+			struct stat	entryStat;
+			entry.path.assign(mFolderPath + "/" + name);
+			if (strlen(name) != 16 ||
+				strspn(name, "0123456789ABCDEF") != 16 ||
+				lstat(entry.path.c_str(), &entryStat) != 0 ||
+				!S_ISDIR(entryStat.st_mode))
+			{
+				continue;
+			}
+			entry.lastUsed = entryStat.st_mtime;
+			entry.size = 0;
+			DIR*	entryDir = opendir(entry.path.c_str());
+			if (entryDir)
+			{
+				struct dirent*	fileEntry;
+				while ((fileEntry = readdir(entryDir)) != NULL)
+				{
+					struct stat	fileStat;
+					if (lstat((entry.path + "/" + fileEntry->d_name).c_str(), &fileStat) == 0 &&
+						S_ISREG(fileStat.st_mode))
+					{
+						entry.size += fileStat.st_size;
+					}
+				}
+				closedir(entryDir);
+			}
+			totalSize += entry.size;
+			entries.push_back(entry);
+		}
+		closedir(dir);
+	}
+	if (totalSize > mMaxSize)
+	{
+		std::sort(entries.begin(), entries.end(),
+			[](const SEntry& inEntry1, const SEntry& inEntry2)
+			{
+				return(inEntry1.lastUsed < inEntry2.lastUsed);
+			});
+		for (size_t i = 0; totalSize > mMaxSize && i < entries.size(); i++)
+		{
+			FileStager::RemoveFolder(entries[i].path);
+			totalSize -= entries[i].size;
+		}
+	}
+}
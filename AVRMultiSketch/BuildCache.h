@@ -0,0 +1,128 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  BuildCache.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef BuildCache_h
+#define BuildCache_h
+
+#include <inttypes.h>
+#include <string>
+
+/*
+*	BuildCacheKey accumulates a 64 bit FNV-1a hash of everything that
+*	determines the content of a build's output files.
+*/
+class BuildCacheKey
+{
+public:
+							BuildCacheKey(void)
+								: mHash(kOffsetBasis){}
+	void					Add(
+								const void*				inData,
+								size_t					inLength);
+	void					Add(
+								uint32_t				inValue)
+								{Add(&inValue, sizeof(inValue));}
+	void					Add(
+								const std::string&		inString)
+								{Add(inString.c_str(), inString.size() + 1);}
+							// Returns false if the file can't be read.
+	bool					AddFile(
+								const char*				inPath);
+	uint64_t				GetHash(void) const
+								{return(mHash);}
+protected:
+	uint64_t	mHash;
+	static const uint64_t	kOffsetBasis = 0xCBF29CE484222325ULL;
+	static const uint64_t	kPrime = 0x100000001B3ULL;
+};
+
+/*
+*	A content addressed store of build output files.  Each entry is a folder
+*	named by the key's hash containing files named by their extension only
+*	(e.g. "elf", "hex", "eep"), so an entry can be shared by sketches that have
+*	different names.
+*
+*	An entry is written to a temporary folder that is then renamed, so an
+*	entry is either complete or doesn't exist.
+*
+*	The cache is capped at a maximum size (256 MB unless set) by Prune, which
+*	removes the least recently used entries.  Fetching an entry sets the
+*	modification time of its folder, which is used rather than the access
+*	time because file systems mounted noatime or relatime don't keep it.
+*/
+class BuildCache
+{
+public:
+							BuildCache(void)
+								: mMaxSize(kDefaultMaxSize){}
+	void					SetFolder(
+								const std::string&		inFolderPath)
+								{mFolderPath.assign(inFolderPath);}
+	void					SetMaxSize(
+								uint64_t				inMaxSize)
+								{mMaxSize = inMaxSize;}
+	bool					IsEnabled(void) const
+								{return(!mFolderPath.empty());}
+	/*
+	*	Copies the files with inExtensions (a NULL terminated list) of the
+	*	entry for inKey to inDstFolder/inBaseName.<extension>.
+	*	Returns false if there is no entry for inKey.
+	*/
+	bool					Fetch(
+								const BuildCacheKey&	inKey,
+								const std::string&		inDstFolder,
+								const std::string&		inBaseName,
+								const char* const		inExtensions[]) const;
+	/*
+	*	Copies inSrcFolder/inBaseName.<extension> for each of inExtensions to
+	*	the entry for inKey.
+	*/
+	bool					Store(
+								const BuildCacheKey&	inKey,
+								const std::string&		inSrcFolder,
+								const std::string&		inBaseName,
+								const char* const		inExtensions[]) const;
+	/*
+	*	Removes the least recently used entries until the files of those left
+	*	total no more than the maximum size.  Only the entry folders, those
+	*	named by a key's hash, are counted or removed.  Anything else kept in
+	*	the cache folder (e.g. board snapshots and the hardware index) and the
+	*	temporary folders of entries being stored are left alone.
+	*/
+	void					Prune(void) const;
+protected:
+	std::string	mFolderPath;
+	uint64_t	mMaxSize;
+	static const uint64_t	kDefaultMaxSize = 256ULL * 1024 * 1024;
+
+	std::string				EntryPath(
+								const BuildCacheKey&	inKey) const;
+	static void				RemoveFolder(
+								const std::string&		inFolderPath,
+								const char* const		inExtensions[]);
+};
+
+#endif /* BuildCache_h */
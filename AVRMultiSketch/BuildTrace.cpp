@@ -0,0 +1,206 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  BuildTrace.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "BuildTrace.h"
+#include "JSONElement.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+std::atomic<bool>		BuildTrace::sRecording(false);
+std::atomic<uint64_t>	BuildTrace::sCounters[eNumCounters];
+std::mutex				BuildTrace::sMutex;
+std::vector<BuildTrace::SSpan>	BuildTrace::sSpans;
+TracePoint				BuildTrace::sStartTime;
+
+static const char* const kCounterNames[] = {"bytesRead", "bytesWritten", "processesSpawned"};
+
+/*********************************** Start ************************************/
+void BuildTrace::Start(void)
+{
+	std::lock_guard<std::mutex>	lock(sMutex);
+	sSpans.clear();
+	for (uint32_t i = 0; i < eNumCounters; i++)
+	{
+		sCounters[i] = 0;
+	}
+	sStartTime = std::chrono::steady_clock::now();
+	sRecording = true;
+}
+
+/************************************ Stop ************************************/
+void BuildTrace::Stop(void)
+{
+	sRecording = false;
+}
+
+/******************************** GetThreadID *********************************/
+/*
+*	Small sequential numbers are easier to read in a trace viewer than the
+*	system's thread IDs.
+*/
+uint32_t BuildTrace::GetThreadID(void)
+{
+	static std::atomic<uint32_t>	sNextThreadID(1);
+	static thread_local uint32_t	sThreadID = sNextThreadID++;
+	return(sThreadID);
+}
+
+/********************************** AddSpan ***********************************/
+void BuildTrace::AddSpan(
+	const char*			inName,
+	const std::string&	inDetail,
+	const TracePoint&	inStart,
+	const TracePoint&	inEnd)
+{
+	SSpan	span;
+	span.name = inName;
+	span.detail = inDetail;
+	span.threadID = GetThreadID();
+	span.duration = std::chrono::duration_cast<std::chrono::microseconds>(inEnd - inStart).count();
+	for (uint32_t i = 0; i < eNumCounters; i++)
+	{
+		span.counts[i] = sCounters[i];
+	}
+	std::lock_guard<std::mutex>	lock(sMutex);
+	// A span started before Start is ignored.
+	if (inStart >= sStartTime)
+	{
+		span.start = std::chrono::duration_cast<std::chrono::microseconds>(inStart - sStartTime).count();
+		sSpans.push_back(span);
+	}
+}
+
+/****************************** WriteChromeTrace ******************************/
+/*
+*	Each span is a complete ("X") event.  The counters are written as counter
+*	("C") events at the end of each span so they're graphed over time.
+*/
+bool BuildTrace::WriteChromeTrace(
+	const char*	inPath)
+{
+	std::string	trace("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	{
+		std::lock_guard<std::mutex>	lock(sMutex);
+		char	event[256];
+		bool	first = true;
+		for (const SSpan& span : sSpans)
+		{
+			snprintf(event, sizeof(event), "%s\n{\"name\":\"%s\",\"cat\":\"build\",\"ph\":\"X\","
+				"\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu",
+				first ? "" : ",", span.name, span.threadID,
+				(unsigned long long)span.start, (unsigned long long)span.duration);
+			trace.append(event);
+			first = false;
+			if (!span.detail.empty())
+			{
+				trace.append(",\"args\":{\"detail\":");
+				JSONString(span.detail).Write(0, trace);
+				trace += '}';
+			}
+			snprintf(event, sizeof(event), "},\n{\"name\":\"I/O\",\"ph\":\"C\",\"pid\":1,\"ts\":%llu,"
+				"\"args\":{\"%s\":%llu,\"%s\":%llu}},\n"
+				"{\"name\":\"Processes\",\"ph\":\"C\",\"pid\":1,\"ts\":%llu,\"args\":{\"%s\":%llu}}",
+				(unsigned long long)(span.start + span.duration),
+				kCounterNames[eBytesRead], (unsigned long long)span.counts[eBytesRead],
+				kCounterNames[eBytesWritten], (unsigned long long)span.counts[eBytesWritten],
+				(unsigned long long)(span.start + span.duration),
+				kCounterNames[eProcessesSpawned], (unsigned long long)span.counts[eProcessesSpawned]);
+			trace.append(event);
+		}
+	}
+	trace.append("\n]}\n");
+	FILE*    file = fopen(inPath, "wb");
+	bool	success = file != NULL;
+	if (success)
+	{
+		success = fwrite(trace.c_str(), 1, trace.size(), file) == trace.size();
+		success = fclose(file) == 0 && success;
+	}
+	return(success);
+}
+
+/********************************* GetSummary *********************************/
+void BuildTrace::GetSummary(
+	std::string&	outSummary)
+{
+	struct SStage
+	{
+		const char*	name;
+		uint32_t	count;
+		uint64_t	total;
+		uint64_t	longest;
+		uint64_t	firstStart;
+	};
+	std::vector<SStage>	stages;
+	{
+		std::lock_guard<std::mutex>	lock(sMutex);
+		for (const SSpan& span : sSpans)
+		{
+			std::vector<SStage>::iterator	itr = stages.begin();
+			for (; itr != stages.end(); ++itr)
+			{
+				if (strcmp(itr->name, span.name) == 0)
+				{
+					break;
+				}
+			}
+			if (itr == stages.end())
+			{
+				SStage	stage = {span.name, 0, 0, 0, span.start};
+				itr = stages.insert(stages.end(), stage);
+			}
+			itr->count++;
+			itr->total += span.duration;
+			if (span.duration > itr->longest)
+			{
+				itr->longest = span.duration;
+			}
+			if (span.start < itr->firstStart)
+			{
+				itr->firstStart = span.start;
+			}
+		}
+	}
+	std::sort(stages.begin(), stages.end(),
+		[](const SStage& inStage1, const SStage& inStage2)
+		{
+			return(inStage1.firstStart < inStage2.firstStart);
+		});
+	char	line[128];
+	snprintf(line, sizeof(line), "%-24s %6s %12s %12s\n", "Stage", "Count", "Total ms", "Longest ms");
+	outSummary.assign(line);
+	for (const SStage& stage : stages)
+	{
+		snprintf(line, sizeof(line), "%-24s %6u %12.3f %12.3f\n", stage.name, stage.count,
+			stage.total/1000.0, stage.longest/1000.0);
+		outSummary.append(line);
+	}
+	snprintf(line, sizeof(line), "Bytes read: %llu, bytes written: %llu, processes spawned: %llu",
+		(unsigned long long)sCounters[eBytesRead], (unsigned long long)sCounters[eBytesWritten],
+		(unsigned long long)sCounters[eProcessesSpawned]);
+	outSummary.append(line);
+}
@@ -0,0 +1,147 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  BuildTrace.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef BuildTrace_h
+#define BuildTrace_h
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock::time_point	TracePoint;
+
+/*
+*	BuildTrace records where the time of a build goes as named spans, one per
+*	timed stage (staging, a link, patching an elf file, ...), along with running
+*	totals of the bytes read and written and the processes spawned.
+*
+*	Nothing is recorded until Start is called.  While not recording, a
+*	BuildSpan costs a single relaxed atomic load and Count does nothing, so
+*	spans can be left in place in the code that's timed.
+*
+*	What was recorded can be written as a Chrome trace event file (load it in
+*	chrome://tracing or Perfetto) and summarized as a table of the total time
+*	per span name.
+*/
+class BuildTrace
+{
+public:
+	enum ECounter
+	{
+		eBytesRead,
+		eBytesWritten,
+		eProcessesSpawned,
+		eNumCounters
+	};
+							// Discards anything recorded and starts recording.
+	static void				Start(void);
+	static void				Stop(void);
+	static bool				IsRecording(void)
+								{return(sRecording.load(std::memory_order_relaxed));}
+	static void				Count(
+								ECounter				inCounter,
+								uint64_t				inValue)
+								{if (IsRecording()) sCounters[inCounter] += inValue;}
+	static uint64_t			GetCount(
+								ECounter				inCounter)
+								{return(sCounters[inCounter]);}
+							// Called by ~BuildSpan
+	static void				AddSpan(
+								const char*				inName,
+								const std::string&		inDetail,
+								const TracePoint&		inStart,
+								const TracePoint&		inEnd);
+	static bool				WriteChromeTrace(
+								const char*				inPath);
+	/*
+	*	One line per span name in the order first started: the number of
+	*	spans, the total and the longest time, followed by the counters.
+	*/
+	static void				GetSummary(
+								std::string&			outSummary);
+protected:
+	struct SSpan
+	{
+		const char*	name;
+		std::string	detail;		// e.g. the sketch name
+		uint32_t	threadID;
+		uint64_t	start;		// Microseconds since Start
+		uint64_t	duration;	// Microseconds
+		uint64_t	counts[eNumCounters];	// The totals when the span ended
+	};
+	static std::atomic<bool>		sRecording;
+	static std::atomic<uint64_t>	sCounters[eNumCounters];
+	static std::mutex				sMutex;
+	static std::vector<SSpan>		sSpans;
+	static TracePoint				sStartTime;
+
+	static uint32_t			GetThreadID(void);
+};
+
+/*
+*	Times the scope it's declared in.  inName must be a string literal (only
+*	the pointer is kept.)  inDetail is copied, and only when recording.
+*/
+class BuildSpan
+{
+public:
+							BuildSpan(
+								const char*				inName,
+								const char*				inDetail = NULL)
+								: mName(inName), mRecording(BuildTrace::IsRecording())
+							{
+								if (mRecording)
+								{
+									if (inDetail)
+									{
+										mDetail.assign(inDetail);
+									}
+									mStart = std::chrono::steady_clock::now();
+								}
+							}
+							~BuildSpan(void)
+							{
+								if (mRecording)
+								{
+									BuildTrace::AddSpan(mName, mDetail, mStart, std::chrono::steady_clock::now());
+								}
+							}
+protected:
+	const char*	mName;
+	bool		mRecording;
+	std::string	mDetail;
+	TracePoint	mStart;
+
+							BuildSpan(
+								const BuildSpan&		inBuildSpan);	// Not implemented
+	BuildSpan&				operator = (
+								const BuildSpan&		inBuildSpan);	// Not implemented
+};
+
+#endif /* BuildTrace_h */
@@ -31,12 +31,22 @@
 #include "ConfigurationFile.h"
 #include "FileInputBuffer.h"
 #include "JSONElement.h"
+#include <ctype.h>
+#include <string.h>
 
 /***************************** ConfigurationFile ******************************/
 ConfigurationFile::ConfigurationFile(void)
-	: mRootObject(NULL)
+	: mBase(NULL), mRootObject(NULL)
+{
+}
+
+/***************************** ConfigurationFile ******************************/
+ConfigurationFile::ConfigurationFile(
+	const ConfigurationFile&	inConfigurationFile)
+	: mStore(inConfigurationFile.mStore), mBase(inConfigurationFile.mBase),
+	  mTemplates(inConfigurationFile.mTemplates),
+	  mTemplateTokens(inConfigurationFile.mTemplateTokens), mRootObject(NULL)
 {
-	mRootObject = new JSONObject;
 }
 
 /**************************** ~ConfigurationFile ******************************/
@@ -45,33 +55,161 @@ ConfigurationFile::~ConfigurationFile(void)
 	delete mRootObject;
 }
 
+/********************************* operator = *********************************/
+ConfigurationFile& ConfigurationFile::operator = (
+	const ConfigurationFile&	inConfigurationFile)
+{
+	Copy(inConfigurationFile);
+	return(*this);
+}
+
 /*********************************** Clear ************************************/
 void ConfigurationFile::Clear(void)
+{
+	mStore.Clear();
+	mBase = NULL;
+	mTemplates.clear();
+	mTemplateTokens.clear();
+	KeyValuesChanged();
+}
+
+/********************************** Overlay ***********************************/
+/*
+*	Makes this an empty layer over inBase.  Nothing is copied, keys inserted
+*	into this layer hide the base's values of the same keys.
+*/
+void ConfigurationFile::Overlay(
+	const ConfigurationFile&	inBase)
+{
+	Clear();
+	mBase = &inBase;
+}
+
+/****************************** KeyValuesChanged ******************************/
+/*
+*	Discards the tree built by GetRootObject, if any.
+*/
+void ConfigurationFile::KeyValuesChanged(void)
 {
 	delete mRootObject;
-	mRootObject = new JSONObject;
+	mRootObject = NULL;
+}
+
+/******************************* GetRootObject ********************************/
+/*
+*	Builds the configuration as a keyed tree, as it was originally stored,
+*	with a JSONObject for each key segment.  The object keys include the
+*	trailing delimiter (e.g. "build." then "mcu"), so a key's value and the
+*	keys below it don't collide.
+*/
+const JSONObject* ConfigurationFile::GetRootObject(void) const
+{
+	if (!mRootObject)
+	{
+		mRootObject = new JSONObject;
+		/*
+		*	The layers are added starting with the bottom base so that the
+		*	values of the layers above replace the values they hide.
+		*/
+		std::vector<const KeyValueStore*>	layers;
+		for (const ConfigurationFile* layer = this; layer; layer = layer->mBase)
+		{
+			layers.push_back(&layer->mStore);
+		}
+		const char*	key;
+		const char*	value;
+		size_t	keyLen, valueLen;
+		for (uint32_t layerIndex = (uint32_t)layers.size(); layerIndex; )
+		{
+			const KeyValueStore&	store = *layers[--layerIndex];
+			for (uint32_t index = 0; index < store.GetEntryCount(); index++)
+			{
+				if (!store.GetEntry(index, key, keyLen, value, valueLen))
+				{
+					continue;
+				}
+				JSONObject*	currentObject = mRootObject;
+				const char*	segment = key;
+				const char*	keyEnd = &key[keyLen];
+				for (const char* delimiter = segment; delimiter < keyEnd; delimiter++)
+				{
+					if (*delimiter == '.')
+					{
+						std::string	objectKey(segment, delimiter - segment + 1);	// Include the delimiter
+						JSONObject*	keyObject = (JSONObject*)currentObject->GetElement(objectKey);
+						if (!keyObject)
+						{
+							keyObject = new JSONObject;
+							currentObject->InsertElement(objectKey, keyObject);
+						}
+						currentObject = keyObject;
+						segment = &delimiter[1];
+					}
+				}
+				currentObject->InsertElement(std::string(segment, keyEnd - segment),
+					new JSONString(std::string(value, valueLen)));
+			}
+		}
+	}
+	return(mRootObject);
+}
+
+/***************************** SetKeyValuesImage ******************************/
+bool ConfigurationFile::SetKeyValuesImage(
+	const void*	inImage,
+	size_t		inImageSize)
+{
+	bool	success = mStore.SetImage(inImage, inImageSize);
+	if (success)
+	{
+		mTemplates.clear();
+		mTemplateTokens.clear();
+		KeyValuesChanged();
+	}
+	return(success);
 }
 
 /*********************************** Apply ************************************/
 /*
 *	Applies the contents of inConfigurationFile creating any key/values that
-*	don't exist and replacing the values of any that aren't equal.
+*	don't exist and replacing the values of any that aren't equal.  If
+*	inConfigurationFile is an overlay, its base is applied first.
 */
 void ConfigurationFile::Apply(
 	const ConfigurationFile&	inConfigurationFile)
 {
-	mRootObject->Apply(inConfigurationFile.GetRootObject());
+	if (inConfigurationFile.mBase)
+	{
+		Apply(*inConfigurationFile.mBase);
+	}
+	const KeyValueStore&	store = inConfigurationFile.mStore;
+	const char*	key;
+	const char*	value;
+	size_t	keyLen, valueLen;
+	for (uint32_t index = 0; index < store.GetEntryCount(); index++)
+	{
+		if (store.GetEntry(index, key, keyLen, value, valueLen))
+		{
+			mStore.Insert(key, keyLen, value, valueLen);
+		}
+	}
+	KeyValuesChanged();
 }
 
 /************************************ Copy ************************************/
 /*
-*	Copies the contents of inConfigurationFile to this object.
+*	Copies the contents of inConfigurationFile to this object.  The copied
+*	store has the same entries and value stamps, so the compiled templates
+*	remain valid.  The copy of an overlay is an overlay of the same base.
 */
 void ConfigurationFile::Copy(
 	const ConfigurationFile&	inConfigurationFile)
 {
-	delete mRootObject;
-	mRootObject = (JSONObject*)inConfigurationFile.GetRootObject()->Copy();
+	mStore = inConfigurationFile.mStore;
+	mBase = inConfigurationFile.mBase;
+	mTemplates = inConfigurationFile.mTemplates;
+	mTemplateTokens = inConfigurationFile.mTemplateTokens;
+	KeyValuesChanged();
 }
 
 /********************************** ReadFile **********************************/
@@ -91,44 +229,16 @@ bool ConfigurationFile::ReadFile(
 
 /******************************* InsertKeyValue *******************************/
 /*
-*	Inserts a key, potentially creating and/or deleting elements based on the
-*	the number of levels represented by the key.
+*	Inserts or replaces the value of a key.
 */
 void ConfigurationFile::InsertKeyValue(
 	const std::string&	inKey,
 	const std::string&	inValue)
 {
-	JSONObject*		currentObject = (JSONObject*)mRootObject;
-	StringInputBuffer	inputBuffer(inKey);
-	uint8_t thisChar = inputBuffer.CurrChar();
-	if (thisChar)
+	if (!inKey.empty())
 	{
-		std::string	key;
-
-		inputBuffer.StartSubString();
-		for (; thisChar; thisChar = inputBuffer.NextChar())
-		{
-			if (thisChar != '.')
-			{
-				continue;
-			} else
-			{
-				inputBuffer++;	// Include the Delimiter
-				inputBuffer.AppendSubString(key);
-				//inputBuffer--;
-				JSONObject* keyObject = (JSONObject*)currentObject->GetElement(key);
-				if (!keyObject)
-				{
-					keyObject = new JSONObject;
-					currentObject->InsertElement(key, keyObject);
-				}
-				currentObject = keyObject;
-				key.clear();
-				inputBuffer.StartSubString();
-			}
-		}
-		inputBuffer.AppendSubString(key);
-		currentObject->InsertElement(key, new JSONString(inValue));
+		mStore.Insert(inKey, inValue);
+		KeyValuesChanged();
 	}
 }
 
@@ -201,52 +311,53 @@ uint8_t ConfigurationFile::ReadNextKeyValue(
 	return(thisChar);
 }
 
-/****************************** RawValueForKey ********************************/
-bool ConfigurationFile::RawValueForKey(
-	const std::string&	inKey,
-	std::string&		outValue)
+/*************************** GetKeyValuesWithPrefix ***************************/
+/*
+*	Returns the key values of all layers whose keys start with inKeyPrefix,
+*	with the prefix removed from the keys.  Values hidden by a layer above
+*	aren't returned.
+*/
+void ConfigurationFile::GetKeyValuesWithPrefix(
+	const std::string&	inKeyPrefix,
+	KeyValuePairs&		outKeyValues) const
 {
-	bool	foundKeyValue = false;
-	JSONObject*		currentObject = (JSONObject*)mRootObject;
-	StringInputBuffer	inputBuffer(inKey);
-	uint8_t thisChar = inputBuffer.CurrChar();
-	if (thisChar)
+	const char*	key;
+	const char*	value;
+	size_t	keyLen, valueLen;
+	for (const ConfigurationFile* layer = this; layer; layer = layer->mBase)
 	{
-		std::string	key;
-
-		inputBuffer.StartSubString();
-		for (; thisChar; thisChar = inputBuffer.NextChar())
+		const KeyValueStore&	store = layer->mStore;
+		for (uint32_t index = 0; index < store.GetEntryCount(); index++)
 		{
-			if (thisChar != '.')
+			uint32_t	entryIndex;
+			if (store.GetEntry(index, key, keyLen, value, valueLen) &&
+				keyLen > inKeyPrefix.size() &&
+				inKeyPrefix.compare(0, inKeyPrefix.size(), key, inKeyPrefix.size()) == 0 &&
+				FindLayerEntry(key, keyLen, KeyValueStore::Hash(key, keyLen), entryIndex) == layer)	// Not hidden
 			{
-				continue;
-			} else
-			{
-				inputBuffer++;	// Include the Delimiter
-				inputBuffer.AppendSubString(key);
-				inputBuffer--;
-				currentObject = (JSONObject*)currentObject->GetElement(key, IJSONElement::eObject);
-				if (!currentObject)
-				{
-					break;
-				}
-				key.clear();
-				inputBuffer++;	// Skip the Delimiter
-				inputBuffer.StartSubString();
-			}
-		}
-		if (currentObject)
-		{
-			inputBuffer.AppendSubString(key);
-			JSONString* valueStr = (JSONString*)currentObject->GetElement(key, IJSONElement::eString);
-			if (valueStr)
-			{
-				outValue = valueStr->GetString();
-				foundKeyValue = true;
+				outKeyValues.push_back(std::make_pair(std::string(&key[inKeyPrefix.size()], keyLen - inKeyPrefix.size()),
+					std::string(value, valueLen)));
 			}
 		}
 	}
-	return(foundKeyValue);
+}
+
+/****************************** RawValueForKey ********************************/
+bool ConfigurationFile::RawValueForKey(
+	const std::string&	inKey,
+	std::string&		outValue)
+{
+	size_t	valueLen;
+	const char*	value = NULL;
+	for (const ConfigurationFile* layer = this; layer && !value; layer = layer->mBase)
+	{
+		value = layer->mStore.Find(inKey.c_str(), inKey.size(), &valueLen);
+	}
+	if (value)
+	{
+		outValue.assign(value, valueLen);
+	}
+	return(value != NULL);
 }
 
 /******************************** ValueForKey *********************************/
@@ -254,74 +365,241 @@ bool ConfigurationFile::RawValueForKey(
 *	Returns true if inKey was found.
 *	The value of inKey is appended to ioValue
 *	ioKeysNotFound contains the number of unresolved sub keys
-*	This is a recursive function, ioValue and ioKeysNotFound should be
-*	initialized by the caller.
+*	ioValue and ioKeysNotFound should be initialized by the caller.
 */
 bool ConfigurationFile::ValueForKey(
 	const std::string&		inKey,
 	std::string&			ioValue,
 	uint32_t&				ioKeysNotFound)
 {
-	std::string	rawKeyValue;
-	bool	foundKeyValue = RawValueForKey(inKey, rawKeyValue);
+	/*
+	*	A template is needed for each entry.  The vector is sized here so that
+	*	it isn't reallocated while references to its templates are in use.
+	*/
+	if (mTemplates.size() < mStore.GetEntryCount())
+	{
+		mTemplates.resize(mStore.GetEntryCount());	// Zeroed, not compiled
+	}
+	return(AppendValueForKey(inKey.c_str(), inKey.size(),
+		KeyValueStore::Hash(inKey.c_str(), inKey.size()), ioValue, ioKeysNotFound));
+}
+
+/***************************** AppendValueForKey ******************************/
+/*
+*	This is a recursive function called for each {key} in the value.  A {key}
+*	that isn't found is appended as is.
+*
+*	A value found in a base is expanded using the base's template if it's
+*	compiled.  The base's templates are only read, so a value of a base that
+*	isn't compiled is compiled into a temporary template.
+*/
+bool ConfigurationFile::AppendValueForKey(
+	const char*		inKey,
+	size_t			inKeyLen,
+	uint32_t		inKeyHash,
+	std::string&	ioValue,
+	uint32_t&		ioKeysNotFound) const
+{
+	uint32_t	entryIndex;
+	const ConfigurationFile*	layer = FindLayerEntry(inKey, inKeyLen, inKeyHash, entryIndex);
+	bool	foundKeyValue = layer != NULL;
 	if (foundKeyValue)
 	{
-		const char* uncomposedStrPtr = rawKeyValue.c_str();
-		const char*	subStrStart = uncomposedStrPtr;
-		long	subStrLen;
-		for (char thisChar = *uncomposedStrPtr; thisChar; thisChar = *(++uncomposedStrPtr))
+		const char*	key;
+		const char*	value;
+		size_t	keyLen, valueLen;
+		layer->mStore.GetEntry(entryIndex, key, keyLen, value, valueLen);
+		SValueTemplate	tempTemplate;
+		TemplateTokens	tempTokens;
+		const SValueTemplate*	valueTemplate;
+		const TemplateTokens*	templateTokens = &layer->mTemplateTokens;
+		if (layer == this)
 		{
-			if (thisChar != '{')
-			{
-				continue;
-			}
-			// Copy everything from the start of the sub string to thisChar
-			// to ioValue
-			subStrLen = uncomposedStrPtr-subStrStart;
-			if (subStrLen > 0)
-			{
-				ioValue.append((const char*)subStrStart, subStrLen);
-			}
-			thisChar = *(++uncomposedStrPtr);
-			subStrStart = uncomposedStrPtr;
-			for (; thisChar && thisChar != '}'; thisChar = *(++uncomposedStrPtr)){}
-			// uncomposedStrPtr is either pointing to the closing bracket or
-			// some formatting error occurred and it's pointing to the null terminator.
-			subStrLen = uncomposedStrPtr-subStrStart;
-			if (thisChar && subStrLen > 0)
+			valueTemplate = &GetValueTemplate(entryIndex);
+		} else if (entryIndex < layer->mTemplates.size() &&
+			layer->mTemplates[entryIndex].valueStamp == layer->mStore.GetValueStamp(entryIndex))
+		{
+			valueTemplate = &layer->mTemplates[entryIndex];
+		} else
+		{
+			CompileValueTemplate(value, valueLen, tempTemplate, tempTokens);
+			valueTemplate = &tempTemplate;
+			templateTokens = &tempTokens;
+		}
+		size_t	startLength = ioValue.size();
+		ioValue.reserve(startLength + valueTemplate->renderedLength);
+		ioKeysNotFound += valueTemplate->malformedKeys;
+		uint32_t	tokenEnd = valueTemplate->firstToken + valueTemplate->numTokens;
+		for (uint32_t tokenIndex = valueTemplate->firstToken; tokenIndex < tokenEnd; tokenIndex++)
+		{
+			// A copy, the tokens may be reallocated when a {key} is compiled
+			const STemplateToken	token = (*templateTokens)[tokenIndex];
+			const char*	tokenStr = &value[token.offset];
+			if (!token.isKey)
 			{
-				std::string subKey((const char*)subStrStart, subStrLen);
-				if (ValueForKey(subKey, ioValue, ioKeysNotFound))
-				{
-					subStrStart = uncomposedStrPtr +1; // skip the key delimiter
-				} else
-				{
-					subStrStart--;	// key wasn't found, include it in the returned value
-				}
-			} else
+				ioValue.append(tokenStr, token.length);
+			} else if (!AppendValueForKey(tokenStr, token.length, token.keyHash, ioValue, ioKeysNotFound))
 			{
-				ioKeysNotFound++;
-				subStrStart--;	// key wasn't found, include it in the returned value
-				if (thisChar != 0)
-				{
-					continue;
-				}
-				break;	// Else the null terminator was hit, exit loop
+				ioValue.append(&tokenStr[-1], token.length + 2);	// Include the braces
 			}
 		}
-		subStrLen = uncomposedStrPtr-subStrStart;
-		if (subStrLen > 0)
+		if (layer == this)
 		{
-			ioValue.append((const char*)subStrStart, subStrLen);
+			mTemplates[entryIndex].renderedLength = (uint32_t)(ioValue.size() - startLength);
 		}
 	} else
 	{
-		ioKeysNotFound++;	// ValueForKey is recursive
+		ioKeysNotFound++;	// AppendValueForKey is recursive
 	}
 
 	return(foundKeyValue);
 }
 
+/******************************* FindLayerEntry *******************************/
+/*
+*	Returns the layer containing inKey, starting with this, or NULL if no
+*	layer contains it.
+*/
+const ConfigurationFile* ConfigurationFile::FindLayerEntry(
+	const char*	inKey,
+	size_t		inKeyLen,
+	uint32_t	inKeyHash,
+	uint32_t&	outEntryIndex) const
+{
+	const ConfigurationFile*	layer = this;
+	for (; layer && !layer->mStore.FindEntry(inKey, inKeyLen, inKeyHash, outEntryIndex);
+		layer = layer->mBase){}
+	return(layer);
+}
+
+/****************************** GetValueTemplate ******************************/
+/*
+*	Returns the template of the value of the entry at inEntryIndex, compiling
+*	it if the value has changed since it was last compiled.
+*/
+const ConfigurationFile::SValueTemplate& ConfigurationFile::GetValueTemplate(
+	uint32_t	inEntryIndex) const
+{
+	SValueTemplate&	valueTemplate = mTemplates[inEntryIndex];
+	uint32_t	valueStamp = mStore.GetValueStamp(inEntryIndex);
+	if (valueTemplate.valueStamp != valueStamp)
+	{
+		const char*	key;
+		const char*	value;
+		size_t	keyLen, valueLen;
+		mStore.GetEntry(inEntryIndex, key, keyLen, value, valueLen);
+		CompileValueTemplate(value, valueLen, valueTemplate, mTemplateTokens);
+		valueTemplate.valueStamp = valueStamp;
+	}
+	return(valueTemplate);
+}
+
+/**************************** CompileValueTemplate ****************************/
+/*
+*	Compiles inValue appending its tokens to ioTemplateTokens.  The value
+*	stamp of outValueTemplate is set to 0 (not compiled), it's up to the caller
+*	to set it.
+*
+*	Text within braces is a key.  A { without a closing brace, or {}, is
+*	counted as a malformed key and kept as literal text.
+*/
+void ConfigurationFile::CompileValueTemplate(
+	const char*		inValue,
+	size_t			inValueLen,
+	SValueTemplate&	outValueTemplate,
+	TemplateTokens&	ioTemplateTokens)
+{
+	outValueTemplate.valueStamp = 0;
+	outValueTemplate.malformedKeys = 0;
+	outValueTemplate.renderedLength = (uint32_t)inValueLen;
+	outValueTemplate.firstToken = (uint32_t)ioTemplateTokens.size();
+	STemplateToken	token;
+	size_t	literalStart = 0;
+	size_t	index = 0;
+	while (index < inValueLen)
+	{
+		if (inValue[index] != '{')
+		{
+			index++;
+			continue;
+		}
+		size_t	keyStart = index + 1;
+		size_t	keyEnd = keyStart;
+		for (; keyEnd < inValueLen && inValue[keyEnd] != '}'; keyEnd++){}
+		if (keyEnd < inValueLen &&
+			keyEnd > keyStart)
+		{
+			if (index > literalStart)
+			{
+				token.offset = (uint32_t)literalStart;
+				token.length = (uint32_t)(index - literalStart);
+				token.keyHash = 0;
+				token.isKey = false;
+				ioTemplateTokens.push_back(token);
+			}
+			token.offset = (uint32_t)keyStart;
+			token.length = (uint32_t)(keyEnd - keyStart);
+			token.keyHash = KeyValueStore::Hash(&inValue[keyStart], keyEnd - keyStart);
+			token.isKey = true;
+			ioTemplateTokens.push_back(token);
+			literalStart = keyEnd + 1;
+		} else
+		{
+			outValueTemplate.malformedKeys++;
+			if (keyEnd == inValueLen)
+			{
+				break;
+			}
+		}
+		index = keyEnd + 1;
+	}
+	if (inValueLen > literalStart)
+	{
+		token.offset = (uint32_t)literalStart;
+		token.length = (uint32_t)(inValueLen - literalStart);
+		token.keyHash = 0;
+		token.isKey = false;
+		ioTemplateTokens.push_back(token);
+	}
+	outValueTemplate.numTokens = (uint32_t)ioTemplateTokens.size() - outValueTemplate.firstToken;
+}
+
+/*************************** CompileValueTemplates ****************************/
+/*
+*	Compiles the template of each value not yet compiled.  Templates replaced
+*	since they were compiled leave their tokens behind, so the tokens are
+*	rebuilt rather than appended to when there are more than twice as many
+*	as needed.
+*/
+void ConfigurationFile::CompileValueTemplates(void)
+{
+	mTemplates.resize(mStore.GetEntryCount());
+	const char*	key;
+	const char*	value;
+	size_t	keyLen, valueLen;
+	size_t	tokensUsed = 0;
+	for (uint32_t index = 0; index < mStore.GetEntryCount(); index++)
+	{
+		if (mStore.GetEntry(index, key, keyLen, value, valueLen) &&
+			mTemplates[index].valueStamp == mStore.GetValueStamp(index))
+		{
+			tokensUsed += mTemplates[index].numTokens;
+		}
+	}
+	if (mTemplateTokens.size() > tokensUsed * 2)
+	{
+		mTemplates.assign(mStore.GetEntryCount(), SValueTemplate());
+		mTemplateTokens.clear();
+	}
+	for (uint32_t index = 0; index < mStore.GetEntryCount(); index++)
+	{
+		if (mStore.GetEntry(index, key, keyLen, value, valueLen))
+		{
+			GetValueTemplate(index);
+		}
+	}
+}
+
 #pragma mark - BoardsConfigFile
 const std::string	BoardsConfigFile::kMenuKey("menu");
 
@@ -349,12 +627,120 @@ bool BoardsConfigFile::ReadFile(
 	const char*		inPath,
 	bool			inDoKeyFiltering)
 {
-	mDoKeyFiltering = inDoKeyFiltering;
-	bool success = ConfigurationFile::ReadFile(inPath);
+	bool success = inDoKeyFiltering ? ReadFilteredFile(inPath) : ConfigurationFile::ReadFile(inPath);
 	mDoKeyFiltering = false;
 	return(success);
 }
 
+/****************************** ReadFilteredFile ******************************/
+/*
+*	Reads the key values relevant to the FQBN, the same key values that
+*	InsertKeyValue keeps when filtering, without copying the lines of other
+*	boards.  Each line is checked for the ID prefix (mID + '.') in the file
+*	buffer, and a line without it is skipped by finding the next newline.
+*	Only the keys kept are copied, from the file buffer directly to the store.
+*
+*	As in ReadNextKeyValue, whitespace before a key and lines starting with #
+*	are skipped.  A line without an = is ignored.
+*/
+bool BoardsConfigFile::ReadFilteredFile(
+	const char*	inPath)
+{
+	FileInputBuffer	inputBuffer(inPath);
+	bool	success = inputBuffer.GetBufferSize() != 0;
+	if (success)
+	{
+		const char*	line = (const char*)inputBuffer.GetBuffer();
+		const char*	bufferEnd = &line[inputBuffer.GetBufferSize()];
+		size_t	idLen = mID.size();
+		while (line < bufferEnd)
+		{
+			if (isspace((uint8_t)*line))
+			{
+				line++;
+				continue;
+			}
+			const char*	lineEnd = (const char*)memchr(line, '\n', bufferEnd - line);
+			if (!lineEnd)
+			{
+				lineEnd = bufferEnd;
+			}
+			const char*	equal;
+			if ((size_t)(lineEnd - line) > idLen &&
+				line[idLen] == '.' &&
+				memcmp(line, mID.c_str(), idLen) == 0 &&
+				(equal = (const char*)memchr(line, '=', lineEnd - line)) != NULL)
+			{
+				const char*	key = &line[idLen + 1];
+				size_t	keyLen = equal - key;
+				if (keyLen > kMenuKey.size() &&
+					key[kMenuKey.size()] == '.' &&
+					memcmp(key, kMenuKey.c_str(), kMenuKey.size()) == 0)
+				{
+					keyLen -= kMenuKey.size() + 1;
+					key = SelectedMenuItemKey(&key[kMenuKey.size() + 1], keyLen);
+				}
+				if (key &&
+					keyLen)
+				{
+					const char*	value = &equal[1];
+					const char*	valueEnd = lineEnd;
+					if (valueEnd < bufferEnd &&
+						valueEnd[-1] == '\r')	// \r\n
+					{
+						valueEnd--;
+					}
+					mStore.Insert(key, keyLen, value, valueEnd - value);
+				}
+			}
+			line = &lineEnd[1];
+		}
+		KeyValuesChanged();
+	}
+	return(success);
+}
+
+/**************************** SelectedMenuItemKey *****************************/
+/*
+*	inMenuKey follows ID.menu. of a boards.txt key, e.g. for the key
+*	644.menu.variant.modelP.build.mcu it's variant.modelP.build.mcu.  If the
+*	menu item (modelP) is selected for the menu (variant) by the FQBN, the
+*	key following the menu item (build.mcu) is returned, otherwise NULL.
+*/
+const char* BoardsConfigFile::SelectedMenuItemKey(
+	const char*	inMenuKey,
+	size_t&		ioKeyLen) const
+{
+	const char*	key = NULL;
+	const char*	keyEnd = &inMenuKey[ioKeyLen];
+	const char*	menuEnd = (const char*)memchr(inMenuKey, '.', ioKeyLen);
+	if (menuEnd)
+	{
+		const char*	item = &menuEnd[1];
+		const char*	itemEnd = (const char*)memchr(item, '.', keyEnd - item);
+		if (itemEnd)
+		{
+			size_t	menuLen = menuEnd - inMenuKey;
+			size_t	itemLen = itemEnd - item;
+			for (const auto& menu : mMenu)
+			{
+				if (menu.first.size() == menuLen &&
+					memcmp(menu.first.c_str(), inMenuKey, menuLen) == 0)
+				{
+					if (menu.second.size() == itemLen &&
+						memcmp(menu.second.c_str(), item, itemLen) == 0)
+					{
+						key = &itemEnd[1];
+						ioKeyLen = keyEnd - key;
+					}
+					break;
+				}
+			}
+		}
+	}
+	return(key);
+}
+
 /********************** ReadDelimitedKeyValuesFromString **********************/
 uint8_t BoardsConfigFile::ReadDelimitedKeyValuesFromString(
 	const std::string&		inString,
@@ -516,9 +902,10 @@ void BoardsConfigFile::InsertKeyValue(
 *	Ex: for the passed key prefix: tools.avrdude.
 *	tools.avrdude.cmd.path would become cmd.path
 *	On exit there will be no keys with the passed key prefix (they'll all
-*	have been promoted).
-*	This may end up with an empty key object.  In this example 'tools.' will still
-*	exist, and if 'avrdude.' was its only child then 'tools.' will be empty.
+*	have been promoted).  A promoted key replaces the value of an existing key
+*	of the same name.
+*	In an overlay the keys of the base are promoted into the overlay, but
+*	because the base isn't changed its keys with the prefix remain visible.
 */
 bool BoardsConfigFile::Promote(
 	const std::string&	inKeyPrefix)
@@ -526,43 +913,17 @@ bool BoardsConfigFile::Promote(
 	bool	foundKeyValue = false;
 	if (inKeyPrefix.end()[-1] == '.')
 	{
-		JSONObject*		parentObject = NULL;
-		JSONObject*		childObject = (JSONObject*)mRootObject;
-		StringInputBuffer	inputBuffer(inKeyPrefix);
-		uint8_t thisChar = inputBuffer.CurrChar();
-		if (thisChar)
+		KeyValuePairs	promoted;
+		GetKeyValuesWithPrefix(inKeyPrefix, promoted);
+		for (const auto& keyValue : promoted)
 		{
-			std::string	key;
-
-			inputBuffer.StartSubString();
-			for (; thisChar; thisChar = inputBuffer.NextChar())
-			{
-				if (thisChar != '.')
-				{
-					continue;
-				} else
-				{
-					key.clear();
-					parentObject = childObject;
-					inputBuffer++;	// Include the Delimiter
-					inputBuffer.AppendSubString(key);
-					inputBuffer--;
-					childObject = (JSONObject*)parentObject->GetElement(key, IJSONElement::eObject);
-					if (!childObject)
-					{
-						break;
-					}
-					inputBuffer++;	// Skip the Delimiter
-					inputBuffer.StartSubString();
-				}
-			}
-			if (childObject)
-			{
-				parentObject->DetachElement(key);
-				mRootObject->Apply(childObject);
-				delete childObject;
-			}
+			mStore.Erase((inKeyPrefix + keyValue.first).c_str(), inKeyPrefix.size() + keyValue.first.size());
 		}
+		for (const auto& keyValue : promoted)
+		{
+			mStore.Insert(keyValue.first, keyValue.second);
+		}
+		KeyValuesChanged();
 	}
 	return(foundKeyValue);
 }
@@ -572,6 +933,24 @@ void BoardsConfigFile::Copy(
 	const BoardsConfigFile&	inConfigurationFile)
 {
 	ConfigurationFile::Copy(inConfigurationFile);
+	CopyBoard(inConfigurationFile);
+}
+
+/********************************** Overlay ***********************************/
+/*
+*	Makes this an empty layer over inBase for the same board.
+*/
+void BoardsConfigFile::Overlay(
+	const BoardsConfigFile&	inBase)
+{
+	ConfigurationFile::Overlay(inBase);
+	CopyBoard(inBase);
+}
+
+/********************************* CopyBoard **********************************/
+void BoardsConfigFile::CopyBoard(
+	const BoardsConfigFile&	inConfigurationFile)
+{
 	mDoKeyFiltering = inConfigurationFile.mDoKeyFiltering;
 	mFQBN.assign(inConfigurationFile.mFQBN);
 	mCoreFQBNPrefix.assign(inConfigurationFile.mCoreFQBNPrefix);
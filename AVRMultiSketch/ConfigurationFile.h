@@ -30,6 +30,7 @@
 #ifndef ConfigurationFile_h
 #define ConfigurationFile_h
 
+#include "KeyValueStore.h"
 #include <map>
 #include <stdio.h>
 #include <vector>
@@ -37,11 +38,39 @@
 class InputBuffer;
 class JSONObject;
 
+/*
+*	The key values are kept in a flat store keyed by the full dotted key, so
+*	a lookup is a hash of the key rather than a walk of a tree of objects, one
+*	per key segment.  The equivalent tree is only built when GetRootObject is
+*	called, e.g. to dump the configuration.
+*
+*	ValueForKey compiles each value it expands into a template of literal text
+*	and {key} references the first time the value is used, or all at once by
+*	CompileValueTemplates.  The templates are copied with the configuration,
+*	so the recipes of an FQBN are only parsed once no matter how many sketches
+*	use copies of its configuration.  A template is only recompiled when the
+*	value it was compiled from changes.  Because of this cache, ValueForKey
+*	must not be called concurrently on the same configuration.
+*
+*	A configuration can be made an overlay of another by Overlay.  The overlay
+*	only holds the key values inserted into it, every other lookup falls
+*	through to the base, so the per sketch keys (build.path, object_files,
+*	etc.) can be set without copying the FQBN's configuration.  A {key} in a
+*	base value is looked up starting at the overlay, so {build.path} in a
+*	recipe resolves to the sketch's build.path.  The base is only read, using
+*	its compiled templates, so any number of overlays of the same base can be
+*	used concurrently.  The base must outlive its overlays and must not be
+*	changed while they're in use.
+*/
 class ConfigurationFile
 {
 public:
 							ConfigurationFile(void);
+							ConfigurationFile(
+								const ConfigurationFile& inConfigurationFile);
 	virtual					~ConfigurationFile(void);
+	ConfigurationFile&		operator = (
+								const ConfigurationFile& inConfigurationFile);
 	virtual bool			ReadFile(
 								const char*				inPath);
 	virtual uint8_t			ReadDelimitedKeyValuesFromString(
@@ -63,13 +92,78 @@ public:
 	void					Copy(
 								const ConfigurationFile& inConfigurationFile);
 	void					Clear(void);
-	const JSONObject*		GetRootObject(void) const
-								{return(mRootObject);}
+							// Clears this and makes it an empty layer over inBase.
+	void					Overlay(
+								const ConfigurationFile& inBase);
+	const ConfigurationFile* GetBase(void) const
+								{return(mBase);}
+							// Call before the configuration is copied or overlaid for each sketch.
+	void					CompileValueTemplates(void);
+							// Builds the tree, only valid until the next change.
+	const JSONObject*		GetRootObject(void) const;
+	const KeyValueStore&	GetKeyValues(void) const
+								{return(mStore);}
+							// Replaces this layer's key values, see KeyValueStore::SetImage.
+	bool					SetKeyValuesImage(
+								const void*				inImage,
+								size_t					inImageSize);
 protected:
-	JSONObject*	mRootObject;
+	/*
+	*	A {key} reference or literal text of a value.  The offset is relative
+	*	to the start of the value.
+	*/
+	struct STemplateToken
+	{
+		uint32_t	offset;
+		uint32_t	length;
+		uint32_t	keyHash;	// Only used by a {key} reference
+		bool		isKey;
+	};
+	/*
+	*	The tokens of all of the templates are kept in one vector so that
+	*	copying the templates doesn't allocate per template.
+	*/
+	struct SValueTemplate
+	{
+		uint32_t	valueStamp;		// 0 until compiled, see KeyValueStore
+		uint32_t	malformedKeys;	// Number of {} and unterminated {
+		uint32_t	renderedLength;	// Of the last expansion, reserved by the next
+		uint32_t	firstToken;
+		uint32_t	numTokens;
+	};
+	typedef std::vector<SValueTemplate> ValueTemplates;
+	typedef std::vector<STemplateToken> TemplateTokens;
+	typedef std::vector<std::pair<std::string, std::string> > KeyValuePairs;
+	KeyValueStore		mStore;
+	const ConfigurationFile* mBase;	// Unresolved lookups fall through to it
+	mutable ValueTemplates	mTemplates;	// Indexed by store entry
+	mutable TemplateTokens	mTemplateTokens;
+	mutable JSONObject*	mRootObject;	// Built on demand by GetRootObject
 
 	uint8_t					ReadNextKeyValue(
 								InputBuffer&			inInputBuffer);
+	bool					AppendValueForKey(
+								const char*				inKey,
+								size_t					inKeyLen,
+								uint32_t				inKeyHash,
+								std::string&			ioValue,
+								uint32_t&				ioKeysNotFound) const;
+	void					GetKeyValuesWithPrefix(
+								const std::string&		inKeyPrefix,
+								KeyValuePairs&			outKeyValues) const;
+	const ConfigurationFile* FindLayerEntry(
+								const char*				inKey,
+								size_t					inKeyLen,
+								uint32_t				inKeyHash,
+								uint32_t&				outEntryIndex) const;
+	const SValueTemplate&	GetValueTemplate(
+								uint32_t				inEntryIndex) const;
+	static void				CompileValueTemplate(
+								const char*				inValue,
+								size_t					inValueLen,
+								SValueTemplate&			outValueTemplate,
+								TemplateTokens&			ioTemplateTokens);
+	void					KeyValuesChanged(void);
 };
 
 typedef std::map<std::string, std::string> StringMap;
@@ -112,6 +206,8 @@ public:
 								const std::string&		inKeyPrefix);
 	void					Copy(
 								const BoardsConfigFile& inConfigurationFile);
+	void					Overlay(
+								const BoardsConfigFile& inBase);
 protected:
 	bool			mDoKeyFiltering;
 	std::string		mFQBN;
@@ -122,6 +218,13 @@ protected:
 	StringMap		mMenu;
 	static const std::string	kMenuKey;
 
+	bool					ReadFilteredFile(
+								const char*				inPath);
+	const char*				SelectedMenuItemKey(
+								const char*				inMenuKey,
+								size_t&					ioKeyLen) const;
+	void					CopyBoard(
+								const BoardsConfigFile& inConfigurationFile);
 };
 
 typedef std::map<std::string, BoardsConfigFile*> BoardsConfigFileMap;
@@ -26,6 +26,12 @@
 //
 
 #include "ElfFile.h"
+#include "BuildTrace.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // kSectName mirrors ESectName.  Any change made here must be reflected in ESectName
 // This array is maintained in alphabetical order
@@ -51,7 +57,8 @@ static const char*	kSectName[] =	{
 
 /********************************** ElfFile ***********************************/
 ElfFile::ElfFile(void)
-	: mContent(NULL)
+	: mContent(NULL), mFileSize(0), mIsMapped(false), mSectTable(NULL),
+	  mNumSectEntries(0)
 {
 }
 
@@ -66,14 +73,35 @@ void ElfFile::FreeMem(void)
 {
 	if (mContent)
 	{
-		delete [] mContent;
+		if (mIsMapped)
+		{
+			munmap(mContent, mFileSize);
+		} else
+		{
+			delete [] mContent;
+		}
 		mContent = NULL;
 	}
+	mIsMapped = false;
+	mMappedPath.clear();
+	mDirtyPages.Clear();
+	mSymbolIndex.clear();
+	mSectNameIndex.clear();
+	mSectTable = NULL;
+	mNumSectEntries = 0;
 }
 
 /********************************** ReadFile **********************************/
+/*
+*	When inMapFile is true the file is memory mapped rather than copied.  The
+*	mapping is private (copy-on-write) so any patching only affects the pages
+*	touched.  Patches made via pointers returned by GetSymbolValuePtr should
+*	be made by Patch, or be followed by a call to MarkDirty, so that WriteFile
+*	knows which pages to write back.
+*/
 bool ElfFile::ReadFile(
-	const char*				inPath)
+	const char*				inPath,
+	bool					inMapFile)
 {
 	bool	success = false;
 
@@ -81,41 +109,60 @@ bool ElfFile::ReadFile(
 	FILE*    file = fopen(inPath, "rb");
 	if (file)
 	{
-		fseek(file, 0, SEEK_END);
-		mFileSize = 0;
-		fgetpos(file, &mFileSize);
-		rewind(file);
-		mContent = new uint8_t[mFileSize];
-		size_t	bytesRead = fread(mContent, 1, mFileSize, file);
+		struct stat	fileStat;
+		if (fstat(fileno(file), &fileStat) == 0 &&
+			fileStat.st_size >= (off_t)sizeof(SElfHeader))
+		{
+			mFileSize = fileStat.st_size;
+			if (inMapFile)
+			{
+				void*	mappedContent = mmap(NULL, mFileSize, PROT_READ | PROT_WRITE,
+											MAP_PRIVATE, fileno(file), 0);
+				if (mappedContent != MAP_FAILED)
+				{
+					mContent = (uint8_t*)mappedContent;
+					mIsMapped = true;
+					mMappedPath.assign(inPath);
+					success = true;
+				}
+			} else
+			{
+				mContent = new uint8_t[mFileSize];
+				success = fread(mContent, 1, mFileSize, file) == mFileSize;
+			}
+		}
 		fclose(file);
-		mHeader = (SElfHeader*)mContent;
-		if (bytesRead == mFileSize &&
-			mHeader->magicNumber == 0x464c457f)
+		if (success)
+		{
+			mHeader = (SElfHeader*)mContent;
+			success = mHeader->magicNumber == 0x464c457f &&
+				mHeader->sectEntryNamesIndex < mHeader->numSectEntries &&
+				(size_t)mHeader->sectHdrOffset + mHeader->numSectEntries * sizeof(SSectEntry) <= mFileSize &&
+				(size_t)mHeader->progHdrOffset + mHeader->numProgEntries * sizeof(SProgEntry) <= mFileSize;
+		}
+		if (success)
 		{
 			for (uint32_t j = 0; j < eNumSectNames; j++)
 			{
-				mShndxLkup[j] = 0;
 				mSectEntry[j] = NULL;
 			}
 			
-			SSectEntry*	sectEntry = (SSectEntry*)&mContent[mHeader->sectHdrOffset];
-			const char* sectEntryNames = (const char*)&mContent[sectEntry[mHeader->sectEntryNamesIndex].offset];
-			uint32_t	numSectEntriesFound = 0;
-			for (uint32_t i = 0; i < mHeader->numSectEntries; i++)
+			mSectTable = (SSectEntry*)&mContent[mHeader->sectHdrOffset];
+			mNumSectEntries = mHeader->numSectEntries;
+			for (uint32_t i = 0; i < mNumSectEntries; i++)
 			{
-				uint32_t	index = SectionNameToIndex(&sectEntryNames[sectEntry[i].nameOffset]);
+				uint32_t	index = SectionNameToIndex(GetSectName(&mSectTable[i]));
 				if (index < eNumSectNames)
 				{
-					numSectEntriesFound++;
-					mSectEntry[index] = &sectEntry[i];
-				}
-				if (i < eNumSectNames)
-				{
-					mShndxLkup[i] = index;
+					mSectEntry[index] = &mSectTable[i];
 				}
 			}
 			success = HasRequiredSections();
 		}
+		if (success)
+		{
+			BuildTrace::Count(BuildTrace::eBytesRead, mFileSize);
+		}
 	}
 	if (!success)
 	{
@@ -125,6 +172,40 @@ bool ElfFile::ReadFile(
 	return(success);
 }
 
+/********************************* MarkDirty **********************************/
+/*
+*	Records the pages of mContent modified by the caller.  Only needed when
+*	the file is mapped, but harmless otherwise.
+*/
+void ElfFile::MarkDirty(
+	const void*	inPtr,
+	uint32_t	inLength)
+{
+	if (mContent && inLength)
+	{
+		size_t	pageSize = getpagesize();
+		size_t	offset = (const uint8_t*)inPtr - mContent;
+		if (offset < mFileSize)
+		{
+			mDirtyPages.Set((uint32_t)(offset/pageSize), (uint32_t)((offset + inLength - 1)/pageSize));
+		}
+	}
+}
+
+/*********************************** Patch ************************************/
+/*
+*	Copies inLength bytes from inBytes to inPtr within mContent and marks the
+*	pages written as dirty.
+*/
+void ElfFile::Patch(
+	void*		inPtr,
+	const void*	inBytes,
+	uint32_t	inLength)
+{
+	memcpy(inPtr, inBytes, inLength);
+	MarkDirty(inPtr, inLength);
+}
+
 /**************************** HasRequiredSections *****************************/
 bool ElfFile::HasRequiredSections(void) const
 {
@@ -134,18 +215,56 @@ bool ElfFile::HasRequiredSections(void) const
 }
 
 /********************************* WriteFile **********************************/
+/*
+*	If the file is mapped and is being written back to the path it was read
+*	from, only the pages marked dirty are written.  Otherwise the entire
+*	content is written.
+*/
 bool ElfFile::WriteFile(
 	const char*	inPath)
 {
 	bool success = false;
 	if (mContent)
 	{
-		FILE*    file = fopen(inPath, "wb");
-		if (file)
+		if (mIsMapped &&
+			mMappedPath == inPath)
 		{
-			fwrite(mContent, 1, mFileSize, file);
-			fclose(file);
-			success = true;
+			int	fd = open(inPath, O_WRONLY);
+			if (fd >= 0)
+			{
+				size_t	pageSize = getpagesize();
+				const Runs&	dirtyRuns = mDirtyPages.GetRuns();
+				size_t	numRuns = dirtyRuns.size();
+				success = true;
+				for (size_t runIndex = 0; success && runIndex < numRuns; runIndex++)
+				{
+					if (mDirtyPages.GetRunValue(runIndex))
+					{
+						size_t	start = dirtyRuns[runIndex] * pageSize;
+						size_t	end = dirtyRuns[runIndex+1] * pageSize;
+						if (end > mFileSize)
+						{
+							end = mFileSize;
+						}
+						success = pwrite(fd, &mContent[start], end - start, start) == (ssize_t)(end - start);
+						BuildTrace::Count(BuildTrace::eBytesWritten, end - start);
+					}
+				}
+				close(fd);
+				if (success)
+				{
+					mDirtyPages.Clear();
+				}
+			}
+		} else
+		{
+			FILE*    file = fopen(inPath, "wb");
+			if (file)
+			{
+				success = fwrite(mContent, 1, mFileSize, file) == mFileSize;
+				fclose(file);
+				BuildTrace::Count(BuildTrace::eBytesWritten, mFileSize);
+			}
 		}
 	}
 	return(success);
@@ -164,33 +283,281 @@ uint8_t* ElfFile::GetSymbolValuePtr(
 	const SSymbolTblEntry**	outSymTblEntry)
 {
 	uint8_t*	symbolOffset = NULL;
-	
+	const SSymbolTblEntry*	symbolTblEntry = FindSymbol(inSymbolName);
+	if (symbolTblEntry)
+	{
+		symbolOffset = GetSymbolValuePtr(symbolTblEntry);
+		if (outSymTblEntry)
+		{
+			*outSymTblEntry = symbolTblEntry;
+		}
+	}
+	return(symbolOffset);
+}
+
+/***************************** GetSymbolValuePtr ******************************/
+/*
+*	Returns the address within the elf file of the symbol table entry's value,
+*	or NULL if the symbol has no related section or the section has no content
+*	in the file (e.g. .bss)
+*/
+uint8_t* ElfFile::GetSymbolValuePtr(
+	const SSymbolTblEntry*	inSymTblEntry)
+{
+	uint8_t*	symbolOffset = NULL;
+	const SSectEntry*	thisSectEntry = GetSectEntryByIndex(inSymTblEntry->shndx);
+	if (thisSectEntry &&
+		thisSectEntry->type != eSHT_NULL &&
+		thisSectEntry->type != eSHT_NOBITS)
+	{
+		uint32_t	contentOffset = thisSectEntry->offset + (inSymTblEntry->value - thisSectEntry->addrInMem);
+		symbolOffset = &mContent[contentOffset];
+	}
+	return(symbolOffset);
+}
+
+/******************************** GetSectEntry ********************************/
+/*
+*	Returns the section header named inSectName or NULL if not found.  The
+*	name to index map is built on the first call.
+*/
+SSectEntry* ElfFile::GetSectEntry(
+	const char*	inSectName)
+{
+	SSectEntry*	sectEntry = NULL;
+	if (mContent)
+	{
+		if (mSectNameIndex.empty())
+		{
+			for (uint32_t i = 0; i < mNumSectEntries; i++)
+			{
+				// emplace doesn't replace, so where a name occurs more than once
+				// the first section wins.
+				mSectNameIndex.emplace(GetSectName(&mSectTable[i]), i);
+			}
+		}
+		SectNameIndex::const_iterator	itr = mSectNameIndex.find(inSectName);
+		if (itr != mSectNameIndex.end())
+		{
+			sectEntry = &mSectTable[itr->second];
+		}
+	}
+	return(sectEntry);
+}
+
+/******************************** GetSectName *********************************/
+const char* ElfFile::GetSectName(
+	const SSectEntry*	inSectEntry) const
+{
+	const char* sectEntryNames = (const char*)&mContent[mSectTable[mHeader->sectEntryNamesIndex].offset];
+	return(&sectEntryNames[inSectEntry->nameOffset]);
+}
+
+/***************************** GetSectLoadAddress *****************************/
+/*
+*	Returns the load memory address (LMA) of the section.  For AVR the LMA of
+*	.data is in flash following .text, while its address (VMA) is in SRAM.
+*	The LMA is derived from the program header of the loadable segment
+*	containing the section, the same way BFD does it.  If the section isn't
+*	contained in a loadable segment the LMA is the same as the VMA.
+*/
+uint32_t ElfFile::GetSectLoadAddress(
+	const SSectEntry*	inSectEntry) const
+{
+	uint32_t	loadAddress = inSectEntry->addrInMem;
+	if (inSectEntry->flags & eSHF_ALLOC)
+	{
+		/*
+		*	Some linkers leave all of the physical addresses 0.  When there's
+		*	more than one loadable segment the LMA is left as the VMA to avoid
+		*	sections with overlapping LMAs.
+		*/
+		uint32_t	numLoadEntries = 0;
+		uint32_t	i = 0;
+		for (; i < mHeader->numProgEntries; i++)
+		{
+			const SProgEntry*	progEntry = GetProgEntry(i);
+			if (progEntry->physicalAddr != 0)
+			{
+				break;
+			} else if (progEntry->type == ePT_LOAD && progEntry->sizeInMem != 0)
+			{
+				numLoadEntries++;
+			}
+		}
+		if (i < mHeader->numProgEntries || numLoadEntries <= 1)
+		{
+			bool	hasContent = inSectEntry->type != eSHT_NOBITS;
+			for (i = 0; i < mHeader->numProgEntries; i++)
+			{
+				const SProgEntry*	progEntry = GetProgEntry(i);
+				if (progEntry->type == ePT_LOAD &&
+					inSectEntry->addrInMem >= progEntry->virtualAddr &&
+					inSectEntry->addrInMem - progEntry->virtualAddr + inSectEntry->size <= progEntry->sizeInMem &&
+					(!hasContent ||
+						(inSectEntry->offset >= progEntry->offset &&
+						 inSectEntry->offset - progEntry->offset + inSectEntry->size <= progEntry->sizeOnFile)))
+				{
+					loadAddress = hasContent ?
+						progEntry->physicalAddr + (inSectEntry->offset - progEntry->offset) :
+						progEntry->physicalAddr + (inSectEntry->addrInMem - progEntry->virtualAddr);
+					// A zero length section at the boundary between two contiguous
+					// segments belongs to the one whose addresses contain it.
+					if (inSectEntry->addrInMem + inSectEntry->size <= progEntry->virtualAddr + progEntry->sizeInMem)
+					{
+						break;
+					}
+				}
+			}
+		}
+	}
+	return(loadAddress);
+}
+
+/******************************* ResolveSymbols *******************************/
+/*
+*	Resolves a list of symbols in one go.  The symbol table is only walked once,
+*	when the symbol index is built (if it hasn't been already), after that each
+*	name is a hash lookup.
+*	Returns true if all of the symbols were found.  The names of any symbols
+*	not found are listed in outResolved.missing.
+*/
+bool ElfFile::ResolveSymbols(
+	const char* const	inSymbolNames[],
+	uint32_t			inNumSymbols,
+	SResolvedSymbols&	outResolved)
+{
+	outResolved.symbols.resize(inNumSymbols);
+	outResolved.missing.clear();
+	for (uint32_t i = 0; i < inNumSymbols; i++)
+	{
+		SResolvedSymbol&	resolved = outResolved.symbols[i];
+		resolved.name = inSymbolNames[i];
+		resolved.symTblEntry = FindSymbol(inSymbolNames[i]);
+		resolved.valuePtr = resolved.symTblEntry ? GetSymbolValuePtr(resolved.symTblEntry) : NULL;
+		if (!resolved.symTblEntry)
+		{
+			if (!outResolved.missing.empty())
+			{
+				outResolved.missing.append(", ");
+			}
+			outResolved.missing.append(inSymbolNames[i]);
+		}
+	}
+	return(outResolved.missing.empty());
+}
+
+/********************************* FindSymbol *********************************/
+/*
+*	Returns the symbol table entry for inSymbolName or NULL if not found.
+*	The symbol index is built on the first call.
+*/
+const SSymbolTblEntry* ElfFile::FindSymbol(
+	const char*	inSymbolName)
+{
+	const SSymbolTblEntry*	foundEntry = NULL;
+	if (mContent)
+	{
+		if (mSymbolIndex.empty())
+		{
+			BuildSymbolIndex();
+		}
+		const char* stringTable = (const char*)&mContent[GetSectEntry(eStringTable)->offset];
+		const SSymbolTblEntry*	symbolTable = (const SSymbolTblEntry*)&mContent[GetSectEntry(eSymbolTable)->offset];
+		uint32_t	mask = (uint32_t)mSymbolIndex.size() - 1;
+		for (uint32_t slot = HashSymbolName(inSymbolName) & mask; mSymbolIndex[slot]; slot = (slot + 1) & mask)
+		{
+			const SSymbolTblEntry*	symbolTblEntry = &symbolTable[mSymbolIndex[slot]-1];
+			if (strcmp(inSymbolName, &stringTable[symbolTblEntry->name]) == 0)
+			{
+				foundEntry = symbolTblEntry;
+				break;
+			}
+		}
+	}
+	return(foundEntry);
+}
+
+/******************************* GetSymbolTable *******************************/
+SSymbolTblEntry* ElfFile::GetSymbolTable(
+	uint32_t&	outNumSymbols)
+{
+	SSymbolTblEntry*	symbolTable = NULL;
+	const SSectEntry*	symTableSectEntry = mContent ? GetSectEntry(eSymbolTable) : NULL;
+	outNumSymbols = 0;
+	if (symTableSectEntry)
+	{
+		symbolTable = (SSymbolTblEntry*)&mContent[symTableSectEntry->offset];
+		outNumSymbols = symTableSectEntry->size/symTableSectEntry->entrySize;
+	}
+	return(symbolTable);
+}
+
+/******************************* GetSymbolName ********************************/
+const char* ElfFile::GetSymbolName(
+	const SSymbolTblEntry*	inSymTblEntry)
+{
+	return((const char*)&mContent[GetSectEntry(eStringTable)->offset + inSymTblEntry->name]);
+}
+
+/****************************** BuildSymbolIndex ******************************/
+/*
+*	Builds an open addressing (linear probe) hash table of symbol table indexes
+*	keyed on the symbol name.  The table size is a power of 2 at least twice the
+*	number of symbols so there's always an empty slot to end a probe.
+*	Where a name occurs more than once, the first symbol table entry wins.
+*/
+void ElfFile::BuildSymbolIndex(void)
+{
 	const SSectEntry*	symTableSectEntry = GetSectEntry(eSymbolTable);
 	const char* stringTable = (const char*)&mContent[GetSectEntry(eStringTable)->offset];
 	const SSymbolTblEntry*	symbolTable = (const SSymbolTblEntry*)&mContent[symTableSectEntry->offset];
 	uint32_t	numSymTableEntries = symTableSectEntry->size/symTableSectEntry->entrySize;
-	const SSymbolTblEntry*	symbolTableEnd = &symbolTable[numSymTableEntries];
-
-	for (; symbolTable < symbolTableEnd; symbolTable++)
+	uint32_t	tableSize = 16;
+	while (tableSize < numSymTableEntries*2)
 	{
-		//fprintf(stderr, "%s = %d\n", &stringTable[symbolTable->name], symbolTable->shndx);
-		if (strcmp(inSymbolName, &stringTable[symbolTable->name]) != 0)
+		tableSize <<= 1;
+	}
+	mSymbolIndex.assign(tableSize, 0);
+	uint32_t	mask = tableSize - 1;
+	for (uint32_t i = 0; i < numSymTableEntries; i++)
+	{
+		uint32_t	nameOffset = symbolTable[i].name;
+		if (nameOffset == 0)
 		{
-			continue;
+			continue;	// Unnamed
 		}
-		if (symbolTable->shndx < eNumSectNames)
+		const char*	name = &stringTable[nameOffset];
+		uint32_t slot = HashSymbolName(name) & mask;
+		for (; mSymbolIndex[slot]; slot = (slot + 1) & mask)
 		{
-			const SSectEntry*	thisSectEntry = mSectEntry[mShndxLkup[symbolTable->shndx]];
-			uint32_t	contentOffset = thisSectEntry->offset + (symbolTable->value - thisSectEntry->addrInMem);
-			symbolOffset = &mContent[contentOffset];
+			uint32_t	slotNameOffset = symbolTable[mSymbolIndex[slot]-1].name;
+			if (slotNameOffset == nameOffset ||
+				strcmp(name, &stringTable[slotNameOffset]) == 0)
+			{
+				break;
+			}
 		}
-		if (outSymTblEntry)
+		if (mSymbolIndex[slot] == 0)
 		{
-			*outSymTblEntry = symbolTable;
+			mSymbolIndex[slot] = i + 1;
 		}
-		break;
 	}
-	return(symbolOffset);
+}
+
+/******************************* HashSymbolName *******************************/
+/*
+*	32 bit FNV-1a
+*/
+uint32_t ElfFile::HashSymbolName(
+	const char*	inSymbolName)
+{
+	uint32_t	hash = 2166136261U;
+	for (const uint8_t* namePtr = (const uint8_t*)inSymbolName; *namePtr; namePtr++)
+	{
+		hash = (hash ^ *namePtr) * 16777619U;
+	}
+	return(hash);
 }
 
 /*************************** SectionNameToIndex *******************************/
@@ -29,6 +29,10 @@
 #define ElfFile_h
 
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "IndexVec.h"
 
 struct SElfHeader
 {
@@ -89,6 +93,46 @@ uint8_t		other;
 uint16_t	shndx;
 };
 
+// Relocation entry with an explicit addend (SHT_RELA)
+struct SRelaEntry
+{
+	uint32_t	offset;		// In an executable, the address of the place relocated
+	uint32_t	info;		// Symbol table index << 8 | relocation type
+	int32_t		addend;
+};
+
+struct SResolvedSymbol
+{
+	const char*				name;
+	uint8_t*				valuePtr;		// NULL if not found or no related section
+	const SSymbolTblEntry*	symTblEntry;	// NULL if not found
+};
+
+struct SResolvedSymbols
+{
+	std::vector<SResolvedSymbol>	symbols;	// In the order requested
+	std::string						missing;	// Comma delimited names not found
+};
+
+enum
+{
+	eSHT_NULL		= 0,
+	eSHT_RELA		= 4,	// Relocation entries with addends
+	eSHT_NOBITS		= 8,	// Occupies no space in the file (.bss, .noinit)
+	eSHF_ALLOC		= 2,	// Occupies memory during execution
+	ePT_LOAD		= 1,
+	eSHN_UNDEF		= 0,
+	eSHN_LORESERVE	= 0xFF00,	// Reserved section indexes start here
+	eSHN_ABS		= 0xFFF1	// Absolute symbol, not relative to a section
+};
+
+typedef std::unordered_map<std::string, uint32_t> SectNameIndex;
+
+/*
+*	ESectName is only a cache of the sections used most often.  Any section,
+*	including those not listed here, can be accessed by name or section header
+*	index.
+*/
 // ESectName mirrors kSectName.  Any change made here must be reflected in kSectName
 enum ESectName
 {
@@ -118,26 +162,81 @@ public:
 							ElfFile(void);
 	virtual					~ElfFile(void);
 	bool					ReadFile(
-								const char*				inPath);
+								const char*				inPath,
+								bool					inMapFile = false);
 	bool					WriteFile(
 								const char*				inPath);
 	SSectEntry*				GetSectEntry(
 								ESectName				inESectName)
 							{return(mSectEntry[inESectName]);}
-	void					FreeMem(void);
+	SSectEntry*				GetSectEntry(
+								const char*				inSectName);
+	SSectEntry*				GetSectEntryByIndex(
+								uint32_t				inShndx) const
+							{return(inShndx < mNumSectEntries ? &mSectTable[inShndx] : NULL);}
+	uint32_t				GetNumSectEntries(void) const
+								{return(mNumSectEntries);}
+	const char*				GetSectName(
+								const SSectEntry*		inSectEntry) const;
+	uint32_t				GetSectLoadAddress(
+								const SSectEntry*		inSectEntry) const;
+	SProgEntry*				GetProgEntry(
+								uint32_t				inIndex) const
+							{return(inIndex < mHeader->numProgEntries ?
+								(SProgEntry*)&mContent[mHeader->progHdrOffset + inIndex*sizeof(SProgEntry)] : NULL);}
+	uint32_t				GetEntryPoint(void) const
+								{return(mHeader->entryPoint);}
+	virtual void			FreeMem(void);
+	void					MarkDirty(
+								const void*				inPtr,
+								uint32_t				inLength);
+	void					Patch(
+								void*					inPtr,
+								const void*				inBytes,
+								uint32_t				inLength);
+	bool					IsMapped(void) const
+								{return(mIsMapped);}
+	/*
+	*	The pointers returned by GetSymbolValuePtr, GetSectEntry, GetTextPtr,
+	*	etc. point into mContent.  When the file is mapped and written back to
+	*	the path it was read from, WriteFile only writes the pages marked dirty.
+	*	Anything written through these pointers must be written by Patch, or be
+	*	followed by a call to MarkDirty, or it's silently lost.
+	*/
 	uint8_t*				GetSymbolValuePtr(
 								const char*				inSymbolName,
 								const SSymbolTblEntry**	outSymTblEntry = NULL);
+	bool					ResolveSymbols(
+								const char* const		inSymbolNames[],
+								uint32_t				inNumSymbols,
+								SResolvedSymbols&		outResolved);
+	const SSymbolTblEntry*	FindSymbol(
+								const char*				inSymbolName);
+	SSymbolTblEntry*		GetSymbolTable(
+								uint32_t&				outNumSymbols);
+	const char*				GetSymbolName(
+								const SSymbolTblEntry*	inSymTblEntry);
+	uint8_t*				GetSymbolValuePtr(
+								const SSymbolTblEntry*	inSymTblEntry);
 	uint8_t*				GetTextPtr(void)
 								{return((uint8_t*)&mContent[GetSectEntry(eText)->offset]);}
 protected:
 	uint8_t*	mContent;
-	fpos_t		mFileSize;
+	size_t		mFileSize;
+	bool		mIsMapped;		// mContent is a private (copy-on-write) mapping
+	std::string	mMappedPath;
+	IndexVec	mDirtyPages;	// Pages of mContent modified since ReadFile
+	std::vector<uint32_t>	mSymbolIndex;	// Hash of symbol table index + 1, 0 = empty slot
 	SElfHeader*	mHeader;
+	SSectEntry*	mSectTable;		// Every section header, indexed by shndx
+	uint32_t	mNumSectEntries;
+	SectNameIndex	mSectNameIndex;	// Section name to shndx, built on first use
 	SSectEntry*	mSectEntry[eNumSectNames];
-	uint16_t	mShndxLkup[eNumSectNames];
 	
 	virtual bool			HasRequiredSections(void) const;
+	void					BuildSymbolIndex(void);
+	static uint32_t			HashSymbolName(
+								const char*				inSymbolName);
 
 	static uint32_t			SectionNameToIndex(
 								const char*				inSectionName);
@@ -25,7 +25,9 @@
 //  Copyright © 2018 Jon Mackey. All rights reserved.
 //
 #include "FileInputBuffer.h"
+#include "BuildTrace.h"
 #include "math.h"
+#include <string.h>
 
 /******************************* InputBuffer *******************************/
 InputBuffer::InputBuffer(void)
@@ -510,10 +512,11 @@ uint8_t InputBuffer::FindEndOfToken(void)
 }
 
 #ifdef __GNUC__
-static const uint8_t* kDirectives[] = {"\pdefine", "\pelif", "\pelse", "\pendif",
-										"\perror", "\pifndef", "\pifdef", "\pif",
-										"\pimport", "\pinclude", "\pline", "\ppragma",
-										"\pundef", "\pusing"};
+// Length prefixed (Pascal) strings without depending on -fpascal-strings
+static const char* const kDirectives[] = {"\6define", "\4elif", "\4else", "\5endif",
+										"\5error", "\6ifndef", "\5ifdef", "\2if",
+										"\6import", "\7include", "\4line", "\6pragma",
+										"\5undef", "\5using"};
 /***************************** ReadDirectiveKind ******************************/
 /*
 *	This routine returns the directive type.  If a directive type was found, the
@@ -528,7 +531,7 @@ uint8_t InputBuffer::ReadDirectiveKind(void)
 	{
 		for (uint32_t i = 0; i < numDirectives; i++)
 		{
-			const uint8_t*	directiveStr = kDirectives[i];
+			const uint8_t*	directiveStr = (const uint8_t*)kDirectives[i];
 			fprintf(stderr, "%d \"%s\"\n", (int)directiveStr[0], (const char*)&directiveStr[1]);
 			if (strncmp((const char*)mBufferPtr+1, (const char*)&directiveStr[1], directiveStr[0]))
 			{
@@ -559,7 +562,7 @@ bool InputBuffer::IsAtDirectiveKind(
 	if (CurrChar() == '#' &&
 		inKind < sizeof(kDirectives)/sizeof(uint8_t*))
 	{
-		const uint8_t*	directiveStr = kDirectives[inKind];
+		const uint8_t*	directiveStr = (const uint8_t*)kDirectives[inKind];
 		if (strncmp((const char*)mBufferPtr+1, (const char*)&directiveStr[1], directiveStr[0]) == 0)
 		{
 			if (inSkipIfKind)
@@ -792,13 +795,13 @@ FileInputBuffer::FileInputBuffer(
 	if (file)
 	{
 		fseek(file, 0, SEEK_END);
-		fpos_t	fileSize = 0;
-		fgetpos(file, &fileSize);
+		long	fileSize = ftell(file);	// fpos_t isn't an integer on all platforms
 		rewind(file);
 		if (fileSize > 0)
 		{
 			mFileBuffer = new uint8_t[fileSize];
 			fread(mFileBuffer, 1, fileSize, file);
+			BuildTrace::Count(BuildTrace::eBytesRead, fileSize);
 			mBufferSize = fileSize;
 			mBuffer = mFileBuffer;
 			mSubStringStart = mBufferPtr = mBuffer;
@@ -0,0 +1,244 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  FileStager.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "FileStager.h"
+#include "BuildTrace.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <sys/clonefile.h>
+#elif defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+/********************************* FileStager *********************************/
+FileStager::FileStager(void)
+	: mBytesInFolders(0)
+{
+	for (uint32_t i = 0; i < eNumStageMethods; i++)
+	{
+		mBytesStaged[i] = 0;
+	}
+}
+
+/********************************* StageFile **********************************/
+/*
+*	If inPrivate, inDstPath will be modified so it can't be a hard link to
+*	inSrcPath.
+*/
+bool FileStager::StageFile(
+	const std::string&	inSrcPath,
+	const std::string&	inDstPath,
+	bool				inPrivate)
+{
+	struct stat	srcStat;
+	bool	success = stat(inSrcPath.c_str(), &srcStat) == 0;
+	if (success)
+	{
+		EStageMethod	method = eLinked;
+		unlink(inDstPath.c_str());
+		if (inPrivate ||
+			link(inSrcPath.c_str(), inDstPath.c_str()) != 0)
+		{
+			method = eCloned;
+			if (!CloneFile(inSrcPath, inDstPath))
+			{
+				method = eCopied;
+				success = CopyFile(inSrcPath, inDstPath);
+			}
+		}
+		if (success)
+		{
+			mBytesStaged[method] += srcStat.st_size;
+		}
+	}
+	return(success);
+}
+
+/********************************* CloneFile **********************************/
+bool FileStager::CloneFile(
+	const std::string&	inSrcPath,
+	const std::string&	inDstPath)
+{
+	bool	success = false;
+#ifdef __APPLE__
+	success = clonefile(inSrcPath.c_str(), inDstPath.c_str(), 0) == 0;
+#elif defined(FICLONE)
+	int	srcFD = open(inSrcPath.c_str(), O_RDONLY);
+	if (srcFD >= 0)
+	{
+		int	dstFD = open(inDstPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+		if (dstFD >= 0)
+		{
+			success = ioctl(dstFD, FICLONE, srcFD) == 0;
+			close(dstFD);
+			if (!success)
+			{
+				unlink(inDstPath.c_str());
+			}
+		}
+		close(srcFD);
+	}
+#endif
+	return(success);
+}
+
+/********************************** CopyFile **********************************/
+bool FileStager::CopyFile(
+	const std::string&	inSrcPath,
+	const std::string&	inDstPath)
+{
+	bool	success = false;
+	FILE*    srcFile = fopen(inSrcPath.c_str(), "rb");
+	if (srcFile)
+	{
+		FILE*    dstFile = fopen(inDstPath.c_str(), "wb");
+		if (dstFile)
+		{
+			uint8_t	buffer[0x10000];
+			size_t	bytesRead;
+			success = true;
+			while (success &&
+				(bytesRead = fread(buffer, 1, sizeof(buffer), srcFile)) > 0)
+			{
+				success = fwrite(buffer, 1, bytesRead, dstFile) == bytesRead;
+				BuildTrace::Count(BuildTrace::eBytesRead, bytesRead);
+				BuildTrace::Count(BuildTrace::eBytesWritten, bytesRead);
+			}
+			success = fclose(dstFile) == 0 && ferror(srcFile) == 0 && success;
+		}
+		fclose(srcFile);
+	}
+	return(success);
+}
+
+/******************************** MakeFolders *********************************/
+/*
+*	Creates inFolderPath and any of its parent folders that don't exist.
+*/
+bool FileStager::MakeFolders(
+	const std::string&	inFolderPath)
+{
+	for (size_t slash = inFolderPath.find('/', 1); slash != std::string::npos;
+			slash = inFolderPath.find('/', slash + 1))
+	{
+		mkdir(inFolderPath.substr(0, slash).c_str(), 0755);
+	}
+	struct stat	folderStat;
+	return((mkdir(inFolderPath.c_str(), 0755) == 0 || errno == EEXIST) &&
+			stat(inFolderPath.c_str(), &folderStat) == 0 && S_ISDIR(folderStat.st_mode));
+}
+
+/******************************** RemoveFolder ********************************/
+void FileStager::RemoveFolder(
+	const std::string&	inFolderPath)
+{
+	DIR*	dir = opendir(inFolderPath.c_str());
+	if (dir)
+	{
+		struct dirent*	entry;
+		while ((entry = readdir(dir)) != NULL)
+		{
+			if (strcmp(entry->d_name, ".") == 0 ||
+				strcmp(entry->d_name, "..") == 0)
+			{
+				continue;
+			}
+			std::string	path(inFolderPath + "/" + entry->d_name);
+			struct stat	entryStat;
+			if (lstat(path.c_str(), &entryStat) == 0 &&
+				S_ISDIR(entryStat.st_mode))
+			{
+				RemoveFolder(path);
+			} else
+			{
+				unlink(path.c_str());
+			}
+		}
+		closedir(dir);
+		rmdir(inFolderPath.c_str());
+	}
+}
+
+/******************************** StageFolder *********************************/
+bool FileStager::StageFolder(
+	const std::string&	inSrcFolder,
+	const std::string&	inDstFolder,
+	const StageFilter&	inFilter)
+{
+	BuildSpan	span("StageFolder", inSrcFolder.c_str());
+	return(MakeFolders(inDstFolder) &&
+			StageFolder(inSrcFolder, inDstFolder, std::string(), inFilter));
+}
+
+/******************************** StageFolder *********************************/
+bool FileStager::StageFolder(
+	const std::string&	inSrcFolder,
+	const std::string&	inDstFolder,
+	const std::string&	inRelativePath,
+	const StageFilter&	inFilter)
+{
+	std::string	srcFolderPath(inRelativePath.empty() ? inSrcFolder : (inSrcFolder + "/" + inRelativePath));
+	DIR*	dir = opendir(srcFolderPath.c_str());
+	bool	success = dir != NULL;
+	if (success)
+	{
+		struct dirent*	entry;
+		while (success && (entry = readdir(dir)) != NULL)
+		{
+			if (entry->d_name[0] == '.')
+			{
+				continue;	// Skip ., .., and hidden files
+			}
+			std::string	relativePath(inRelativePath.empty() ? entry->d_name : (inRelativePath + "/" + entry->d_name));
+			struct stat	entryStat;
+			if (lstat((inSrcFolder + "/" + relativePath).c_str(), &entryStat) == 0)
+			{
+				if (S_ISDIR(entryStat.st_mode))
+				{
+					success = StageFolder(inSrcFolder, inDstFolder, relativePath, inFilter);
+				} else if (S_ISREG(entryStat.st_mode))
+				{
+					mBytesInFolders += entryStat.st_size;
+					if (inFilter(relativePath))
+					{
+						std::string	dstPath(inDstFolder + "/" + relativePath);
+						success = MakeFolders(dstPath.substr(0, dstPath.rfind('/'))) &&
+							StageFile(inSrcFolder + "/" + relativePath, dstPath, false);
+					}
+				}
+			}
+		}
+		closedir(dir);
+	}
+	return(success);
+}
@@ -0,0 +1,108 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  FileStager.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef FileStager_h
+#define FileStager_h
+
+#include <functional>
+#include <inttypes.h>
+#include <string>
+
+/*
+*	Returns true if the file at inRelativePath (relative to the folder being
+*	staged) should be staged.
+*/
+typedef std::function<bool(const std::string& inRelativePath)> StageFilter;
+
+/*
+*	FileStager brings files from the Arduino temporary folders into this
+*	application's temporary folder without copying them where possible.
+*
+*	A file that is only read (object files, archives) is hard linked.  A file
+*	that will be modified in place (the elf file that gets patched) needs a
+*	private copy, so it's cloned (copy on write) if the file system supports
+*	it.  Either way the file is copied if neither is possible.
+*
+*	The number of bytes linked, cloned and copied is tallied, as is the
+*	number of bytes in the source folders that a full copy would have copied.
+*/
+class FileStager
+{
+public:
+	enum EStageMethod
+	{
+		eLinked,
+		eCloned,
+		eCopied,
+		eNumStageMethods
+	};
+							FileStager(void);
+	bool					StageFile(
+								const std::string&		inSrcPath,
+								const std::string&		inDstPath,
+								bool					inPrivate);
+	/*
+	*	Walks inSrcFolder, hard linking (or copying) each file that passes
+	*	inFilter to the same relative path within inDstFolder.  Folders are
+	*	only created as needed.
+	*/
+	bool					StageFolder(
+								const std::string&		inSrcFolder,
+								const std::string&		inDstFolder,
+								const StageFilter&		inFilter);
+	uint64_t				GetBytesStaged(
+								EStageMethod			inMethod) const
+								{return(mBytesStaged[inMethod]);}
+							// The bytes a full copy of the folders would copy
+	uint64_t				GetBytesInFolders(void) const
+								{return(mBytesInFolders);}
+							// The bytes not copied compared to a full copy
+	uint64_t				GetBytesAvoided(void) const
+								{return(mBytesInFolders > mBytesStaged[eCopied] ?
+									(mBytesInFolders - mBytesStaged[eCopied]) : 0);}
+	static bool				CopyFile(
+								const std::string&		inSrcPath,
+								const std::string&		inDstPath);
+	static bool				MakeFolders(
+								const std::string&		inFolderPath);
+							// Removes inFolderPath and everything in it.
+	static void				RemoveFolder(
+								const std::string&		inFolderPath);
+protected:
+	uint64_t	mBytesStaged[eNumStageMethods];
+	uint64_t	mBytesInFolders;
+
+	bool					StageFolder(
+								const std::string&		inSrcFolder,
+								const std::string&		inDstFolder,
+								const std::string&		inRelativePath,
+								const StageFilter&		inFilter);
+	static bool				CloneFile(
+								const std::string&		inSrcPath,
+								const std::string&		inDstPath);
+};
+
+#endif /* FileStager_h */
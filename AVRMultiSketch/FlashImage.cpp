@@ -0,0 +1,263 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  FlashImage.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "FlashImage.h"
+#include "BuildTrace.h"
+#include <stdio.h>
+#include <string.h>
+
+/********************************* FlashImage *********************************/
+FlashImage::FlashImage(
+	uint32_t	inPageSize)
+	: mPageSize(inPageSize), mOverlapFrom(0), mOverlapTo(0)
+{
+}
+
+/******************************** ~FlashImage *********************************/
+FlashImage::~FlashImage(void)
+{
+	Clear();
+}
+
+/*********************************** Clear ************************************/
+void FlashImage::Clear(void)
+{
+	PageMap::iterator	itr = mPages.begin();
+	PageMap::iterator	itrEnd = mPages.end();
+	for (; itr != itrEnd; ++itr)
+	{
+		delete [] itr->second;
+	}
+	mPages.clear();
+	mUsed.Clear();
+	mOverlapFrom = mOverlapTo = 0;
+}
+
+/******************************** FindOverlap *********************************/
+/*
+*	Returns true if inChunk overlaps the bytes of inUsed, setting the overlap
+*	range returned by GetOverlap to the first overlap found.
+*/
+bool FlashImage::FindOverlap(
+	const IndexVec&		inUsed,
+	const SHexChunk&	inChunk)
+{
+	bool	overlaps = false;
+	if (inChunk.size)
+	{
+		uint32_t	chunkEnd = inChunk.address + inChunk.size;
+		const Runs&	usedRuns = inUsed.GetRuns();
+		size_t	numRuns = usedRuns.size();
+		for (size_t runIndex = 0; runIndex + 1 < numRuns; runIndex++)
+		{
+			if (inUsed.GetRunValue(runIndex) &&
+				usedRuns[runIndex] < chunkEnd &&
+				usedRuns[runIndex+1] > inChunk.address)
+			{
+				mOverlapFrom = usedRuns[runIndex] > inChunk.address ? usedRuns[runIndex] : inChunk.address;
+				mOverlapTo = (usedRuns[runIndex+1] < chunkEnd ? usedRuns[runIndex+1] : chunkEnd) - 1;
+				overlaps = true;
+				break;
+			}
+		}
+	}
+	return(overlaps);
+}
+
+/************************************ Copy ************************************/
+/*
+*	Copies inChunk to the pages and marks its bytes as used.  The caller must
+*	have checked that it doesn't overlap.
+*/
+void FlashImage::Copy(
+	const SHexChunk&	inChunk)
+{
+	if (inChunk.size)
+	{
+		mUsed.Set(inChunk.address, inChunk.address + inChunk.size - 1);
+		uint32_t		address = inChunk.address;
+		const uint8_t*	data = inChunk.data;
+		uint32_t		count = inChunk.size;
+		while (count)
+		{
+			uint32_t	pageAddress = address & ~(mPageSize - 1);
+			uint32_t	pageOffset = address - pageAddress;
+			uint32_t	now = mPageSize - pageOffset;
+			if (now > count)
+			{
+				now = count;
+			}
+			uint8_t*&	page = mPages[pageAddress];
+			if (page == NULL)
+			{
+				page = new uint8_t[mPageSize];
+				memset(page, 0xFF, mPageSize);
+			}
+			memcpy(&page[pageOffset], data, now);
+			address += now;
+			data += now;
+			count -= now;
+		}
+	}
+}
+
+/************************************ Add *************************************/
+bool FlashImage::Add(
+	const SHexChunk&	inChunk)
+{
+	bool	success = !FindOverlap(mUsed, inChunk);
+	if (success)
+	{
+		Copy(inChunk);
+	}
+	return(success);
+}
+
+/************************************ Add *************************************/
+/*
+*	Every chunk is checked, against the bytes already added and the chunks
+*	before it, before any is copied so that a failure leaves the image as it
+*	was.
+*/
+bool FlashImage::Add(
+	const HexChunks&	inChunks)
+{
+	bool	success = true;
+	IndexVec	used(mUsed);
+	HexChunks::const_iterator	itr = inChunks.begin();
+	HexChunks::const_iterator	itrEnd = inChunks.end();
+	for (; success && itr != itrEnd; ++itr)
+	{
+		success = !FindOverlap(used, *itr);
+		if (success && itr->size)
+		{
+			used.Set(itr->address, itr->address + itr->size - 1);
+		}
+	}
+	if (success)
+	{
+		for (itr = inChunks.begin(); itr != itrEnd; ++itr)
+		{
+			Copy(*itr);
+		}
+	}
+	return(success);
+}
+
+/********************************** GetBytes **********************************/
+/*
+*	Bytes never added are returned as 0xFF (erased flash).
+*/
+void FlashImage::GetBytes(
+	uint32_t	inAddress,
+	uint32_t	inLength,
+	uint8_t*	outBytes) const
+{
+	while (inLength)
+	{
+		uint32_t	pageAddress = inAddress & ~(mPageSize - 1);
+		uint32_t	pageOffset = inAddress - pageAddress;
+		uint32_t	now = mPageSize - pageOffset;
+		if (now > inLength)
+		{
+			now = inLength;
+		}
+		PageMap::const_iterator	itr = mPages.find(pageAddress);
+		if (itr != mPages.end())
+		{
+			memcpy(outBytes, &itr->second[pageOffset], now);
+		} else
+		{
+			memset(outBytes, 0xFF, now);
+		}
+		inAddress += now;
+		outBytes += now;
+		inLength -= now;
+	}
+}
+
+/******************************** GetUsedRuns *********************************/
+/*
+*	Returns the contiguous runs of bytes added.  The data member of each run
+*	is NULL.
+*/
+void FlashImage::GetUsedRuns(
+	HexChunks&	outRuns) const
+{
+	outRuns.clear();
+	const Runs&	usedRuns = mUsed.GetRuns();
+	size_t	numRuns = usedRuns.size();
+	for (size_t runIndex = 0; runIndex + 1 < numRuns; runIndex++)
+	{
+		if (mUsed.GetRunValue(runIndex))
+		{
+			SHexChunk	run = {usedRuns[runIndex], NULL, usedRuns[runIndex+1] - usedRuns[runIndex]};
+			outRuns.push_back(run);
+		}
+	}
+}
+
+/******************************** WriteHexFile ********************************/
+bool FlashImage::WriteHexFile(
+	const char*	inPath) const
+{
+	HexChunks	runs;
+	GetUsedRuns(runs);
+	std::vector<uint8_t>	content(mUsed.GetCount());
+	IntelHexWriter	hexWriter;
+	uint8_t*	contentPtr = content.data();
+	HexChunks::const_iterator	itr = runs.begin();
+	HexChunks::const_iterator	itrEnd = runs.end();
+	for (; itr != itrEnd; ++itr)
+	{
+		GetBytes(itr->address, itr->size, contentPtr);
+		hexWriter.AddChunk(itr->address, contentPtr, itr->size);
+		contentPtr += itr->size;
+	}
+	return(hexWriter.WriteFile(inPath));
+}
+
+/******************************** WriteBinFile ********************************/
+bool FlashImage::WriteBinFile(
+	const char*	inPath) const
+{
+	bool	success = false;
+	std::vector<uint8_t>	content;
+	if (!mUsed.Empty())
+	{
+		uint32_t	startAddress = mUsed.GetMin();
+		content.resize(mUsed.GetMax() - startAddress);
+		GetBytes(startAddress, (uint32_t)content.size(), content.data());
+	}
+	FILE*    file = fopen(inPath, "wb");
+	if (file)
+	{
+		success = fwrite(content.data(), 1, content.size(), file) == content.size();
+		success = fclose(file) == 0 && success;
+		BuildTrace::Count(BuildTrace::eBytesWritten, content.size());
+	}
+	return(success);
+}
@@ -0,0 +1,96 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  FlashImage.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef FlashImage_h
+#define FlashImage_h
+
+#include <map>
+#include "IndexVec.h"
+#include "IntelHexWriter.h"
+
+typedef std::map<uint32_t, uint8_t*> PageMap;
+
+/*
+*	A sparse memory image made up of fixed size pages allocated as needed.
+*	The bytes added are tracked in an IndexVec so that any attempt to add
+*	bytes to an address already added is detected (e.g. two sketches that
+*	both use the same EEPROM addresses.)
+*
+*	The image can be written as Intel HEX or as a raw binary.
+*/
+class FlashImage
+{
+public:
+							FlashImage(
+								uint32_t				inPageSize = 256);
+	virtual					~FlashImage(void);
+	/*
+	*	Returns false if any of the bytes overlap bytes already added, or for
+	*	HexChunks, bytes of another of its chunks.  In which case nothing is
+	*	added and GetOverlap returns the overlapping range.
+	*/
+	bool					Add(
+								const SHexChunk&		inChunk);
+	bool					Add(
+								const HexChunks&		inChunks);
+	void					GetOverlap(
+								uint32_t&				outFrom,
+								uint32_t&				outTo) const
+							{outFrom = mOverlapFrom; outTo = mOverlapTo;}
+	bool					Empty(void) const
+								{return(mUsed.Empty());}
+	void					GetBytes(
+								uint32_t				inAddress,
+								uint32_t				inLength,
+								uint8_t*				outBytes) const;
+	bool					WriteHexFile(
+								const char*				inPath) const;
+							// From the lowest address added to the highest.
+							// Gaps are filled with 0xFF (erased flash).
+	bool					WriteBinFile(
+								const char*				inPath) const;
+	void					Clear(void);
+protected:
+	uint32_t	mPageSize;	// Must be a power of 2
+	PageMap		mPages;		// Page base address to page
+	IndexVec	mUsed;		// Addresses of the bytes added
+	uint32_t	mOverlapFrom;
+	uint32_t	mOverlapTo;
+
+	bool					FindOverlap(
+								const IndexVec&			inUsed,
+								const SHexChunk&		inChunk);
+	void					Copy(
+								const SHexChunk&		inChunk);
+							FlashImage(
+								const FlashImage&		inFlashImage);	// Not implemented
+	FlashImage&				operator = (
+								const FlashImage&		inFlashImage);	// Not implemented
+	void					GetUsedRuns(
+								HexChunks&				outRuns) const;
+};
+
+#endif /* FlashImage_h */
@@ -0,0 +1,345 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  HardwareIndex.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "HardwareIndex.h"
+#include "BuildTrace.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The first line of the saved index.  Change it when the format changes.
+static const char kIndexHeader[] = "AVRMultiSketch hardware index 1";
+
+/******************************* HardwareIndex ********************************/
+HardwareIndex::HardwareIndex(void)
+	: mScanCount(0)
+{
+}
+
+/******************************* ~HardwareIndex *******************************/
+HardwareIndex::~HardwareIndex(void)
+{
+}
+
+/******************************** SetFilePath *********************************/
+void HardwareIndex::SetFilePath(
+	const std::string&	inFilePath)
+{
+	if (mFilePath != inFilePath)
+	{
+		mFilePath.assign(inFilePath);
+		mPackages.clear();
+		if (!Load())
+		{
+			mPackages.clear();	// Missing, damaged or an older format
+		}
+	}
+}
+
+/************************************ Find ************************************/
+bool HardwareIndex::Find(
+	const std::string&	inPackageFolder,
+	const std::string&	inArchitecture,
+	SArchitecturePaths&	outPaths)
+{
+	BuildSpan	span("HardwareIndex", inPackageFolder.c_str());
+	SPackage&	package = mPackages[inPackageFolder];
+	Architectures::const_iterator	archItr = package.architectures.find(inArchitecture);
+	bool	found = archItr != package.architectures.end();
+	/*
+	*	If the architecture isn't in the index, the whole package would have
+	*	been searched.
+	*/
+	if (!IsCurrent(package, found ? archItr->second.foldersSearched : (uint32_t)package.folders.size()))
+	{
+		Scan(inPackageFolder, package);
+		mScanCount++;
+		Save();
+		archItr = package.architectures.find(inArchitecture);
+		found = archItr != package.architectures.end();
+	}
+	if (found)
+	{
+		outPaths = archItr->second;
+	}
+	return(found);
+}
+
+/********************************* IsCurrent **********************************/
+/*
+*	Returns false if any of the first inFoldersSearched folders walked when
+*	inPackage was scanned has been modified or removed since.
+*/
+bool HardwareIndex::IsCurrent(
+	const SPackage&	inPackage,
+	uint32_t		inFoldersSearched)
+{
+	bool	isCurrent = !inPackage.folders.empty() &&
+		inFoldersSearched <= inPackage.folders.size();
+	for (uint32_t index = 0; isCurrent && index < inFoldersSearched; index++)
+	{
+		const SFolderTime&	savedTime = inPackage.folders[index];
+		SFolderTime	folderTime;
+		isCurrent = GetFolderTime(savedTime.path, folderTime) &&
+			folderTime.seconds == savedTime.seconds &&
+			folderTime.nanoseconds == savedTime.nanoseconds;
+	}
+	return(isCurrent);
+}
+
+/************************************ Scan ************************************/
+void HardwareIndex::Scan(
+	const std::string&	inPackageFolder,
+	SPackage&			outPackage)
+{
+	outPackage.folders.clear();
+	outPackage.architectures.clear();
+	SFolderTime	folderTime;
+	if (GetFolderTime(inPackageFolder, folderTime))
+	{
+		std::vector<std::string>	openArchitectures;
+		outPackage.folders.push_back(folderTime);
+		ScanFolder(inPackageFolder, openArchitectures, outPackage);
+		/*
+		*	Only the folders containing both files are of use as
+		*	architectures.
+		*/
+		Architectures::iterator	itr = outPackage.architectures.begin();
+		while (itr != outPackage.architectures.end())
+		{
+			if (itr->second.boardsTxtPath.empty() ||
+				itr->second.platformTxtPath.empty())
+			{
+				itr = outPackage.architectures.erase(itr);
+			} else
+			{
+				++itr;
+			}
+		}
+	}
+}
+
+/********************************* ScanFolder *********************************/
+/*
+*	Walks inFolder the same way MainWindowController initializeFQBNConfigFor
+*	searched it.  ioOpenArchitectures is the names of the enclosing folders
+*	that were the first found with their name.  A boards.txt or platform.txt
+*	is assigned to each of these that doesn't already have one.
+*/
+void HardwareIndex::ScanFolder(
+	const std::string&			inFolder,
+	std::vector<std::string>&	ioOpenArchitectures,
+	SPackage&					ioPackage)
+{
+	DIR*	dir = opendir(inFolder.c_str());
+	if (dir)
+	{
+		struct dirent*	entry;
+		while ((entry = readdir(dir)) != NULL)
+		{
+			if (entry->d_name[0] == '.')
+			{
+				continue;	// Skip ., .., and hidden files
+			}
+			std::string	path(inFolder + "/" + entry->d_name);
+			SFolderTime	folderTime;
+			if (GetFolderTime(path, folderTime))
+			{
+				ioPackage.folders.push_back(folderTime);
+				bool	isFirst = ioPackage.architectures.find(entry->d_name) == ioPackage.architectures.end();
+				if (isFirst)
+				{
+					ioPackage.architectures[entry->d_name].foldersSearched = 0;
+					ioOpenArchitectures.push_back(entry->d_name);
+				}
+				ScanFolder(path, ioOpenArchitectures, ioPackage);
+				if (isFirst)
+				{
+					ioOpenArchitectures.pop_back();
+				}
+			} else
+			{
+				bool	isBoardsTxt = strcmp(entry->d_name, "boards.txt") == 0;
+				if (isBoardsTxt ||
+					strcmp(entry->d_name, "platform.txt") == 0)
+				{
+					for (const std::string& name : ioOpenArchitectures)
+					{
+						SArchitecturePaths&	paths = ioPackage.architectures[name];
+						std::string&	filePath = isBoardsTxt ? paths.boardsTxtPath : paths.platformTxtPath;
+						if (filePath.empty())
+						{
+							filePath.assign(path);
+							// The folders walked so far are those searched to find this file.
+							paths.foldersSearched = (uint32_t)ioPackage.folders.size();
+						}
+					}
+				}
+			}
+		}
+		closedir(dir);
+	}
+}
+
+/******************************* GetFolderTime ********************************/
+/*
+*	Returns false if inPath isn't a folder.
+*/
+bool HardwareIndex::GetFolderTime(
+	const std::string&	inPath,
+	SFolderTime&		outFolderTime)
+{
+	struct stat	pathStat;
+	bool	isFolder = stat(inPath.c_str(), &pathStat) == 0 && S_ISDIR(pathStat.st_mode);
+	if (isFolder)
+	{
+		outFolderTime.path.assign(inPath);
+#ifdef __APPLE__
+		outFolderTime.seconds = pathStat.st_mtimespec.tv_sec;
+		outFolderTime.nanoseconds = pathStat.st_mtimespec.tv_nsec;
+#else
+		outFolderTime.seconds = pathStat.st_mtim.tv_sec;
+		outFolderTime.nanoseconds = pathStat.st_mtim.tv_nsec;
+#endif
+	}
+	return(isFolder);
+}
+
+/************************************ Load ************************************/
+/*
+*	The index is saved as tab delimited lines:
+*		P	package folder
+*		F	seconds	nanoseconds	folder		(each folder walked)
+*		A	architecture	boards.txt path	platform.txt path	folders searched
+*	Each F and A line belongs to the preceding P line.
+*/
+bool HardwareIndex::Load(void)
+{
+	bool	success = false;
+	FILE*	file = fopen(mFilePath.c_str(), "r");
+	if (file)
+	{
+		char*	line = NULL;
+		size_t	lineCapacity = 0;
+		ssize_t	lineLength = getline(&line, &lineCapacity, file);
+		success = lineLength == sizeof(kIndexHeader) &&	// The header and a newline
+			strncmp(line, kIndexHeader, sizeof(kIndexHeader) - 1) == 0;
+		SPackage*	package = NULL;
+		while (success &&
+			(lineLength = getline(&line, &lineCapacity, file)) > 0)
+		{
+			BuildTrace::Count(BuildTrace::eBytesRead, lineLength);
+			if (line[lineLength - 1] == '\n')
+			{
+				line[--lineLength] = 0;
+			}
+			std::vector<std::string>	fields;
+			for (char* field = line; field; )
+			{
+				char*	tab = strchr(field, '\t');
+				fields.push_back(tab ? std::string(field, tab - field) : std::string(field));
+				field = tab ? &tab[1] : NULL;
+			}
+			if (fields[0] == "P" && fields.size() == 2)
+			{
+				package = &mPackages[fields[1]];
+			} else if (fields[0] == "F" && fields.size() == 4 && package)
+			{
+				SFolderTime	folderTime;
+				folderTime.seconds = strtoll(fields[1].c_str(), NULL, 10);
+				folderTime.nanoseconds = strtoll(fields[2].c_str(), NULL, 10);
+				folderTime.path.assign(fields[3]);
+				package->folders.push_back(folderTime);
+			} else if (fields[0] == "A" && fields.size() == 5 && package)
+			{
+				SArchitecturePaths&	paths = package->architectures[fields[1]];
+				paths.boardsTxtPath.assign(fields[2]);
+				paths.platformTxtPath.assign(fields[3]);
+				paths.foldersSearched = (uint32_t)strtoul(fields[4].c_str(), NULL, 10);
+			} else
+			{
+				success = false;
+			}
+		}
+		free(line);
+		fclose(file);
+	}
+	return(success);
+}
+
+/************************************ Save ************************************/
+/*
+*	The index is written to a temporary file that is then renamed, so a build
+*	reading it never sees a partially written index.  The temporary file is
+*	unique, so builds saving the index at the same time don't write the same
+*	file.
+*/
+bool HardwareIndex::Save(void) const
+{
+	bool	success = mFilePath.empty();
+	if (!success)
+	{
+		std::string	tempPath(mFilePath + ".XXXXXX");
+		int	fd = mkstemp(&tempPath[0]);
+		FILE*	file = fd >= 0 ? fdopen(fd, "w") : NULL;
+		if (!file && fd >= 0)
+		{
+			close(fd);
+			unlink(tempPath.c_str());
+		}
+		if (file)
+		{
+			fprintf(file, "%s\n", kIndexHeader);
+			for (const auto& package : mPackages)
+			{
+				fprintf(file, "P\t%s\n", package.first.c_str());
+				for (const SFolderTime& folderTime : package.second.folders)
+				{
+					fprintf(file, "F\t%lld\t%lld\t%s\n", (long long)folderTime.seconds,
+						(long long)folderTime.nanoseconds, folderTime.path.c_str());
+				}
+				for (const auto& architecture : package.second.architectures)
+				{
+					fprintf(file, "A\t%s\t%s\t%s\t%u\n", architecture.first.c_str(),
+						architecture.second.boardsTxtPath.c_str(),
+						architecture.second.platformTxtPath.c_str(),
+						architecture.second.foldersSearched);
+				}
+			}
+			BuildTrace::Count(BuildTrace::eBytesWritten, ftell(file));
+			success = fclose(file) == 0 &&
+				rename(tempPath.c_str(), mFilePath.c_str()) == 0;
+			if (!success)
+			{
+				unlink(tempPath.c_str());
+			}
+		}
+	}
+	return(success);
+}
@@ -0,0 +1,120 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  HardwareIndex.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef HardwareIndex_h
+#define HardwareIndex_h
+
+#include <inttypes.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// The board definition files of a package's architecture
+struct SArchitecturePaths
+{
+	std::string	boardsTxtPath;
+	std::string	platformTxtPath;
+	uint32_t	foldersSearched;	// See HardwareIndex::SPackage
+};
+
+/*
+*	HardwareIndex locates the boards.txt and platform.txt of an FQBN's
+*	architecture within a hardware package folder (e.g. .../hardware/arduino)
+*	without walking the package on every build.
+*
+*	The first time a package is used it's walked once, in the same order as
+*	NSDirectoryEnumerator.  The first folder found with a given name is taken
+*	to be the architecture of that name, and the first boards.txt and
+*	platform.txt found within it are its files.  The modification time of each
+*	folder walked is saved with the results.  A folder's modification time
+*	changes when anything in it is added, removed or renamed, so the package
+*	is only walked again when a stat of one of its folders shows it changed.
+*	Only the folders a search for the architecture would have read are
+*	checked, which is usually a small part of the package.
+*
+*	If a file path is set, the index is loaded from it and saved to it each
+*	time a package is walked, so the walk isn't repeated by later builds.
+*/
+class HardwareIndex
+{
+public:
+							HardwareIndex(void);
+	virtual					~HardwareIndex(void);
+	/*
+	*	Loads the index saved to inFilePath, if any.  The index is saved to
+	*	inFilePath whenever it changes.
+	*/
+	void					SetFilePath(
+								const std::string&		inFilePath);
+	/*
+	*	Returns false if inPackageFolder doesn't contain a folder named
+	*	inArchitecture with a boards.txt and platform.txt.
+	*/
+	bool					Find(
+								const std::string&		inPackageFolder,
+								const std::string&		inArchitecture,
+								SArchitecturePaths&		outPaths);
+	uint32_t				GetScanCount(void) const
+								{return(mScanCount);}
+protected:
+	struct SFolderTime
+	{
+		std::string	path;
+		int64_t		seconds;
+		int64_t		nanoseconds;
+	};
+	typedef std::map<std::string, SArchitecturePaths> Architectures;
+	/*
+	*	The folders are in the order walked.  A search for an architecture
+	*	reads the first foldersSearched of them.
+	*/
+	struct SPackage
+	{
+		std::vector<SFolderTime>	folders;
+		Architectures				architectures;
+	};
+	std::map<std::string, SPackage>	mPackages;
+	std::string	mFilePath;
+	uint32_t	mScanCount;
+
+	bool					Load(void);
+	bool					Save(void) const;
+	static bool				IsCurrent(
+								const SPackage&			inPackage,
+								uint32_t				inFoldersSearched);
+	static void				Scan(
+								const std::string&		inPackageFolder,
+								SPackage&				outPackage);
+	static void				ScanFolder(
+								const std::string&		inFolder,
+								std::vector<std::string>&	ioOpenArchitectures,
+								SPackage&				ioPackage);
+	static bool				GetFolderTime(
+								const std::string&		inPath,
+								SFolderTime&			outFolderTime);
+};
+
+#endif /* HardwareIndex_h */
@@ -0,0 +1,212 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  IntelHexWriter.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "IntelHexWriter.h"
+#include "BuildTrace.h"
+#include <stdio.h>
+#include <algorithm>
+
+static const uint32_t kMaxRecordLength = 16;
+
+/******************************* IntelHexWriter *******************************/
+IntelHexWriter::IntelHexWriter(void)
+	: mStartAddress(0)
+{
+}
+
+/*********************************** Clear ************************************/
+void IntelHexWriter::Clear(void)
+{
+	mChunks.clear();
+	mStartAddress = 0;
+}
+
+/********************************** AddChunk **********************************/
+/*
+*	Chunks are kept sorted by address, ties ordered the same way BFD orders
+*	them.  Empty chunks are ignored.
+*/
+void IntelHexWriter::AddChunk(
+	uint32_t		inAddress,
+	const uint8_t*	inData,
+	uint32_t		inSize)
+{
+	if (inSize)
+	{
+		SHexChunk	chunk = {inAddress, inData, inSize};
+		if (mChunks.empty() ||
+			inAddress >= mChunks.back().address)
+		{
+			mChunks.push_back(chunk);
+		} else
+		{
+			HexChunks::iterator	itr = std::lower_bound(mChunks.begin(), mChunks.end(), chunk,
+				[](const SHexChunk& inA, const SHexChunk& inB) {return(inA.address < inB.address);});
+			mChunks.insert(itr, chunk);
+		}
+	}
+}
+
+/********************************* AddChunks **********************************/
+void IntelHexWriter::AddChunks(
+	const HexChunks&	inChunks)
+{
+	HexChunks::const_iterator	itr = inChunks.begin();
+	HexChunks::const_iterator	itrEnd = inChunks.end();
+	for (; itr != itrEnd; ++itr)
+	{
+		AddChunk(itr->address, itr->data, itr->size);
+	}
+}
+
+/******************************** AppendRecord ********************************/
+void IntelHexWriter::AppendRecord(
+	std::string&	ioHex,
+	uint32_t		inCount,
+	uint32_t		inAddress,
+	uint8_t			inType,
+	const uint8_t*	inData)
+{
+	static const char kHexDigits[] = "0123456789ABCDEF";
+	char	record[1 + (4 + kMaxRecordLength + 1)*2 + 2];
+	char*	recordPtr = record;
+	uint8_t	checksum = 0;
+	uint8_t	header[] = {(uint8_t)inCount, (uint8_t)(inAddress >> 8), (uint8_t)inAddress, inType};
+	*(recordPtr++) = ':';
+	for (uint32_t i = 0; i < sizeof(header); i++)
+	{
+		checksum += header[i];
+		*(recordPtr++) = kHexDigits[header[i] >> 4];
+		*(recordPtr++) = kHexDigits[header[i] & 0xF];
+	}
+	for (uint32_t i = 0; i < inCount; i++)
+	{
+		checksum += inData[i];
+		*(recordPtr++) = kHexDigits[inData[i] >> 4];
+		*(recordPtr++) = kHexDigits[inData[i] & 0xF];
+	}
+	checksum = -checksum;
+	*(recordPtr++) = kHexDigits[checksum >> 4];
+	*(recordPtr++) = kHexDigits[checksum & 0xF];
+	*(recordPtr++) = '\r';
+	*(recordPtr++) = '\n';
+	ioHex.append(record, recordPtr - record);
+}
+
+/*********************************** Write ************************************/
+void IntelHexWriter::Write(
+	std::string&	outHex) const
+{
+	uint32_t	segBase = 0;
+	uint32_t	extBase = 0;
+	uint8_t		addr[4];
+	outHex.clear();
+	HexChunks::const_iterator	itr = mChunks.begin();
+	HexChunks::const_iterator	itrEnd = mChunks.end();
+	for (; itr != itrEnd; ++itr)
+	{
+		uint32_t		where = itr->address;
+		const uint8_t*	data = itr->data;
+		uint32_t		count = itr->size;
+		while (count > 0)
+		{
+			uint32_t	now = count > kMaxRecordLength ? kMaxRecordLength : count;
+			if (where > segBase + extBase + 0xFFFF)
+			{
+				// A new base address is needed
+				if (extBase == 0 && where <= 0xFFFFF)
+				{
+					segBase = where & 0xF0000;
+					addr[0] = (uint8_t)(segBase >> 12);
+					addr[1] = (uint8_t)(segBase >> 4);
+					AppendRecord(outHex, 2, 0, 2, addr);
+				} else
+				{
+					// Some readers combine the extended segment address and
+					// the extended linear address, so zero the segment
+					// address if one was written.
+					if (segBase != 0)
+					{
+						addr[0] = 0;
+						addr[1] = 0;
+						AppendRecord(outHex, 2, 0, 2, addr);
+						segBase = 0;
+					}
+					extBase = where & 0xFFFF0000;
+					addr[0] = (uint8_t)(extBase >> 24);
+					addr[1] = (uint8_t)(extBase >> 16);
+					AppendRecord(outHex, 2, 0, 4, addr);
+				}
+			}
+			uint32_t	recAddress = where - (extBase + segBase);
+			// Records don't cross 64K boundaries
+			if (recAddress + now > 0xFFFF)
+			{
+				now = 0x10000 - recAddress;
+			}
+			AppendRecord(outHex, now, recAddress, 0, data);
+			where += now;
+			data += now;
+			count -= now;
+		}
+	}
+	if (mStartAddress != 0)
+	{
+		if (mStartAddress <= 0xFFFFF)
+		{
+			addr[0] = (uint8_t)((mStartAddress & 0xF0000) >> 12);
+			addr[1] = 0;
+			addr[2] = (uint8_t)(mStartAddress >> 8);
+			addr[3] = (uint8_t)mStartAddress;
+			AppendRecord(outHex, 4, 0, 3, addr);
+		} else
+		{
+			addr[0] = (uint8_t)(mStartAddress >> 24);
+			addr[1] = (uint8_t)(mStartAddress >> 16);
+			addr[2] = (uint8_t)(mStartAddress >> 8);
+			addr[3] = (uint8_t)mStartAddress;
+			AppendRecord(outHex, 4, 0, 5, addr);
+		}
+	}
+	AppendRecord(outHex, 0, 0, 1, NULL);
+}
+
+/********************************* WriteFile **********************************/
+bool IntelHexWriter::WriteFile(
+	const char*	inPath) const
+{
+	bool	success = false;
+	std::string	hex;
+	Write(hex);
+	FILE*    file = fopen(inPath, "wb");
+	if (file)
+	{
+		success = fwrite(hex.c_str(), 1, hex.size(), file) == hex.size();
+		success = fclose(file) == 0 && success;
+		BuildTrace::Count(BuildTrace::eBytesWritten, hex.size());
+	}
+	return(success);
+}
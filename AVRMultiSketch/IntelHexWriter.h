@@ -0,0 +1,84 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  IntelHexWriter.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef IntelHexWriter_h
+#define IntelHexWriter_h
+
+#include <string>
+#include <vector>
+
+struct SHexChunk
+{
+	uint32_t		address;
+	const uint8_t*	data;
+	uint32_t		size;
+};
+
+typedef std::vector<SHexChunk> HexChunks;
+
+/*
+*	Writes Intel HEX records the same way the BFD ihex back end does (as used
+*	by avr-objcopy -O ihex) so that the output is byte for byte identical:
+*	chunks sorted by address, 16 data bytes per record, extended segment
+*	address records (type 02) below 1MB else extended linear address records
+*	(type 04), no record crosses a 64K boundary, a start address record when
+*	the start address isn't 0, then the end of file record.  Upper case hex,
+*	CRLF line endings.
+*
+*	The data passed to AddChunk isn't copied, it must remain valid until the
+*	hex has been written.
+*/
+class IntelHexWriter
+{
+public:
+							IntelHexWriter(void);
+	void					AddChunk(
+								uint32_t				inAddress,
+								const uint8_t*			inData,
+								uint32_t				inSize);
+	void					AddChunks(
+								const HexChunks&		inChunks);
+	void					SetStartAddress(
+								uint32_t				inStartAddress)
+								{mStartAddress = inStartAddress;}
+	void					Write(
+								std::string&			outHex) const;
+	bool					WriteFile(
+								const char*				inPath) const;
+	void					Clear(void);
+protected:
+	HexChunks	mChunks;	// Sorted by address
+	uint32_t	mStartAddress;
+
+	static void				AppendRecord(
+								std::string&			ioHex,
+								uint32_t				inCount,
+								uint32_t				inAddress,
+								uint8_t					inType,
+								const uint8_t*			inData);
+};
+
+#endif /* IntelHexWriter_h */
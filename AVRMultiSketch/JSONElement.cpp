@@ -26,6 +26,7 @@
 //
 #include "JSONElement.h"
 #include "FileInputBuffer.h"
+#include <string.h>
 
 /******************************** ~JSONObject *********************************/
 JSONObject::~JSONObject(void)
@@ -0,0 +1,361 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  KeyValueStore.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "KeyValueStore.h"
+#include <string.h>
+
+// The table is kept at most half full so that probe sequences stay short.
+static const uint32_t kMinTableSize = 64;
+
+/******************************* KeyValueStore ********************************/
+KeyValueStore::KeyValueStore(void)
+	: mCount(0)
+{
+}
+
+/*********************************** Clear ************************************/
+void KeyValueStore::Clear(void)
+{
+	mArena.clear();
+	mEntries.clear();
+	mTable.clear();
+	mCount = 0;
+}
+
+/************************************ Hash ************************************/
+// 32 bit FNV-1a
+uint32_t KeyValueStore::Hash(
+	const char*	inKey,
+	size_t		inKeyLen)
+{
+	const uint8_t*	key = (const uint8_t*)inKey;
+	const uint8_t*	keyEnd = &key[inKeyLen];
+	uint32_t	hash = 0x811C9DC5;
+	for (; key < keyEnd; key++)
+	{
+		hash = (hash ^ *key) * 0x01000193;
+	}
+	return(hash);
+}
+
+/*********************************** Append ***********************************/
+/*
+*	Appends inString and a null terminator to the arena.  Returns the offset
+*	of inString.
+*/
+uint32_t KeyValueStore::Append(
+	const char*	inString,
+	size_t		inLen)
+{
+	uint32_t	offset = (uint32_t)mArena.size();
+	mArena.insert(mArena.end(), inString, &inString[inLen]);
+	mArena.push_back(0);
+	return(offset);
+}
+
+/********************************** FindSlot **********************************/
+/*
+*	Returns the table slot of inKey, or the empty slot that ends its probe
+*	sequence if inKey isn't in the table.  The table must not be empty.
+*/
+const uint32_t* KeyValueStore::FindSlot(
+	const char*	inKey,
+	size_t		inKeyLen,
+	uint32_t	inHash) const
+{
+	uint32_t	mask = (uint32_t)mTable.size() - 1;
+	const uint32_t*	slot = &mTable[inHash & mask];
+	for (uint32_t index = inHash; *slot; slot = &mTable[++index & mask])
+	{
+		const SEntry&	entry = mEntries[*slot - 1];
+		if (entry.hash == inHash &&
+			entry.keyLen == inKeyLen &&
+			memcmp(&mArena[entry.keyOffset], inKey, inKeyLen) == 0)
+		{
+			break;
+		}
+	}
+	return(slot);
+}
+
+/********************************** FindSlot **********************************/
+uint32_t* KeyValueStore::FindSlot(
+	const char*	inKey,
+	size_t		inKeyLen,
+	uint32_t	inHash)
+{
+	return((uint32_t*)((const KeyValueStore*)this)->FindSlot(inKey, inKeyLen, inHash));
+}
+
+/*********************************** Rehash ***********************************/
+void KeyValueStore::Rehash(
+	uint32_t	inTableSize)
+{
+	mTable.assign(inTableSize, 0);
+	uint32_t	mask = inTableSize - 1;
+	for (uint32_t entryIndex = 0; entryIndex < mEntries.size(); entryIndex++)
+	{
+		if (!mEntries[entryIndex].erased)
+		{
+			uint32_t	index = mEntries[entryIndex].hash;
+			while (mTable[index & mask])
+			{
+				index++;
+			}
+			mTable[index & mask] = entryIndex + 1;
+		}
+	}
+}
+
+/*********************************** Insert ***********************************/
+/*
+*	Replaces the value of inKey if it's already in the store.
+*/
+void KeyValueStore::Insert(
+	const char*	inKey,
+	size_t		inKeyLen,
+	const char*	inValue,
+	size_t		inValueLen)
+{
+	if ((mCount + 1) * 2 > mTable.size())
+	{
+		Rehash(mTable.empty() ? kMinTableSize : (uint32_t)mTable.size() * 2);
+	}
+	uint32_t	hash = Hash(inKey, inKeyLen);
+	uint32_t*	slot = FindSlot(inKey, inKeyLen, hash);
+	if (*slot)
+	{
+		SEntry&	entry = mEntries[*slot - 1];
+		if (entry.valueLen != inValueLen ||
+			memcmp(&mArena[entry.valueOffset], inValue, inValueLen) != 0)
+		{
+			entry.valueOffset = Append(inValue, inValueLen);
+			entry.valueLen = (uint32_t)inValueLen;
+		}
+	} else
+	{
+		SEntry	entry;
+		entry.hash = hash;
+		entry.keyOffset = Append(inKey, inKeyLen);
+		entry.keyLen = (uint32_t)inKeyLen;
+		entry.valueOffset = Append(inValue, inValueLen);
+		entry.valueLen = (uint32_t)inValueLen;
+		entry.erased = false;
+		mEntries.push_back(entry);
+		*slot = (uint32_t)mEntries.size();
+		mCount++;
+	}
+}
+
+/************************************ Find ************************************/
+const char* KeyValueStore::Find(
+	const char*	inKey,
+	size_t		inKeyLen,
+	size_t*		outValueLen) const
+{
+	const char*	value = NULL;
+	if (mCount)
+	{
+		uint32_t	index;
+		if (FindEntry(inKey, inKeyLen, Hash(inKey, inKeyLen), index))
+		{
+			const SEntry&	entry = mEntries[index];
+			value = &mArena[entry.valueOffset];
+			if (outValueLen)
+			{
+				*outValueLen = entry.valueLen;
+			}
+		}
+	}
+	return(value);
+}
+
+/********************************* FindEntry **********************************/
+bool KeyValueStore::FindEntry(
+	const char*	inKey,
+	size_t		inKeyLen,
+	uint32_t	inHash,
+	uint32_t&	outIndex) const
+{
+	bool	found = false;
+	if (mCount)
+	{
+		const uint32_t*	slot = FindSlot(inKey, inKeyLen, inHash);
+		found = *slot != 0;
+		if (found)
+		{
+			outIndex = *slot - 1;
+		}
+	}
+	return(found);
+}
+
+/*********************************** Erase ************************************/
+/*
+*	The entries that follow the erased slot in its probe sequence are moved
+*	back so that no probe sequence is broken by the empty slot.
+*/
+bool KeyValueStore::Erase(
+	const char*	inKey,
+	size_t		inKeyLen)
+{
+	bool	erased = false;
+	if (mCount)
+	{
+		uint32_t*	slot = FindSlot(inKey, inKeyLen, Hash(inKey, inKeyLen));
+		erased = *slot != 0;
+		if (erased)
+		{
+			SEntry&	entry = mEntries[*slot - 1];
+			entry.erased = true;
+			mCount--;
+			uint32_t	mask = (uint32_t)mTable.size() - 1;
+			uint32_t	emptyIndex = (uint32_t)(slot - &mTable[0]);
+			mTable[emptyIndex] = 0;
+			for (uint32_t index = (emptyIndex + 1) & mask; mTable[index]; index = (index + 1) & mask)
+			{
+				uint32_t	homeIndex = mEntries[mTable[index] - 1].hash & mask;
+				// Move the entry if its home slot isn't between the empty slot and index
+				if (((index - homeIndex) & mask) >= ((index - emptyIndex) & mask))
+				{
+					mTable[emptyIndex] = mTable[index];
+					mTable[index] = 0;
+					emptyIndex = index;
+				}
+			}
+		}
+	}
+	return(erased);
+}
+
+/********************************** GetEntry **********************************/
+bool KeyValueStore::GetEntry(
+	uint32_t		inIndex,
+	const char*&	outKey,
+	size_t&			outKeyLen,
+	const char*&	outValue,
+	size_t&			outValueLen) const
+{
+	const SEntry&	entry = mEntries[inIndex];
+	if (!entry.erased)
+	{
+		outKey = &mArena[entry.keyOffset];
+		outKeyLen = entry.keyLen;
+		outValue = &mArena[entry.valueOffset];
+		outValueLen = entry.valueLen;
+	}
+	return(!entry.erased);
+}
+
+/******************************** GetImageSize ********************************/
+size_t KeyValueStore::GetImageSize(void) const
+{
+	return(sizeof(SImageHeader) + mEntries.size() * sizeof(SEntry) +
+		mTable.size() * sizeof(uint32_t) + mArena.size());
+}
+
+/********************************** GetImage **********************************/
+/*
+*	outImage must be GetImageSize() bytes.  The image is the header followed
+*	by the entries, the table, then the arena.
+*/
+void KeyValueStore::GetImage(
+	void*	outImage) const
+{
+	SImageHeader	header;
+	header.entrySize = sizeof(SEntry);
+	header.entryCount = (uint32_t)mEntries.size();
+	header.tableSize = (uint32_t)mTable.size();
+	header.arenaSize = (uint32_t)mArena.size();
+	header.count = mCount;
+	uint8_t*	image = (uint8_t*)outImage;
+	memcpy(image, &header, sizeof(header));
+	image += sizeof(header);
+	memcpy(image, mEntries.data(), mEntries.size() * sizeof(SEntry));
+	image += mEntries.size() * sizeof(SEntry);
+	memcpy(image, mTable.data(), mTable.size() * sizeof(uint32_t));
+	image += mTable.size() * sizeof(uint32_t);
+	memcpy(image, mArena.data(), mArena.size());
+}
+
+/********************************** SetImage **********************************/
+/*
+*	The image is checked enough that a damaged image can't cause a lookup to
+*	read outside of the store or probe forever.  Every occupied slot of the
+*	table must index an entry that isn't erased, and there must be exactly
+*	count of them, so with count*2 <= tableSize there's always an empty slot
+*	to end a probe.
+*/
+bool KeyValueStore::SetImage(
+	const void*	inImage,
+	size_t		inImageSize)
+{
+	SImageHeader	header;
+	bool	success = inImageSize >= sizeof(header);
+	if (success)
+	{
+		memcpy(&header, inImage, sizeof(header));
+		success = header.entrySize == sizeof(SEntry) &&
+			header.count <= header.entryCount &&
+			header.count * 2 <= header.tableSize &&
+			(header.tableSize & (header.tableSize - 1)) == 0 &&
+			inImageSize == sizeof(header) + (uint64_t)header.entryCount * sizeof(SEntry) +
+				(uint64_t)header.tableSize * sizeof(uint32_t) + header.arenaSize;
+	}
+	if (success)
+	{
+		const uint8_t*	image = &((const uint8_t*)inImage)[sizeof(header)];
+		std::vector<SEntry>		entries(header.entryCount);
+		std::vector<uint32_t>	table(header.tableSize);
+		memcpy(entries.data(), image, entries.size() * sizeof(SEntry));
+		image += entries.size() * sizeof(SEntry);
+		memcpy(table.data(), image, table.size() * sizeof(uint32_t));
+		image += table.size() * sizeof(uint32_t);
+		for (const SEntry& entry : entries)
+		{
+			success = success &&
+				(uint64_t)entry.keyOffset + entry.keyLen < header.arenaSize &&
+				(uint64_t)entry.valueOffset + entry.valueLen < header.arenaSize &&
+				entry.valueOffset != 0;
+		}
+		uint32_t	occupiedSlots = 0;
+		for (uint32_t slot : table)
+		{
+			success = success && slot <= header.entryCount &&
+				(slot == 0 || !entries[slot - 1].erased);
+			occupiedSlots += slot != 0;
+		}
+		success = success && occupiedSlots == header.count;
+		if (success)
+		{
+			mEntries.swap(entries);
+			mTable.swap(table);
+			mArena.assign((const char*)image, (const char*)&image[header.arenaSize]);
+			mCount = header.count;
+		}
+	}
+	return(success);
+}
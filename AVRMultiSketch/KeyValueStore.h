@@ -0,0 +1,159 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  KeyValueStore.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef KeyValueStore_h
+#define KeyValueStore_h
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+/*
+*	KeyValueStore maps string keys to string values without a node or string
+*	allocation per entry.
+*
+*	Each key and value is appended, null terminated, to a single character
+*	arena.  The entries index the arena and are found using an open addressing
+*	(linear probing) hash table of entry indexes.  A lookup is a hash of the
+*	key plus usually one or two probes, and the value is returned as a pointer
+*	into the arena rather than a copy.
+*
+*	Replacing or erasing a value leaves its characters in the arena until the
+*	store is cleared, which is fine for configuration files where few values
+*	are replaced.  Because the arena is only appended to, a copy has the same
+*	entry indexes and value stamps as the original.
+*/
+class KeyValueStore
+{
+public:
+							KeyValueStore(void);
+	void					Clear(void);
+	void					Insert(
+								const char*				inKey,
+								size_t					inKeyLen,
+								const char*				inValue,
+								size_t					inValueLen);
+	void					Insert(
+								const std::string&		inKey,
+								const std::string&		inValue)
+								{Insert(inKey.c_str(), inKey.size(), inValue.c_str(), inValue.size());}
+	/*
+	*	Returns the null terminated value of inKey, or NULL if inKey isn't in
+	*	the store.  The value is valid until the store is next modified.
+	*/
+	const char*				Find(
+								const char*				inKey,
+								size_t					inKeyLen,
+								size_t*					outValueLen = NULL) const;
+	/*
+	*	Returns false if inKey isn't in the store.  inHash must be
+	*	Hash(inKey, inKeyLen), which allows the caller to hash the key once.
+	*/
+	bool					FindEntry(
+								const char*				inKey,
+								size_t					inKeyLen,
+								uint32_t				inHash,
+								uint32_t&				outIndex) const;
+	static uint32_t			Hash(
+								const char*				inKey,
+								size_t					inKeyLen);
+	bool					Erase(
+								const char*				inKey,
+								size_t					inKeyLen);
+	uint32_t				GetCount(void) const
+								{return(mCount);}
+	/*
+	*	Entries are iterated by index, 0 to GetEntryCount()-1, in the order
+	*	first inserted.  Erased entries return false.
+	*/
+	uint32_t				GetEntryCount(void) const
+								{return((uint32_t)mEntries.size());}
+	bool					GetEntry(
+								uint32_t				inIndex,
+								const char*&			outKey,
+								size_t&					outKeyLen,
+								const char*&			outValue,
+								size_t&					outValueLen) const;
+	/*
+	*	The stamp of an entry changes whenever its value changes, so data
+	*	derived from a value can be kept with its stamp and checked before
+	*	it's used.  A stamp is never 0.
+	*/
+	uint32_t				GetValueStamp(
+								uint32_t				inIndex) const
+								{return(mEntries[inIndex].valueOffset);}
+	/*
+	*	The image of a store is its entries, table and arena as they're kept
+	*	in memory, so a saved store is loaded without inserting each key
+	*	again.  An image is only meant to be read by the same build of the
+	*	application that wrote it.  SetImage returns false, leaving the store
+	*	unchanged, if inImage isn't a valid image.
+	*/
+	size_t					GetImageSize(void) const;
+	void					GetImage(
+								void*					outImage) const;
+	bool					SetImage(
+								const void*				inImage,
+								size_t					inImageSize);
+protected:
+	struct SImageHeader
+	{
+		uint32_t	entrySize;	// sizeof(SEntry)
+		uint32_t	entryCount;
+		uint32_t	tableSize;
+		uint32_t	arenaSize;
+		uint32_t	count;
+	};
+	struct SEntry
+	{
+		uint32_t	hash;
+		uint32_t	keyOffset;
+		uint32_t	keyLen;
+		uint32_t	valueOffset;
+		uint32_t	valueLen;
+		uint32_t	erased;		// Not bool, so an image has no padding bytes
+	};
+	std::vector<char>		mArena;
+	std::vector<SEntry>		mEntries;
+	std::vector<uint32_t>	mTable;		// Entry index + 1, 0 is empty
+	uint32_t				mCount;
+
+	uint32_t				Append(
+								const char*				inString,
+								size_t					inLen);
+	uint32_t*				FindSlot(
+								const char*				inKey,
+								size_t					inKeyLen,
+								uint32_t				inHash);
+	const uint32_t*			FindSlot(
+								const char*				inKey,
+								size_t					inKeyLen,
+								uint32_t				inHash) const;
+	void					Rehash(
+								uint32_t				inTableSize);
+};
+
+#endif /* KeyValueStore_h */
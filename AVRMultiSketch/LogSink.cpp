@@ -0,0 +1,142 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  LogSink.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "LogSink.h"
+
+/********************************** LogSink ***********************************/
+LogSink::LogSink(
+	uint32_t	inCapacity)
+	: mPushPosition(0), mDrainPosition(0), mDroppedCount(0)
+{
+	uint32_t	capacity = 2;
+	while (capacity < inCapacity)
+	{
+		capacity <<= 1;
+	}
+	mMask = capacity - 1;
+	mSlots = new SSlot[capacity];
+	for (uint32_t i = 0; i < capacity; i++)
+	{
+		mSlots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+/********************************** ~LogSink **********************************/
+LogSink::~LogSink(void)
+{
+	delete [] mSlots;
+}
+
+/************************************ Push ************************************/
+bool LogSink::Push(
+	SLogEvent&	ioEvent)
+{
+	SSlot*	slot = NULL;
+	size_t	position = mPushPosition.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		slot = &mSlots[position & mMask];
+		size_t	sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t	diff = (intptr_t)sequence - (intptr_t)position;
+		if (diff == 0)
+		{
+			// The slot is free, claim it by advancing the push position.
+			if (mPushPosition.compare_exchange_weak(position, position + 1,
+					std::memory_order_relaxed))
+			{
+				break;
+			}
+			// position was updated by the failed exchange.
+		} else if (diff < 0)
+		{
+			// The slot still holds the event pushed a lap ago, the ring is full.
+			slot = NULL;
+			break;
+		} else
+		{
+			// Another producer claimed this position first.
+			position = mPushPosition.load(std::memory_order_relaxed);
+		}
+	}
+	bool	success = slot != NULL;
+	if (success)
+	{
+		slot->event.level = ioEvent.level;
+		slot->event.time = ioEvent.time;
+		slot->event.stage.swap(ioEvent.stage);
+		slot->event.sketch.swap(ioEvent.sketch);
+		slot->event.message.swap(ioEvent.message);
+		// Publish the event to the consumer.
+		slot->sequence.store(position + 1, std::memory_order_release);
+	} else
+	{
+		mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	return(success);
+}
+
+/************************************ Push ************************************/
+bool LogSink::Push(
+	ELogLevel			inLevel,
+	const std::string&	inStage,
+	const std::string&	inSketch,
+	const std::string&	inMessage)
+{
+	SLogEvent	event;
+	event.level = inLevel;
+	event.time = std::chrono::system_clock::now();
+	event.stage.assign(inStage);
+	event.sketch.assign(inSketch);
+	event.message.assign(inMessage);
+	return(Push(event));
+}
+
+/*********************************** Drain ************************************/
+size_t LogSink::Drain(
+	LogEvents&	ioEvents,
+	size_t		inMaxEvents)
+{
+	size_t	eventsDrained = 0;
+	for (; eventsDrained < inMaxEvents; eventsDrained++)
+	{
+		SSlot*	slot = &mSlots[mDrainPosition & mMask];
+		if (slot->sequence.load(std::memory_order_acquire) != mDrainPosition + 1)
+		{
+			break;	// Empty, or the producer that claimed it hasn't finished.
+		}
+		ioEvents.push_back(SLogEvent());
+		SLogEvent&	event = ioEvents.back();
+		event.level = slot->event.level;
+		event.time = slot->event.time;
+		event.stage.swap(slot->event.stage);
+		event.sketch.swap(slot->event.sketch);
+		event.message.swap(slot->event.message);
+		// Free the slot for the push one lap from now.
+		slot->sequence.store(mDrainPosition + mMask + 1, std::memory_order_release);
+		mDrainPosition++;
+	}
+	return(eventsDrained);
+}
@@ -0,0 +1,117 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  LogSink.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef LogSink_h
+#define LogSink_h
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+enum ELogLevel
+{
+	eLogInfo,
+	eLogWarning,
+	eLogError
+};
+
+struct SLogEvent
+{
+	ELogLevel	level;
+	std::chrono::system_clock::time_point	time;
+	std::string	stage;		// e.g. "Link", may be empty
+	std::string	sketch;		// The sketch name, may be empty
+	std::string	message;
+};
+typedef std::vector<SLogEvent> LogEvents;
+
+/*
+*	LogSink is a bounded ring buffer of log events that any number of threads
+*	push to and a single consumer drains.  A push never blocks or takes a lock,
+*	so a sketch being built on a worker thread never waits on the consumer
+*	(e.g. the user interface laying out text.)  If the ring is full the event
+*	is dropped and counted rather than waiting for room.
+*
+*	The consumer drains the events in batches: the application once per
+*	frame while a build is running, the command line tool to stderr, and a
+*	test into memory.
+*
+*	Each slot has a sequence number that says whether it's free for the push
+*	at a given position or holds the event for the drain at that position, so
+*	producers only contend on the push position (see Dmitry Vyukov's bounded
+*	MPMC queue.)
+*/
+class LogSink
+{
+public:
+							// inCapacity is rounded up to a power of 2.
+							LogSink(
+								uint32_t				inCapacity = 1024);
+	virtual					~LogSink(void);
+	/*
+	*	Returns false if the ring is full, in which case the event is dropped.
+	*	ioEvent's strings are moved into the ring.
+	*/
+	bool					Push(
+								SLogEvent&				ioEvent);
+	bool					Push(
+								ELogLevel				inLevel,
+								const std::string&		inStage,
+								const std::string&		inSketch,
+								const std::string&		inMessage);
+	/*
+	*	Moves up to inMaxEvents of the events pushed, oldest first, to the end
+	*	of ioEvents.  Returns the number moved.  Only one thread may drain.
+	*/
+	size_t					Drain(
+								LogEvents&				ioEvents,
+								size_t					inMaxEvents = SIZE_MAX);
+							// The number of events dropped since constructed
+	uint64_t				GetDroppedCount(void) const
+								{return(mDroppedCount.load(std::memory_order_relaxed));}
+	uint32_t				GetCapacity(void) const
+								{return(mMask + 1);}
+protected:
+	struct SSlot
+	{
+		std::atomic<size_t>	sequence;
+		SLogEvent			event;
+	};
+	SSlot*				mSlots;
+	uint32_t			mMask;
+	std::atomic<size_t>	mPushPosition;
+	size_t				mDrainPosition;	// Only used by the consumer
+	std::atomic<uint64_t>	mDroppedCount;
+
+							LogSink(
+								const LogSink&			inLogSink);	// Not implemented
+	LogSink&				operator = (
+								const LogSink&			inLogSink);	// Not implemented
+};
+
+#endif /* LogSink_h */
@@ -60,6 +60,9 @@
 - (LogViewController*)postWarningString:(NSString*)inString;
 - (LogViewController*)postInfoString:(NSString*)inString;
 - (LogViewController*)postString:(NSString*)inString;
+- (LogViewController*)appendErrorString:(NSString*)inString date:(NSDate*)inDate;
+- (LogViewController*)appendWarningString:(NSString*)inString date:(NSDate*)inDate;
+- (LogViewController*)appendInfoString:(NSString*)inString date:(NSDate*)inDate;
 - (LogViewController*)post;
 - (LogViewController*)postWithoutScroll;
 - (LogViewController*)flush;
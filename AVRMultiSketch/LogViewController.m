@@ -96,7 +96,7 @@
 */
 - (LogViewController*)postErrorString:(NSString*)inString
 {
-	[[[[[[[[self setColor:self.redColor] appendString:@"["] appendDate] appendString:@"] Error:"] setColor:self.blackColor] appendFormat:@"   %@", inString] appendNewLine] post];
+	[[self appendErrorString:inString date:[NSDate date]] post];
 	return(self);
 }
 
@@ -107,7 +107,7 @@
 */
 - (LogViewController*)postWarningString:(NSString*)inString
 {
-	[[[[[[[[self setColor:self.yellowColor] appendString:@"["] appendDate] appendString:@"] Warning:"] setColor:self.blackColor] appendFormat:@"   %@", inString] appendNewLine] post];
+	[[self appendWarningString:inString date:[NSDate date]] post];
 	return(self);
 }
 
@@ -118,7 +118,32 @@
 */
 - (LogViewController*)postInfoString:(NSString*)inString
 {
-	[[[[[[[[self setColor:self.greenColor] appendString:@"["] appendDate] appendString:@"]"] setColor:self.blackColor] appendFormat:@"   %@", inString] appendNewLine] post];
+	[[self appendInfoString:inString date:[NSDate date]] post];
+	return(self);
+}
+
+/**************************** appendErrorString *******************************/
+/*
+*	Appends an error string stamped with inDate without posting it, so that a
+*	batch of messages can be posted at once.
+*/
+- (LogViewController*)appendErrorString:(NSString*)inString date:(NSDate*)inDate
+{
+	[[[[[[[self setColor:self.redColor] appendString:@"["] appendDate:inDate] appendString:@"] Error:"] setColor:self.blackColor] appendFormat:@"   %@", inString] appendNewLine];
+	return(self);
+}
+
+/*************************** appendWarningString ******************************/
+- (LogViewController*)appendWarningString:(NSString*)inString date:(NSDate*)inDate
+{
+	[[[[[[[self setColor:self.yellowColor] appendString:@"["] appendDate:inDate] appendString:@"] Warning:"] setColor:self.blackColor] appendFormat:@"   %@", inString] appendNewLine];
+	return(self);
+}
+
+/***************************** appendInfoString *******************************/
+- (LogViewController*)appendInfoString:(NSString*)inString date:(NSDate*)inDate
+{
+	[[[[[[[self setColor:self.greenColor] appendString:@"["] appendDate:inDate] appendString:@"]"] setColor:self.blackColor] appendFormat:@"   %@", inString] appendNewLine];
 	return(self);
 }
 
@@ -29,14 +29,16 @@
 
 #import "MainWindowController.h"
 #import "ArduinoAppOpenDelegate.h"
-#include "AVRElfFile.h"
+#include "BoardSnapshots.h"
+#include "BuildCache.h"
+#include "BuildTrace.h"
 #include "ConfigurationFile.h"
-#include "FileInputBuffer.h"
-#include "JSONElement.h"
-
-// Defining AVR_OBJ_DUMP will run avr-objdump for all elf files.
-// Saved as xxxM.ino.elf.txt, where xxx is the sketch name.
-#define AVR_OBJ_DUMP	1
+#include "HardwareIndex.h"
+#include "LogSink.h"
+#include "RecipeRunner.h"
+#include "SketchSetBuilder.h"
+#include "WorkerPool.h"
+#include <atomic>
 
 @interface MainWindowController ()
 
@@ -63,8 +65,8 @@ extern NSString *const kStartKey;
 extern NSString *const kDeviceNameKey;
 //NSString *const kSourceBMKey = @"sourceBM";
 NSString *const kTempURLKey = @"tempURL";
-NSString *const kTempCopyURLKey = @"tempCopyURL";
-NSString *const kFQBNKey = @"FQBN";
+// When set, Verify writes BuildTrace.json to the app temp folder and logs a summary.
+NSString *const kBuildTraceKey = @"buildTrace";
 struct SMenuItemDesc
 {
 	NSInteger	mainMenuTag;
@@ -686,12 +688,6 @@ SMenuItemDesc	menuItems[] = {
 	[_multiAppLogViewController clear:sender];
 }
 
-/********************************* elfPathFor *********************************/
-+(const char*)elfPathFor:(NSDictionary*)inSketchRec forKey:(NSString*)inKey
-{
-	return([((NSURL*)[inSketchRec objectForKey:inKey]) URLByAppendingPathComponent:[inSketchRec[kNameKey] stringByAppendingPathExtension:@"elf"]].path.UTF8String);
-}
-
 /********************************* doUploadHex ********************************/
 - (BOOL)doUploadHex
 {
@@ -719,7 +715,7 @@ SMenuItemDesc	menuItems[] = {
 				@"\nRun the following in Terminal or a BBEdit worksheet:\n\n%s\n\n", value.c_str()]];
 
 #else
-			success = [self runShellForRecipe:"upload.pattern" configFile:primaryConfigFile];
+			success = [self runRecipe:"upload.pattern" configFile:primaryConfigFile];
 			if (success)
 			{
 				[self->_multiAppLogViewController postInfoString: @"Done uploading."];
@@ -733,14 +729,66 @@ SMenuItemDesc	menuItems[] = {
 	return(success);
 }
 
-typedef std::vector<uint16_t> Uint16Vec;
+// A recipe (upload, ...) still running after this many seconds is killed.
+static const uint32_t kRecipeTimeout = 300;
+
+/*
+*	Messages posted by sketches being built on worker threads.  The main thread
+*	drains them to the log in batches, see drainLog.
+*/
+static LogSink	sLogSink;
+static uint64_t	sLogDroppedReported;
+
+/*
+*	Where the boards.txt and platform.txt of each package's architectures are,
+*	saved with the build cache.  See buildSketches.
+*/
+static HardwareIndex	sHardwareIndex;
+/*
+*	The configurations read from the boards.txt and platform.txt of each
+*	FQBN, saved with the build cache.  See buildSketches.
+*/
+static BoardSnapshots	sBoardSnapshots;
 /********************************** doVerify **********************************/
+/*
+*	If the buildTrace user default is set, the time taken by each stage is
+*	recorded and written to BuildTrace.json in the app temp folder, in the
+*	Chrome trace event format, and a summary is posted to the log.
+*/
 - (BOOL)doVerify:(BoardsConfigFiles&) outConfigFiles
+{
+	BOOL	traceBuild = [[NSUserDefaults standardUserDefaults] boolForKey:kBuildTraceKey];
+	if (traceBuild)
+	{
+		BuildTrace::Start();
+	}
+	BOOL	success;
+	{
+		BuildSpan	span("Verify");
+		success = [self verifySketches:outConfigFiles];
+	}
+	if (traceBuild)
+	{
+		BuildTrace::Stop();
+		std::string	summary;
+		BuildTrace::GetSummary(summary);
+		NSURL*	traceURL = [_appTempFolderURL URLByAppendingPathComponent:@"BuildTrace.json"];
+		if (traceURL &&
+			BuildTrace::WriteChromeTrace(traceURL.path.UTF8String))
+		{
+			summary.append("\nTrace written to ");
+			summary.append(traceURL.path.UTF8String);
+		}
+		[_multiAppLogViewController postInfoString: [NSString stringWithUTF8String:summary.c_str()]];
+	}
+	return(success);
+}
+
+/******************************* verifySketches *******************************/
+- (BOOL)verifySketches:(BoardsConfigFiles&) outConfigFiles
 {
 	[_multiAppLogViewController clear:self];
 	__block BOOL	success = NO;
-	__block Uint16Vec	subSketchOffsets;
-	__block uint32_t	offset = 0;
 	// Verify that the Arduino app is accessible and is running
 	if (_arduinoURL)
 	{
@@ -809,7 +857,6 @@ typedef std::vector<uint16_t> Uint16Vec;
 	if (success)
 	{
 		__block NSMutableArray<NSMutableDictionary*>*	sketches = _multiAppTableViewController.sketches;
-		__block uint32_t	forwarderDataSize = 0;
 		if (sketches.count)
 		{
 			[sketches enumerateObjectsUsingBlock:
@@ -840,12 +887,13 @@ typedef std::vector<uint16_t> Uint16Vec;
 					// For each temporary arduino folder, attempt to match up a
 					// corresponding file.  When found, save the URL to this folder.
 					// in the sketches dictionary for this sketch.
+					NSURL*	coreCacheFolderURL = nil;
 					{
+						BuildSpan	span("EnumerateTempFolder");
 						NSDirectoryEnumerator* tempFolderEnum = [[NSFileManager defaultManager] enumeratorAtURL:_tempFolderURL
 							includingPropertiesForKeys:NULL options:NSDirectoryEnumerationSkipsHiddenFiles errorHandler:nil];
 						NSURL* folderURL;
 						[tempFolderEnum skipDescendants];
-						bool	cacheFolderCopied = false;
 						while ((folderURL = [tempFolderEnum nextObject]))
 						{
 							if ([folderURL hasDirectoryPath])
@@ -873,22 +921,15 @@ typedef std::vector<uint16_t> Uint16Vec;
 											}
 										}];
 								/*
-								*	Else if this is an arduino cache folder, copy it
+								*	Else if this is an arduino cache folder, its
+								*	core archives are staged by SketchSetBuilder,
+								*	nothing else in it is used.
 								*/
 								} else if ([[folderURL lastPathComponent] hasPrefix: @"arduino_cache_"])
 								{
-									if (!cacheFolderCopied)
+									if (!coreCacheFolderURL)
 									{
-										cacheFolderCopied = true;
-										NSURL*	tempCopyURL = [_appTempFolderURL URLByAppendingPathComponent:@"cache"];
-										NSError* error = nil;
-										[[NSFileManager defaultManager] copyItemAtURL:folderURL toURL:tempCopyURL error:&error];
-										if (error)
-										{
-											success = NO;
-											[_multiAppLogViewController postErrorString: [NSString stringWithFormat:@"Unable to copy the Arduino cache folder\n%@\n", error]];
-											break;
-										}
+										coreCacheFolderURL = folderURL;
 									} else
 									{
 										success = NO;
@@ -927,359 +968,10 @@ typedef std::vector<uint16_t> Uint16Vec;
 							"The Arduino IDE Verify action creates files in the temporary folder "
 							"required by this application.", sketchesNotLocated]];
 						success = NO;
-					} else
-					{
-
-						/*
-						*	Create the configuration file(s) based on the FQBN(s)
-						*	of each sketch. (generally one for all sketches)
-						*/
-						{
-							NSMutableDictionary* sketchRec;
-							NSUInteger	sketchCount = sketches.count;
-							for (NSUInteger sketchIndex = 0; success && sketchIndex < sketchCount; sketchIndex++)
-							{
-								sketchRec = [sketches objectAtIndex:sketchIndex];
-								success = [self copyArduinoTempFolderFor:sketchRec];
-								if (success)
-								{
-									BoardsConfigFile* configFile = [self initializeFQBNConfigFor:sketchRec configFile:outConfigFiles];
-									if (configFile)
-									{
-										[sketchRec setObject:[NSString stringWithUTF8String:configFile->GetFQBN().c_str()] forKey:kFQBNKey];
-										std::string deviceName;
-										configFile->RawValueForKey("build.mcu", deviceName);
-										[sketchRec setObject:[NSString stringWithUTF8String:deviceName.c_str()] forKey:kDeviceNameKey];
-										if (sketchIndex == 1)
-										{
-											outConfigFiles.SetPrimaryFQBN(configFile->GetFQBN());
-										}
-										continue;
-									}
-									success = NO;
-								}
-							}
-						}
-						/*
-						*	At this point all of the elf files have been located.  Now extract
-						*	all of the vectors used by the sub sketches to determine if the
-						*	forwarder sketch can handle them.
-						*
-						*	This could be done by checking the symbol table vector symbols, but
-						*	an easier and more reliable method is to scan the vector table
-						*	starting at offset 4.  Any vector that doesn't jump to
-						*	__bad_interrupt is implemented.  __bad_interrupt is
-						*	different for each sketch, so the symbol for __bad_interrupt is
-						*	extracted then a jmp __bad_interrupt instruction is created for each
-						*	sketch and used to get the implemented vector indexes.
-						*
-						*	To save on flash there's a limited number of placeholder
-						*	vector entries in the original forwarder sketch.  An error
-						*	will be generated if additional vector placeholder entries
-						*	need to be added.
-						*/
-						if (success)
-						{
-							__block IndexVec	forwarderVectors;
-							__block IndexVec	reqSketchVectors;
-							[sketches enumerateObjectsUsingBlock:
-								^void(NSMutableDictionary* inSketchRec, NSUInteger inIndex, BOOL *outStop)
-								{
-									AVRElfFile	elfFile;
-									if (elfFile.ReadFile([MainWindowController elfPathFor:inSketchRec forKey:kTempURLKey]) &&
-										elfFile.GetVectorIndexes(inIndex ? reqSketchVectors : forwarderVectors))
-									{
-										uint32_t	length = elfFile.GetFlashUsed();
-										[self->_multiAppTableViewController setData:offset length:length forIndex:inIndex];
-										subSketchOffsets.push_back((uint16_t)offset/2);
-										offset += length;
-									} else
-									{
-										[self->_multiAppLogViewController postErrorString: [NSString stringWithFormat:
-											@"Unable to open the %@.elf file and/or the elf file is damaged and/or this is not an AVR device.", inSketchRec[kNameKey]]];
-										*outStop = YES;
-										success = NO;
-									}
-									// While the elf file is open, check for required symbols...
-									if (success)
-									{
-										switch (inIndex)
-										{
-											case 0:	// Forwarder Sketch
-											{
-												const SSymbolTblEntry*	symTableEntry = NULL;
-												if (!elfFile.GetSymbolValuePtr("_ZL17currSketchAddress", &symTableEntry) ||
-													!elfFile.GetSymbolValuePtr("restart", &symTableEntry))
-												{
-													[self->_multiAppLogViewController postErrorString: [NSString stringWithFormat:
-														@"The first sketch in the list must be the Forwarder sketch, %@ is not a Forwarder.\n"
-															"One or more expected symbols not found: currSketchAddress, restart" , inSketchRec[kNameKey]]];
-													*outStop = YES;
-													success = NO;
-												} else
-												{
-													forwarderDataSize = elfFile.GetDataSize();
-												}
-												break;
-											}
-											case 1:	// Selector Sketch
-											{
-												const SSymbolTblEntry*	symTableEntry = NULL;
-												// was _ZL23forwarderCurrSketchAddr pre Catalina, Arduino 1.8.10
-												// was _ZL16subSketchAddress
-												if (!elfFile.GetSymbolValuePtr("forwarderCurrSketchAddr", &symTableEntry) ||
-													!elfFile.GetSymbolValuePtr("forwarderRestartPlaceholder", &symTableEntry) ||
-													!elfFile.GetSymbolValuePtr("subSketchAddress", &symTableEntry))
-												{
-													[self->_multiAppLogViewController postErrorString: [NSString stringWithFormat:
-														@"The second sketch in the list must be the Selector sketch, %@ is not a Selector.\n"
-															"One or more expected symbols not found: forwarderCurrSketchAddr, subSketchAddress, forwarderRestartPlaceholder" , inSketchRec[kNameKey]]];
-													*outStop = YES;
-													success = NO;
-												} else if (symTableEntry->size < (sketches.count > 2 ? ((sketches.count -2)*2) : 0))
-												{
-													[self->_multiAppLogViewController postErrorString: [NSString stringWithFormat:
-														@"Increase the capacity of the Selector sketch array subSketchAddress to %ld.", (sketches.count -2)]];
-													*outStop = YES;
-													success = NO;
-												}/* else
-												{
-													uint8_t* dataPtr = elfFile.GetSymbolValuePtr("forwarderRestartPlaceholder", &symTableEntry);
-													fprintf(stderr, "%hX\n", *(uint16_t*)&dataPtr[2]);
-												}*/
-												break;
-											}
-										}
-									}
-								}];
-							if (success)
-							{
-								/*
-								*	If the forwarder sketch doesn't currently contain all
-								*	of the ISRs used by all of the sketches THEN
-								*	tell the user to add a FORWARD_ISR macro for each
-								*	missing ISR to the forwarder sketch.
-								*/
-								if (!reqSketchVectors.Diff(forwarderVectors))
-								{
-									NSString*	forwarderVecMacros = [NSString string];
-									IndexVecIterator indVedItr(&reqSketchVectors);
-									for (size_t index = indVedItr.Current();
-											index != IndexVecIterator::end;
-													index = indVedItr.Next())
-									{
-										forwarderVecMacros = [NSString stringWithFormat:@"%@\nFORWARD_ISR(%ld)", forwarderVecMacros, index];
-									}
-									success = NO;
-									[_multiAppLogViewController postErrorString: [NSString stringWithFormat:
-										@"The following macros need to be added to the forwarder sketch: \n%@\n\n"
-										"Without these macros not all of the ISRs implemented in the "
-										"sub sketches will be forwarded.", forwarderVecMacros]];
-								}
-							}
-						}
-					}
-					/*
-					*	Generally there should only be a single common device name, but there
-					*	are cases where two devices are compatible, such as the atmega328p and
-					*	the atmega328pb.  By compiling some of the sketches for the atmega328p
-					*	when run on the atmega328pb will save some space.  (The atmega328pb's
-					*	vector table is larger.)
-					*/
-					if (success)
+					} else if (success)
 					{
-						NSURL* avrFolderURL = [_arduinoURL URLByAppendingPathComponent:@"Contents/Java/hardware/tools/avr/lib/gcc/avr"];
-						success = [self createModSpecsForDevices:sketches avrFolderURL:avrFolderURL dataOffset:forwarderDataSize];
-						/*
-						*	If success, the modified specs files exist.
-						*	Now modify and/or regenerate the elf, hex, and eep files.
-						*/
-						if (success)
-						{
-							uint32_t currSketchAddress = 0;
-							uint32_t timer0_millisAddress = 0;
-							uint32_t timer0_fractAddress = 0;
-							uint32_t timer0_overflow_countAddress = 0;
-							uint32_t restartAddress = 0;
-							NSUInteger	sketchCount = sketches.count;
-							NSMutableDictionary* sketchRec;
-							for (NSUInteger sketchIndex = 0; success && sketchIndex < sketchCount; sketchIndex++)
-							{
-								sketchRec = [sketches objectAtIndex:sketchIndex];
-								BoardsConfigFile	sketchConfigFile;
-								BoardsConfigFile*	configFile = outConfigFiles.GetConfigForFQBN(((NSString*)[sketchRec objectForKey:kFQBNKey]).UTF8String);
-								configFile = [self finalizeConfigFor:sketchRec ioConfigFile:configFile];
-								if (configFile)
-								{
-									/*
-									*	If not the Forwarder sketch...
-									*/
-									if (sketchIndex)
-									{
-										// Create a new elf file with offset .text and .data
-										success = [self offsetTextAndDataFor:sketchRec ioConfigFile:configFile];
-									}
-								} else
-								{
-									success = NO;
-								}
-								
-								if (success)
-								{
-									std::string	elfPath([MainWindowController elfPathFor:sketchRec forKey:kTempCopyURLKey]);
-									AVRElfFile	elfFile;
-									success = elfFile.ReadFile(elfPath.c_str());
-									if (success)
-									{
-										const SSymbolTblEntry*	symTableEntry = NULL;
-										uint16_t*  elfOffset;
-										/*
-										*	If this is the Forwarder sketch THEN
-										*	get the .text/flash addresses of the
-										*	currSketchAddress and reset symbols.
-										*/
-										if (sketchIndex == 0)
-										{
-											// Set the address of the Selector sketch
-											// Note that symbol validation/existance
-											// has already taken place earlier. Any testing for NULL
-											// below is just a sanity check.
-											elfOffset = (uint16_t*)elfFile.GetSymbolValuePtr("_ZL17currSketchAddress", &symTableEntry);
-											currSketchAddress = symTableEntry->value;
-											if (elfOffset)
-											{
-												// note that the currSketchAddress is fed to an ijmp instruction so
-												// it needs to be divided by 2.
-												*elfOffset = ((NSNumber*)[sketchRec objectForKey:kLengthKey]).unsignedShortValue/2;
-											} else
-											{
-												success = NO;
-											}
-											if (success)
-											{
-												symTableEntry = NULL;
-												elfFile.GetSymbolValuePtr("timer0_millis", &symTableEntry);
-												if (symTableEntry)
-												{
-													timer0_millisAddress = symTableEntry->value;
-													elfFile.GetSymbolValuePtr("timer0_fract", &symTableEntry);
-													if (symTableEntry)
-													{
-														timer0_fractAddress = symTableEntry->value;
-														elfFile.GetSymbolValuePtr("timer0_overflow_count", &symTableEntry);
-														if (symTableEntry)
-														{
-															timer0_overflow_countAddress = symTableEntry->value;
-														}
-													}
-												}
-												success = symTableEntry != NULL;
-											}
-											success = success && elfFile.GetSymbolValuePtr("restart", &symTableEntry) != NULL;
-											restartAddress = symTableEntry->value;
-											// Write the edited elf file
-											success = success && elfFile.WriteFile(elfPath.c_str());
-										} else
-										{
-											if (sketchIndex == 1)
-											{
-												elfOffset = (uint16_t*)elfFile.GetSymbolValuePtr("forwarderCurrSketchAddr", &symTableEntry);
-												if (elfOffset)
-												{
-													*elfOffset = currSketchAddress;
-												} else
-												{
-													success = NO;
-												}
-												elfOffset = (uint16_t*)elfFile.GetSymbolValuePtr("subSketchAddress", &symTableEntry);
-												if (elfOffset &&
-													subSketchOffsets.size() > 2 &&
-													symTableEntry->size >= ((subSketchOffsets.size()-2)*2))
-												{
-													Uint16Vec::const_iterator itr = subSketchOffsets.begin()+2;
-													Uint16Vec::const_iterator itrEnd = subSketchOffsets.end();
-													for (; itr != itrEnd; itr++)
-													{
-														*(elfOffset++) = *itr;
-													}
-												} else
-												{
-													[self->_multiAppLogViewController postErrorString: @"There are no sub sketches."];
-													success = NO;
-												}
-												elfOffset = (uint16_t*)elfFile.GetSymbolValuePtr("forwarderRestartPlaceholder", &symTableEntry);
-												if (elfOffset)
-												{
-													*(uint32_t*)elfOffset = AVRElfFile::JmpInstructionFor(restartAddress);
-												} else
-												{
-													success = NO;
-												}
-											}
-											if (success)
-											{
-												// No error checking.  It may not be used.
-												elfFile.ReplaceAddress("timer0_millis", timer0_millisAddress);
-												elfFile.ReplaceAddress("timer0_fract", timer0_fractAddress);
-												elfFile.ReplaceAddress("timer0_overflow_count", timer0_overflow_countAddress);
-											}
-											// Write the edited elf file
-											success = success && elfFile.WriteFile(elfPath.c_str());
-										}
-									}
-									if (!success)
-									{
-										[self->_multiAppLogViewController postErrorString: [NSString stringWithFormat:
-												@"Elf file not created: %s.", elfPath.c_str()]];
-									}
-								}
-	#ifdef AVR_OBJ_DUMP
-								if (success)
-								{
-									success = [self runShellForRecipe:"recipe.elfdump.pattern" configFile:configFile];
-								}
-	#endif
-								if (success)
-								{
-									success = [self runShellForRecipe:"recipe.objcopy.eep.pattern" configFile:configFile] &&
-											[self runShellForRecipe:"recipe.objcopy.hex.pattern" configFile:configFile];
-									if (success)
-									{
-										[self->_multiAppLogViewController postInfoString: [NSString stringWithFormat:
-											@"hex and eep files created for: %@.", [sketchRec objectForKey:kNameKey]]];
-									} else
-									{
-											[self->_multiAppLogViewController postErrorString: [NSString stringWithFormat:
-												@"hex and eep files not created for: %@.", [sketchRec objectForKey:kNameKey]]];
-										break;
-									}
-								}
-							}
-							if (success)
-							{
-								std::string	flashMaxSize;
-								outConfigFiles.GetPrimaryConfig()->RawValueForKey("upload.maximum_size", flashMaxSize);
-								summaryTextField.stringValue = [NSString stringWithFormat:@"Flash Used: %d of %s", offset, flashMaxSize.c_str()];
-								success = atoi(flashMaxSize.c_str()) >= offset;
-								if (success)
-								{
-									// At this point the hex and epp files have been created.
-									// Concatenate the hex and epp files.
-									success = [self concatenateHexFiles:sketches];
-									if (success)
-									{
-										[_multiAppLogViewController postInfoString: @"Combined hex and eep created."];
-									} else
-									{
-										[_multiAppLogViewController postErrorString: @"Combined hex and eep files not created."];
-									}
-								} else
-								{
-									[_multiAppLogViewController postErrorString: [NSString stringWithFormat:
-										@"Flash size exceeded, should be less than: %s.", flashMaxSize.c_str()]];
-								}
-							}
-						}
+						success = [self buildSketches:sketches coreCacheFolderURL:coreCacheFolderURL
+							configFiles:outConfigFiles];
 					}
 #if SANDBOX_ENABLED
 					[_packagesFolderURL stopAccessingSecurityScopedResource];
@@ -1298,544 +990,184 @@ typedef std::vector<uint16_t> Uint16Vec;
 	return(success);
 }
 
-/************************** createModSpecsForDevices **************************/
+/******************************* buildSketches ********************************/
 /*
-*	Verify the location of the specs folder.  For each unique device a
-*	modified version of the specs file needs to be created so that the
-*	SRAM/data starting offset can be shifted by the size of the SRAM used
-*	by the Forwarder sketch.  A copy of the original is made with a modified
-*	-Tdata specs offset by inDataOffset bytes.
+*	Builds the sketches located by verifySketches using SketchSetBuilder, the
+*	same as the command line tool, so both produce the same files and share
+*	the build cache.  The set is built on a worker thread so that the log is
+*	displayed as it's built.  The combined hex and eep files are written to
+*	the app temp folder, and each sketch's place in flash is shown in the
+*	sketch table.
 */
-- (BOOL)createModSpecsForDevices:(NSMutableArray<NSMutableDictionary*>*)inSketches
-			avrFolderURL:(NSURL*)inAVRFolderURL dataOffset:(uint32_t)inDataOffset
+- (BOOL)buildSketches:(NSMutableArray<NSMutableDictionary*>*)inSketches
+	coreCacheFolderURL:(NSURL*)inCoreCacheFolderURL configFiles:(BoardsConfigFiles&)ioConfigFiles
 {
-	BOOL success = YES;
-	NSMutableArray<NSString*>* deviceNames = [NSMutableArray arrayWithCapacity:2];
-	NSMutableArray<NSString*>* modSpecsNames = [NSMutableArray arrayWithCapacity:2];
-	NSURL* modSpecsFileURL = nil;
-	// Only expecting one folder in avr but its name changes based on the gcc version...
-	NSArray* avrContents = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:inAVRFolderURL includingPropertiesForKeys:nil options:NSDirectoryEnumerationSkipsSubdirectoryDescendants error:nil];
-	NSURL* specsFolderURL = avrContents.count >= 1 ? [avrContents objectAtIndex:0] : nil;
-	if (specsFolderURL)
+	SketchDescs	sketchDescs;
+	for (NSDictionary* sketchRec in inSketches)
 	{
-		/*
-		*	/Contents/Java/hardware/tools/avr/lib/gcc/avr/5.4.0/device-specs/
-		*	First locate the gcc/avr folder, then get past the version numbered folder
-		*	and then check for the existance of the device-specs folder.
-		*/
-		specsFolderURL = [specsFolderURL URLByAppendingPathComponent:@"device-specs"];
-		if ([[NSFileManager defaultManager] fileExistsAtPath:specsFolderURL.path])
+		SSketchDesc	sketchDesc;
+		sketchDesc.name = ((NSString*)sketchRec[kNameKey]).UTF8String;
+		sketchDesc.buildFolder = ((NSURL*)sketchRec[kTempURLKey]).path.UTF8String;
+		sketchDescs.push_back(sketchDesc);
+	}
+	BuildCache	buildCache;
+	NSURL*	buildCacheFolderURL = [self buildCacheFolderURL];
+	if (buildCacheFolderURL)
+	{
+		buildCache.SetFolder(buildCacheFolderURL.path.UTF8String);
+		sHardwareIndex.SetFilePath([buildCacheFolderURL URLByAppendingPathComponent:@"HardwareIndex.txt"].path.UTF8String);
+		sBoardSnapshots.SetFolder(buildCacheFolderURL.path.UTF8String);
+	}
+	std::string	coreCacheFolder(inCoreCacheFolderURL ? inCoreCacheFolderURL.path.UTF8String : "");
+	std::string	workFolder(_appTempFolderURL.path.UTF8String);
+	std::string	hexPath([_appTempFolderURL URLByAppendingPathComponent:@"combined.hex"].path.UTF8String);
+	std::string	eepPath([_appTempFolderURL URLByAppendingPathComponent:@"combined.eep"].path.UTF8String);
+	WorkerPool	workerPool;
+	SketchSetBuilder	builder(ioConfigFiles, workerPool, buildCache, sHardwareIndex, sBoardSnapshots, sLogSink);
+	std::atomic<bool>	built(false);
+	{
+		WorkerPool	buildPool(1);
+		buildPool.Add([&]()
 		{
-			// For each of the device specs, create a copy containing
-			// the modified -Tdata incremented by 2
-
-			NSMutableDictionary* sketchRec;
-			NSUInteger	sketchCount = inSketches.count;
-			for (NSUInteger sketchIndex = 0; success && sketchIndex < sketchCount; sketchIndex++)
-			{
-				sketchRec = [inSketches objectAtIndex:sketchIndex];
-				NSString*	deviceName = [sketchRec objectForKey:kDeviceNameKey];
-				if (![deviceNames containsObject:deviceName])
-				{
-					[deviceNames addObject:deviceName];
-
-					// Open the specs file and read it's contents into memory...
-					NSURL* specsFileURL = [specsFolderURL URLByAppendingPathComponent:[NSString stringWithFormat:@"specs-%@", deviceName]];
-					modSpecsFileURL = [specsFolderURL URLByAppendingPathComponent:[NSString stringWithFormat:@"specs-%@mod", deviceName]];
-				
-					NSString* specsText = [NSString stringWithContentsOfURL:specsFileURL encoding:NSUTF8StringEncoding error:nil];
-					if (specsText)
-					{
-						// Locate the line containing the -Tdata option.
-						NSRange tDataRange = [specsText rangeOfString:@"-Tdata"];
-						if (tDataRange.location != NSNotFound)
-						{
-							// Extract the -Tdata option value
-							// Assumption: the value starts with the 0x prefix and is a hex number.
-							NSRange tDataLineRange = [specsText lineRangeForRange:tDataRange];
-							NSRange tDataValueRange = [specsText rangeOfString:@"0x" options:NSLiteralSearch range:tDataLineRange];
-							const char*	dataValuePtr = &specsText.UTF8String[tDataValueRange.location + tDataValueRange.length];
-							uint32_t	value = 0;
-							sscanf(dataValuePtr, "%X", &value);
-						
-							value += inDataOffset;	// Add the amount of SRAM used by the Forwarder
-							char valueStr[10];
-							int bytesCreated = sprintf(valueStr, "%X", value);
-							// Now verify that there is a "mod" specs file and it contains the correct -Tdata value
-							NSString* modSpecsText = [NSString stringWithContentsOfURL:modSpecsFileURL encoding:NSUTF8StringEncoding error:nil];
-							if (modSpecsText)
-							{
-								uint32_t	modValue = 0;
-								NSRange modTDataRange = [modSpecsText rangeOfString:@"-Tdata"];
-								if (modTDataRange.location != NSNotFound)
-								{
-									// Extract the modified -Tdata option value
-									NSRange modTDataLineRange = [modSpecsText lineRangeForRange:modTDataRange];
-									NSRange modTDataValueRange = [modSpecsText rangeOfString:@"0x" options:NSLiteralSearch range:modTDataLineRange];
-									const char*	modTDataValuePtr = &modSpecsText.UTF8String[modTDataValueRange.location + modTDataValueRange.length];
-									sscanf(modTDataValuePtr, "%X", &modValue);
-								}
-								// If the modified specs file is out of sync THEN
-								// flag it to be created.
-								if (modValue != value)
-								{
-									modSpecsText = nil;
-								}
-							}
-							// If a modified specs file needs to be created...
-							if (!modSpecsText)
-							{
-								modSpecsText = [specsText stringByReplacingCharactersInRange:
-									NSMakeRange(tDataValueRange.location + tDataValueRange.length, bytesCreated)
-										withString:[NSString stringWithUTF8String:valueStr]];
-#if SANDBOX_ENABLED
-								NSURL* tempModSpecsFileURL = [_appTempFolderURL URLByAppendingPathComponent:[NSString stringWithFormat:@"specs-%@mod", deviceName]];
-#else
-								NSURL* tempModSpecsFileURL = modSpecsFileURL;
-#endif
-								NSError*	error;
-								[modSpecsText writeToURL:tempModSpecsFileURL atomically:NO encoding:NSUTF8StringEncoding error:&error];
-								if (!error)
-								{
-									[modSpecsNames addObject:[tempModSpecsFileURL.path lastPathComponent]];
-								} else
-								{
-									NSLog(@"%@", error);
-								}
-#if SANDBOX_ENABLED
-								success = NO;
-#else
-								success = error == nil;
-#endif
-							}
-						}
-					}
-				}
-			}
-			
-			if (modSpecsNames.count)
-			{
-				__block NSString*	modSpecsNamesStr = [NSString string];
-				[modSpecsNames enumerateObjectsUsingBlock:^(NSString * _Nonnull inSpecsName, NSUInteger inINdex, BOOL * outStop)
-				{
-					modSpecsNamesStr = [NSString stringWithFormat:@"%@%@\n", modSpecsNamesStr, inSpecsName];
-				}];
-
-#if SANDBOX_ENABLED
-				[_multiAppLogViewController postErrorString: [NSString stringWithFormat:
-					@"The following specs file(s) need to be copied from the temporary folder "
-					"to the Arduino specs folder because they either don't exist or need to "
-					"be updated. Due to sandbox issues, this application "
-					"can't create files within an application bundle.  Please move "
-					"the following file(s) to the Arduino specs folder:\n\n%@\n\n"
-					"If the from/to folders did not open automatically, they are:\n\n"
-					"From: %@\n\n To: %@\n", modSpecsNamesStr, _appTempFolderURL.path,
-					specsFolderURL.path]];
-				[[NSWorkspace sharedWorkspace] openURL:specsFolderURL];
-				[[NSWorkspace sharedWorkspace] openURL:_tempFolderURL];
-#else
-				[_multiAppLogViewController postWarningString: [NSString stringWithFormat:
-					@"The following specs file(s) have been created in the "
-					"Arduino specs folder:\n\n%@\n"
-					"In folder: %@.\n", modSpecsNamesStr, specsFolderURL.path]];
-				// Both of the below work.  The first only opens the folder,
-				// the second opens the folder and selects the last added mod file.
-				//[[NSWorkspace sharedWorkspace] openURL: specsFolderURL];
-				//[[NSWorkspace sharedWorkspace] selectFile:modSpecsFileURL.path inFileViewerRootedAtPath:@""];
-#endif
-			}
+			built = builder.Build(sketchDescs, std::string(), coreCacheFolder, workFolder, hexPath, eepPath);
+			buildCache.Prune();
+		});
+		[self waitForWorkerPool:buildPool];
+	}
+	for (uint32_t sketchIndex = 0; sketchIndex < builder.GetNumSketches(); sketchIndex++)
+	{
+		uint32_t	start, length;
+		std::string	fqbn, deviceName;
+		builder.GetSketchInfo(sketchIndex, start, length, fqbn, deviceName);
+		if (!deviceName.empty())
+		{
+			[[inSketches objectAtIndex:sketchIndex] setObject:[NSString stringWithUTF8String:deviceName.c_str()] forKey:kDeviceNameKey];
 		}
+		[_multiAppTableViewController setData:start length:length forIndex:sketchIndex];
 	}
-	return(success);
+	BoardsConfigFile*	primaryConfigFile = ioConfigFiles.GetPrimaryConfig();
+	if (primaryConfigFile)
+	{
+		std::string	flashMaxSize;
+		primaryConfigFile->RawValueForKey("upload.maximum_size", flashMaxSize);
+		summaryTextField.stringValue = [NSString stringWithFormat:@"Flash Used: %d of %s", builder.GetFlashUsed(), flashMaxSize.c_str()];
+	}
+	return(built);
 }
 
-/**************************** concatenateHexFiles *****************************/
+/**************************** buildCacheFolderURL *****************************/
 /*
-*	Contatenates both the .hex and .eep files into a single .hex and .epp file
-*	stored in the application's temporary folder as combined.hex and combined.eep
-*	NOTE: For epp files, no checks for duplicate memory addresses are made.
-*	For hex files, there will be no overlap because the .text section has been
-*	shifted.
+*	The build cache is kept in the user's caches folder rather than this app's
+*	temporary folder because the temporary folder is cleared by every verify.
+*	Returns nil if the folder can't be created, in which case the cache isn't
+*	used.
 */
--(BOOL)concatenateHexFiles:(NSMutableArray<NSMutableDictionary*>*) inSketches
+- (NSURL*)buildCacheFolderURL
 {
-	BOOL	success = YES;
-	NSUInteger	sketchCount = inSketches.count;
-	NSMutableDictionary*	sketchRec;
-	for (NSUInteger i = 0; success && i < 2; i++)
+	NSURL*	buildCacheFolderURL = [[[[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory
+		inDomains:NSUserDomainMask] firstObject]
+			URLByAppendingPathComponent:[NSBundle.mainBundle.executablePath lastPathComponent]]
+				URLByAppendingPathComponent:@"BuildCache"];
+	if (buildCacheFolderURL &&
+		![[NSFileManager defaultManager] fileExistsAtPath:buildCacheFolderURL.path])
 	{
-		NSString*	extension = i == 0 ? @"hex":@"eep";
-		fpos_t endOfFileLen = 0;	// To determine the line endings used.
-		std::string	combinedBuffer;
-		for (NSUInteger sketchIndex = 0; success && sketchIndex < sketchCount; sketchIndex++)
-		{
-			sketchRec = [inSketches objectAtIndex:sketchIndex];
-			std::string srcPath([((NSURL*)[sketchRec objectForKey:kTempCopyURLKey]) URLByAppendingPathComponent:[sketchRec[kNameKey] stringByAppendingPathExtension:extension]].path.UTF8String);
-			FILE*    srcFile = fopen(srcPath.c_str(), "rb");
-			if (srcFile)
-			{
-				fseek(srcFile, 0, SEEK_END);
-				fpos_t fileSize = 0;
-				fgetpos(srcFile, &fileSize);
-				rewind(srcFile);
-				char* content = new char[fileSize];
-				success = fread(content, 1, fileSize, srcFile) == fileSize;
-				fclose(srcFile);
-				if (success)
-				{
-					// For each hex file there's an end-of-file record and
-					// possibly a start-segment-address record.
-					// Inspect the last two records in the file and discard
-					// them if found.
-					char*	contentPtr = &content[fileSize];
-					for (contentPtr--; contentPtr >= content; contentPtr--)
-					{
-						if (*contentPtr != ':')
-						{
-							continue;
-						} else if (contentPtr[8] == '1')
-						{
-							endOfFileLen = fileSize;
-							fileSize = contentPtr-content;
-							endOfFileLen -= fileSize;
-							continue;
-						} else if (contentPtr[8] == '3')
-						{
-							fileSize = contentPtr-content;
-						}
-						break;
-					}
-					combinedBuffer.append(content, fileSize);
-				}
-				delete [] content;
-			}
-		}
-		if (success)
+		NSError*	error = nil;
+		if (![[NSFileManager defaultManager] createDirectoryAtURL:buildCacheFolderURL withIntermediateDirectories:YES attributes:nil error:&error])
 		{
-			combinedBuffer.append(endOfFileLen == 13 ? ":00000001FF\r\n" : ":00000001FF\n");
-			NSURL*	dstFileURL = [_appTempFolderURL URLByAppendingPathComponent:[NSString stringWithFormat:@"combined.%@", extension]];
-			FILE*    dstFile = fopen(dstFileURL.path.UTF8String, "wb");
-			if (dstFile)
-			{
-				success = fwrite(combinedBuffer.c_str(), 1, combinedBuffer.size(), dstFile) == combinedBuffer.size();
-				fclose(dstFile);
-			}
+			[_multiAppLogViewController postErrorString: [NSString stringWithFormat:
+				@"Unable to create the build cache folder: %@.", error]];
+			buildCacheFolderURL = nil;
 		}
 	}
-	return(success);
+	return(buildCacheFolderURL);
 }
 
-/************************** initializeFQBNConfigFor ***************************/
+/***************************** waitForWorkerPool ******************************/
 /*
-*	Using the fully qualified board name (FQBN), attempt to locate and initialize the
-*	corresponding key values specific to this FQBN in the located boards.txt.
-*	This creates a common/general configuration for the specific FQBN associated
-*	with inSketchRec.  On subsequent calls, if a configuration for the FQBN has
-*	already been created, the routine returns immediately.
-*	When the configuration needs to be used for the specific sketch,
-*	finalizeConfigFor is called.
+*	Waits for the tasks added to inWorkerPool to complete.  The run loop is run
+*	while waiting so that anything the tasks post to the log is displayed.
 */
-- (BoardsConfigFile*)initializeFQBNConfigFor:(NSDictionary*)inSketchRec configFile:(BoardsConfigFiles&)ioConfigFiles
+- (void)waitForWorkerPool:(WorkerPool&)inWorkerPool
 {
-	BoardsConfigFile*	configFile = NULL;
-	NSURL*	tempURL = (NSURL*)[inSketchRec objectForKey:kTempCopyURLKey];
-	NSString*	sketchTempPath = tempURL.path;
-	NSString*	sketchName = [inSketchRec objectForKey:kNameKey];
-	FileInputBuffer		jsonFileInput([sketchTempPath stringByAppendingPathComponent:@"build.options.json"].UTF8String);
-	JSONObject*			json = (JSONObject*)IJSONElement::Create(jsonFileInput);
-	if (json &&
-		json->GetType() == IJSONElement::eObject)
+	while (!inWorkerPool.WaitFor(0))
 	{
-		JSONString* customBuildProperties = (JSONString*)json->GetElement("customBuildProperties", IJSONElement::eString);
-		JSONString* fqbn = (JSONString*)json->GetElement("fqbn", IJSONElement::eString);
-		if (fqbn)
-		{
-			configFile = ioConfigFiles.GetConfigForFQBN(fqbn->GetString());
-			if (!configFile)
-			{
-				configFile = new BoardsConfigFile(fqbn->GetString());
-				ioConfigFiles.AdoptBoardsConfigFile(configFile);	// ioConfigFiles adopts/takes ownership of configFile
-				//inConfigFile.SetFQBNFromString();
-				/*
-				*	Look through the hardware folders for the Boards.txt and Platform.txt for this FQBN.
-				*/
-				NSURL*	boardsTxtURL = nil;
-				NSURL*	platformTxtURL = nil;
-				NSString*	architecture = [NSString stringWithUTF8String:configFile->GetArchitecture().c_str()];
-				JSONString* hardwareFolders = (JSONString*)json->GetElement("hardwareFolders", IJSONElement::eString);
-				if (hardwareFolders)
-				{
-					StringInputBuffer	inputBuffer(hardwareFolders->GetString());
-					std::string		hardwarePath;
-					bool	morePaths = false;
-					do
-					{
-						morePaths = inputBuffer.ReadTillChar(',', false, hardwarePath);
-						inputBuffer++;
-						hardwarePath += '/';
-						hardwarePath.append(configFile->GetPackage());
-						NSString*	packagePath = [NSString stringWithUTF8String:hardwarePath.c_str()];
-						if ([[NSFileManager defaultManager] fileExistsAtPath:packagePath])
-						{
-							NSURL*	packageURL = [NSURL fileURLWithPath:packagePath isDirectory:YES];
-							NSDirectoryEnumerator* directoryEnumerator =
-								[[NSFileManager defaultManager] enumeratorAtURL:packageURL
-									includingPropertiesForKeys:@[NSURLNameKey, NSURLIsDirectoryKey]
-										options:NSDirectoryEnumerationSkipsHiddenFiles
-											errorHandler:nil];
-							NSURL*	architectureURL = nil;
-							for (NSURL* fileURL in directoryEnumerator)
-							{
-								NSNumber *isDirectory = nil;
-								[fileURL getResourceValue:&isDirectory forKey:NSURLIsDirectoryKey error:nil];
-
-								if ([isDirectory boolValue])
-								{
-									NSString* name = nil;
-									[fileURL getResourceValue:&name forKey:NSURLNameKey error:nil];
-
-									if ([name isEqualToString:architecture])
-									{
-										architectureURL = fileURL;
-										break;
-									}
-								}
-							}
-							if (architectureURL)
-							{
-								directoryEnumerator =
-									[[NSFileManager defaultManager] enumeratorAtURL:architectureURL
-										includingPropertiesForKeys:@[NSURLNameKey]
-											options:NSDirectoryEnumerationSkipsHiddenFiles
-												errorHandler:nil];
-								for (NSURL* fileURL in directoryEnumerator)
-								{
-									NSString* name = nil;
-									[fileURL getResourceValue:&name forKey:NSURLNameKey error:nil];
-									if ([name isEqualToString:@"boards.txt"])
-									{
-										boardsTxtURL = fileURL;
-										if (platformTxtURL)break;
-									} else if ([name isEqualToString:@"platform.txt"])
-									{
-										platformTxtURL = fileURL;
-										NSString* runtimePlatformDir = [fileURL.path stringByDeletingLastPathComponent];
-										configFile->InsertKeyValue("runtime.platform.path", runtimePlatformDir.UTF8String);
-										if (boardsTxtURL)break;
-									}
-								}
-							}
-							break;
-						}
-						hardwarePath.clear();
-					} while(morePaths);
-				}
-				if (boardsTxtURL && platformTxtURL)
-				{
-					if (configFile->ReadFile(platformTxtURL.path.UTF8String, false) &&
-							configFile->ReadFile(boardsTxtURL.path.UTF8String, true))
-					{
-						if (customBuildProperties)
-						{
-							configFile->ReadDelimitedKeyValuesFromString(customBuildProperties->GetString());
-						}
-						/*
-						*	If the customBuildProperties didn't exist (very rare)
-						*	or customBuildProperties doesn't contain the expected
-						*	tools/avr keys THEN
-						*	attempt to add them using the toolsFolders object.
-						*/
-						std::string value;
-						if (!configFile->RawValueForKey("runtime.tools.avr-gcc.path", value))
-						{
-							JSONString* toolsFolders = (JSONString*)json->GetElement("toolsFolders", IJSONElement::eString);
-							if (toolsFolders)
-							{
-								StringInputBuffer	inputBuffer(toolsFolders->GetString());
-								for (uint8_t thisChar = inputBuffer.CurrChar(); thisChar; thisChar = inputBuffer.CurrChar())
-								{
-									inputBuffer.ReadTillChar(',', false, value);
-									if (value.compare(value.length()-3, 3, "avr"))
-									{
-										value.clear();
-										inputBuffer.NextChar();	// Skip the Delimiter
-										continue;
-									}
-									configFile->InsertKeyValue("runtime.tools.avr-gcc.path", value);
-									configFile->InsertKeyValue("runtime.tools.avrdude.path", value);
-									break;
-								}
-							}
-						}
-						// Uncomment to dump the tree
-						/*{
-							std::string dumpString;
-							configFile->GetRootObject()->Write(0, dumpString);
-							fprintf(stderr, "\n\n%s\n", dumpString.c_str());
-						}*/
-					} else
-					{
-						configFile = NULL;
-						[_multiAppLogViewController postErrorString: [NSString stringWithFormat:@"Unable to load boards.txt and/or platform.txt for %@", sketchName]];
-					}
-				} else
-				{
-					[_multiAppLogViewController postErrorString: [NSString stringWithFormat:@"Unable to locate boards.txt and/or platform.txt for %@", sketchName]];
-				}
-	#ifdef AVR_OBJ_DUMP
-				if (configFile)
-				{
-					// For debugging
-					configFile->InsertKeyValue("recipe.elfdump.pattern",
-						"\"{compiler.path}avr-objdump\" -h -S -d -t -j .data -j .text -j .bss "
-						"\"{build.path}/{build.project_name}.elf\" > "
-						"\"{build.path}/{build.project_name}M.elf.txt\"");
-				}
-	#endif
-			}
-		}
+		[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:1.0/60]];
+		[self drainLog];
 	}
-	return(configFile);
+	[self drainLog];
 }
 
-/***************************** finalizeConfigFor ******************************/
+/********************************** drainLog **********************************/
 /*
-*	This is called after initializeFQBNConfigFor, when the configuration needs
-*	to be used for the specific sketch.
+*	Appends the messages queued by the worker threads to the log and posts them
+*	as a single update.  Called at frame rate while waiting for the worker pool.
 */
-- (BoardsConfigFile*)finalizeConfigFor:(NSDictionary*)inSketchRec ioConfigFile:(BoardsConfigFile*)ioConfigFile
+- (void)drainLog
 {
-	NSString*	inoName = [inSketchRec objectForKey:kNameKey];
-	if (ioConfigFile)
+	LogEvents	events;
+	if (sLogSink.Drain(events))
 	{
-		NSURL*	tempURL = (NSURL*)[inSketchRec objectForKey:kTempCopyURLKey];
-		NSString*	sketchTempPath = tempURL.path;
-		// Keys normally added by Arduino
+		for (const SLogEvent& event : events)
 		{
-			ioConfigFile->InsertKeyValue("build.path", sketchTempPath.UTF8String);
-			ioConfigFile->InsertKeyValue("build.project_name", inoName.UTF8String);
-			// object files referenced by the root object_files key
+			NSString*	message = [NSString stringWithUTF8String:event.message.c_str()];
+			NSDate*	date = [NSDate dateWithTimeIntervalSince1970:
+				std::chrono::duration<double>(event.time.time_since_epoch()).count()];
+			switch (event.level)
 			{
-				NSString*	cppObjPath = [[[sketchTempPath stringByAppendingPathComponent:@"sketch"] stringByAppendingPathComponent:inoName] stringByAppendingPathExtension:@"cpp.o"];
-				/*
-				*	Iterate the library folder and collect any .o file paths.
-				*/
-				NSDirectoryEnumerator* directoryEnumerator =
-					[[NSFileManager defaultManager] enumeratorAtURL:[tempURL URLByAppendingPathComponent:@"libraries"]
-						includingPropertiesForKeys:nil
-							options:NSDirectoryEnumerationSkipsHiddenFiles
-								errorHandler:nil];
-				for (NSURL* fileURL in directoryEnumerator)
-				{
-					if ([fileURL.path.pathExtension isEqualToString:@"o"])
-					{
-						cppObjPath = [NSString stringWithFormat:@"%@ %@", cppObjPath, fileURL.path];
-					}
-				}
-				ioConfigFile->InsertKeyValue("object_files", cppObjPath.UTF8String);
-			}
-			/*
-			*	See if there's a cached core.a file with a mangled FQBN prefix.
-			*	If there is then use it. If not, look for the core.a in the core
-			*	folder of the sketch temp folder.
-			*/
-			{
-				NSString* cachedCoreNamePrefix = [NSString stringWithUTF8String:ioConfigFile->GetCoreFQBNPrefix().c_str()];
-				NSArray<NSURL*>* contentsOfDirectory = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:
-					[_appTempFolderURL URLByAppendingPathComponent:@"cache/core"] includingPropertiesForKeys:nil
-					options:NSDirectoryEnumerationSkipsHiddenFiles error:nil];
-				bool success = false;
-				for (NSUInteger fCount = contentsOfDirectory.count; fCount; )
-				{
-					fCount--;
-					if ([[contentsOfDirectory objectAtIndex:fCount].path.lastPathComponent hasPrefix:cachedCoreNamePrefix])
-					{
-						ioConfigFile->InsertKeyValue("archive_file", [@"/../cache/core/" stringByAppendingPathComponent:[contentsOfDirectory objectAtIndex:fCount].path.lastPathComponent].UTF8String);
-						success = true;
-						break;
-					}
-				}
-				if (!success)
-				{
-					success = [[NSFileManager defaultManager] fileExistsAtPath:[sketchTempPath stringByAppendingPathComponent:@"core/core.a"]];
-					if (success)
-					{
-						ioConfigFile->InsertKeyValue("archive_file", "core/core.a");
-					/*
-					*	FQBN's that are really long only contain the hash value.
-					*	I wasn't able to figure out what they're using, probably
-					*	some one of the SHA family.  Even knowing that you'd still
-					*	need to know what is being fed to to the function.
-					*
-					*	If there's only one core in the folder THEN
-					*	assume it's the one.
-					*/
-					} else if (contentsOfDirectory.count == 1)
-					{
-						success = YES;
-						ioConfigFile->InsertKeyValue("archive_file", [@"/../cache/core/" stringByAppendingPathComponent:[contentsOfDirectory objectAtIndex:0].path.lastPathComponent].UTF8String);
-					} else
-					{
-						ioConfigFile = NULL;
-						[_multiAppLogViewController postErrorString: [NSString stringWithFormat:@"Unable to locate core.a or a cached core for %@", inoName]];
-					}
-				}
+				case eLogError:
+					[_multiAppLogViewController appendErrorString:message date:date];
+					break;
+				case eLogWarning:
+					[_multiAppLogViewController appendWarningString:message date:date];
+					break;
+				default:
+					[_multiAppLogViewController appendInfoString:message date:date];
+					break;
 			}
 		}
+		[_multiAppLogViewController post];
 	}
-	// Uncomment to dump the tree
-	/*if (ioConfigFile)
+	uint64_t	droppedCount = sLogSink.GetDroppedCount();
+	if (droppedCount > sLogDroppedReported)
 	{
-		std::string dumpString;
-		ioConfigFile->GetRootObject()->Write(0, dumpString);
-		fprintf(stderr, "\n\n%s\n", dumpString.c_str());
-	}*/
-	return(ioConfigFile);
+		[_multiAppLogViewController postWarningString:[NSString stringWithFormat:
+			@"%llu log messages dropped.", (unsigned long long)(droppedCount - sLogDroppedReported)]];
+		sLogDroppedReported = droppedCount;
+	}
 }
 
-/*************************** offsetTextAndDataFor *****************************/
+/******************************* postInfoString *******************************/
 /*
-*	Sets the flash/.text and SRAM/.data starting addresses.
-*	The flash starting address, which is normally 0, is offset by the value of
-*	start below.  The SRAM starting address is normally the size of the
-*	registers, but is shifted by the size of SRAM used by the Forwarder sketch
-*	(forwarderDataSize bytes).  This is done by using an edited specs-xxx file
-*	for this device derived from build.mcu (changed to specs-{xxxmod} where xxx
-*	is the device name).
+*	The log can only be updated on the main thread.  Anything posted by a
+*	sketch being built on a worker thread is pushed to sLogSink and drained by
+*	the main thread.  On the main thread anything still queued is drained
+*	first so the log stays in order.
+*	inStage and inSketch are recorded with the queued event, as they are for
+*	the command line tool, e.g. "Rebase" and the sketch's name.
 */
-- (BOOL)offsetTextAndDataFor:(NSDictionary*)inSketchRec ioConfigFile:(BoardsConfigFile*)ioConfigFile
+- (void)postInfoString:(NSString*)inString stage:(const char*)inStage sketch:(const std::string&)inSketch
 {
-	BOOL success = NO;
-	if (ioConfigFile)
+	if ([NSThread isMainThread])
 	{
-		std::string	deviceName;
-		std::string	compilerCElfFlags;
-		ioConfigFile->RawValueForKey("build.mcu", deviceName);
-		ioConfigFile->RawValueForKey("compiler.c.elf.flags", compilerCElfFlags);
-		{
-			uint32_t	start = ((NSNumber*)[inSketchRec objectForKey:kStartKey]).unsignedIntValue;
-			std::string modCompilerCElfFlags;
-			modCompilerCElfFlags.assign(compilerCElfFlags);
-			char dotTextStart[251];
-			snprintf(dotTextStart, 250, " -Wl,--section-start=.text=0x%X", start);
-			modCompilerCElfFlags.append(dotTextStart);
-			ioConfigFile->InsertKeyValue("compiler.c.elf.flags", modCompilerCElfFlags);
-			// The name of the mcu determines which specs-{build.mcu} is used.
-			std::string modDeviceName(deviceName);
-			modDeviceName.append("mod");
-			ioConfigFile->InsertKeyValue("build.mcu", modDeviceName);
-		}
-		success = [self runShellForRecipe:"recipe.c.combine.pattern" configFile:ioConfigFile];
-		// reset the modified values, the configFile is common
-		ioConfigFile->InsertKeyValue("build.mcu", deviceName);
-		ioConfigFile->InsertKeyValue("compiler.c.elf.flags", compilerCElfFlags);
-		if (success)
-		{
-			[self->_multiAppLogViewController postInfoString: [NSString stringWithFormat:
-				@"Elf file created for: %@.", [inSketchRec objectForKey:kNameKey]]];
-		}
+		[self drainLog];
+		[_multiAppLogViewController postInfoString:inString];
+	} else
+	{
+		sLogSink.Push(eLogInfo, inStage, inSketch, inString.UTF8String);
+	}
+}
+
+/****************************** postErrorString *******************************/
+- (void)postErrorString:(NSString*)inString stage:(const char*)inStage sketch:(const std::string&)inSketch
+{
+	if ([NSThread isMainThread])
+	{
+		[self drainLog];
+		[_multiAppLogViewController postErrorString:inString];
+	} else
+	{
+		sLogSink.Push(eLogError, inStage, inSketch, inString.UTF8String);
 	}
-	return(success);
 }
 
 /**************************** verifyAppTempFolder *****************************/
@@ -1861,88 +1193,61 @@ typedef std::vector<uint16_t> Uint16Vec;
 	return(success);
 }
 
-/************************** copyArduinoTempFolderFor **************************/
+/********************************* runRecipe **********************************/
 /*
-*	One more sandbox hoop to jump through... NSTask apps don't inherit
-*	the entitlements of this app so they can't create files outside of
-*	the defined sandbox when this app launched.  This means that bookmarks,
-*	which are entitlements added after launch, aren't observed for the NSTask.
-*	To get around this the Arduino temporary folders are copied to this
-*	app's temporary folder within the sandbox.
+*	Runs the tool named by the expanded inRecipeKey directly rather than by way
+*	of a shell.  The tool's output is posted to the log as it arrives.  A tool
+*	still running after kRecipeTimeout seconds is killed.
+*	Returns YES if the tool's exit status is 0.
 */
-- (BOOL)copyArduinoTempFolderFor:(NSDictionary*)inSketchRec
-{
-	NSURL*	srcTempURL = (NSURL*)[inSketchRec objectForKey:kTempURLKey];
-	NSString*	name = (NSString*)[inSketchRec objectForKey:kNameKey];
-	NSURL*	tempCopyURL = [_appTempFolderURL URLByAppendingPathComponent:[name stringByDeletingPathExtension]];
-	NSError* error = nil;
-	[[NSFileManager defaultManager] copyItemAtURL:srcTempURL toURL:tempCopyURL error:&error];
-	if (error)
-	{
-		[_multiAppLogViewController postErrorString: [NSString stringWithFormat:@"Unable to copy the Arduino temp folder for %@\n%@\n", [inSketchRec objectForKey:kNameKey], error]];
-	} else
-	{
-		[inSketchRec setValue:tempCopyURL forKey:kTempCopyURLKey];
-	}
-	return(error == nil);
-}
-
-/***************************** runShellForRecipe ******************************/
-- (BOOL)runShellForRecipe:(const char*)inRecipeKey configFile:(BoardsConfigFile*)inConfigFile
+- (BOOL)runRecipe:(const char*)inRecipeKey configFile:(BoardsConfigFile*)inConfigFile
 {
 	BOOL		success = NO;
 	std::string value;
 	uint32_t keysNotFound = 0;
+	BuildSpan	span("RunRecipe", inRecipeKey);
+	std::string	sketchName;
+	inConfigFile->RawValueForKey("build.project_name", sketchName);
 	inConfigFile->ValueForKey(inRecipeKey, value, keysNotFound);
 	//fprintf(stderr, "keysNotFound = %d\n", keysNotFound);
 	//fprintf(stderr, "%s\n", value.c_str());
-	std::string escapedArguments;
-	NSURL*	exeURL = [NSURL fileURLWithPath:@"/bin/bash"];
-	NSArray<NSString*>* arguments = @[ @"-c", [NSString stringWithUTF8String:value.c_str()] ];
-	NSTask* task = [[NSTask alloc] init];
-	task.arguments = arguments;
-	//[_multiAppLogViewController postInfoString:[NSString stringWithFormat:@"\"%@\" %@",exeURL.path, arguments]];
-	task.executableURL = exeURL;
-	__block NSString* taskOutputStr;
-	__block NSString* taskErrorStr;
-	task.standardOutput = [NSPipe pipe];
-	task.standardError = [NSPipe pipe];
-	task.terminationHandler = ^(NSTask* task)
+	RecipeRunner	recipeRunner;
+	recipeRunner.SetTimeout(kRecipeTimeout);
+	recipeRunner.SetOutputHandler([self, inRecipeKey, &sketchName](const std::string& inLines, bool inIsError)
 	{
-		NSData* taskOutput = [[task.standardOutput fileHandleForReading] readDataToEndOfFile];
-		taskOutputStr = [[NSString alloc] initWithData:taskOutput encoding:NSUTF8StringEncoding];
-		NSData* taskError = [[task.standardError fileHandleForReading] readDataToEndOfFile];
-		taskErrorStr = [[NSString alloc] initWithData:taskError encoding:NSUTF8StringEncoding];
-
-		/*if (task.terminationReason == NSTaskTerminationReasonExit && task.terminationStatus == 0)
+		NSString*	linesStr = [[NSString alloc] initWithBytes:inLines.c_str() length:inLines.size() encoding:NSUTF8StringEncoding];
+		if (inIsError)
 		{
-		}*/
-	};
-	@try
-	{
-		NSError *error = nil;
-		
-		success = [task launchAndReturnError:&error];
-		[task waitUntilExit];
-		if ([taskOutputStr length])
+			[self postErrorString:linesStr stage:inRecipeKey sketch:sketchName];
+		} else
 		{
-			[self->_multiAppLogViewController postInfoString: [NSString stringWithFormat:@"%@\n", taskOutputStr]];
+			[self postInfoString:linesStr stage:inRecipeKey sketch:sketchName];
 		}
-		if ([taskErrorStr length])
+	});
+	if (recipeRunner.Start(value))
+	{
+		if ([NSThread isMainThread])
 		{
-			success = NO;
-			[self->_multiAppLogViewController postErrorString: [NSString stringWithFormat:@"%@\n", taskErrorStr]];
+			// Run the run loop so that the output posted is displayed.
+			while (!recipeRunner.WaitFor(50))
+			{
+				[[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0]];
+			}
+		} else
+		{
+			recipeRunner.Wait();
 		}
-		if (!success)
+		success = recipeRunner.GetExitStatus() == 0;
+		if (recipeRunner.TimedOut())
 		{
-			NSLog(@"%@", error);
+			[self postErrorString: [NSString stringWithFormat:@"%s timed out after %u seconds.",
+				inRecipeKey, kRecipeTimeout] stage:inRecipeKey sketch:sketchName];
 		}
-	}
-	@catch(NSException*	inException)
+	} else
 	{
-		NSLog(@"%@", inException);
+		[self postErrorString: [NSString stringWithFormat:@"Unable to run %s: %s\n",
+			inRecipeKey, recipeRunner.GetStartError().c_str()] stage:inRecipeKey sketch:sketchName];
 	}
-
-	return(![task terminationStatus]);
+	return(success);
 }
 @end
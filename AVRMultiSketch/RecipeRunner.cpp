@@ -0,0 +1,402 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  RecipeRunner.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "RecipeRunner.h"
+#include "BuildTrace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+/*
+*	Pipes are created and the tool spawned while holding sSpawnMutex so that a
+*	tool started concurrently on another thread can't inherit the pipes before
+*	they're marked close-on-exec.  A tool holding another tool's pipe would
+*	delay that tool's end of file until it exited.
+*/
+static std::mutex	sSpawnMutex;
+
+/******************************** RecipeRunner ********************************/
+RecipeRunner::RecipeRunner(void)
+	: mPID(0), mOutputFD(-1), mErrorFD(-1), mExitStatus(0), mTimeout(0),
+	  mTimedOut(false)
+{
+}
+
+/******************************* ~RecipeRunner ********************************/
+RecipeRunner::~RecipeRunner(void)
+{
+	if (mPID)
+	{
+		kill(mPID, SIGKILL);
+		waitpid(mPID, NULL, 0);
+	}
+	Reset();
+}
+
+/*********************************** Reset ************************************/
+void RecipeRunner::Reset(void)
+{
+	if (mOutputFD >= 0)
+	{
+		close(mOutputFD);
+		mOutputFD = -1;
+	}
+	if (mErrorFD >= 0)
+	{
+		close(mErrorFD);
+		mErrorFD = -1;
+	}
+	mPID = 0;
+	mExitStatus = 0;
+	mTimedOut = false;
+	mOutput.clear();
+	mErrorOutput.clear();
+	mStartError.clear();
+}
+
+/********************************** Tokenize **********************************/
+bool RecipeRunner::Tokenize(
+	const std::string&	inCommandLine,
+	StringVec&			outArgs)
+{
+	bool	success = true;
+	const char*	cmdPtr = inCommandLine.c_str();
+	const char*	cmdEnd = &cmdPtr[inCommandLine.size()];
+	outArgs.clear();
+	while (success)
+	{
+		for (; cmdPtr < cmdEnd && (*cmdPtr == ' ' || *cmdPtr == '\t' ||
+				*cmdPtr == '\n' || *cmdPtr == '\r'); cmdPtr++){}
+		if (cmdPtr >= cmdEnd)
+		{
+			break;
+		}
+		std::string	arg;
+		char	quote = *cmdPtr;
+		if (quote == '"' || quote == '\'')
+		{
+			for (cmdPtr++; cmdPtr < cmdEnd && *cmdPtr != quote; cmdPtr++)
+			{
+				if (*cmdPtr == '\\' && &cmdPtr[1] < cmdEnd &&
+					(cmdPtr[1] == quote || cmdPtr[1] == '\\'))
+				{
+					cmdPtr++;
+				}
+				arg += *cmdPtr;
+			}
+			success = cmdPtr < cmdEnd;
+			cmdPtr++;	// Skip the closing quote
+		}
+		for (; cmdPtr < cmdEnd && *cmdPtr != ' ' && *cmdPtr != '\t' &&
+				*cmdPtr != '\n' && *cmdPtr != '\r'; cmdPtr++)
+		{
+			arg += *cmdPtr;
+		}
+		outArgs.push_back(arg);
+	}
+	return(success);
+}
+
+/*********************************** Start ************************************/
+bool RecipeRunner::Start(
+	const std::string&	inCommandLine)
+{
+	StringVec	args;
+	bool	success = Tokenize(inCommandLine, args);
+	if (success)
+	{
+		success = Start(args);
+	} else
+	{
+		Reset();
+		mExitStatus = 127;
+		mStartError.assign("unmatched quote in recipe");
+	}
+	return(success);
+}
+
+/*********************************** Start ************************************/
+bool RecipeRunner::Start(
+	const StringVec&	inArgs)
+{
+	bool	success = mPID == 0 && inArgs.size() > 0;
+	if (success)
+	{
+		Reset();
+		std::vector<char*>	argv;
+		for (const std::string& arg : inArgs)
+		{
+			argv.push_back((char*)arg.c_str());
+		}
+		argv.push_back(NULL);
+		int	outputPipe[2];
+		int	errorPipe[2];
+		int	error = 0;
+		{
+			std::lock_guard<std::mutex>	lock(sSpawnMutex);
+			if (pipe(outputPipe) == 0)
+			{
+				if (pipe(errorPipe) == 0)
+				{
+					for (int fd : {outputPipe[0], outputPipe[1], errorPipe[0], errorPipe[1]})
+					{
+						fcntl(fd, F_SETFD, FD_CLOEXEC);
+					}
+					posix_spawn_file_actions_t	fileActions;
+					posix_spawn_file_actions_init(&fileActions);
+					posix_spawn_file_actions_addopen(&fileActions, 0, "/dev/null", O_RDONLY, 0);
+					posix_spawn_file_actions_adddup2(&fileActions, outputPipe[1], 1);
+					posix_spawn_file_actions_adddup2(&fileActions, errorPipe[1], 2);
+					error = posix_spawnp(&mPID, argv[0], &fileActions, NULL, argv.data(), environ);
+					posix_spawn_file_actions_destroy(&fileActions);
+					close(errorPipe[1]);
+					if (error == 0)
+					{
+						BuildTrace::Count(BuildTrace::eProcessesSpawned, 1);
+						mErrorFD = errorPipe[0];
+					} else
+					{
+						close(errorPipe[0]);
+					}
+				} else
+				{
+					error = errno;
+				}
+				close(outputPipe[1]);
+				if (error == 0)
+				{
+					mOutputFD = outputPipe[0];
+				} else
+				{
+					close(outputPipe[0]);
+				}
+			} else
+			{
+				error = errno;
+			}
+		}
+		success = error == 0;
+		if (success)
+		{
+			fcntl(mOutputFD, F_SETFL, O_NONBLOCK);
+			fcntl(mErrorFD, F_SETFL, O_NONBLOCK);
+			mDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(mTimeout);
+		} else
+		{
+			mPID = 0;
+			mExitStatus = 127;
+			mStartError.assign(inArgs[0]);
+			mStartError.append(": ");
+			mStartError.append(strerror(error));
+		}
+	}
+	return(success);
+}
+
+/******************************* ReadAvailable ********************************/
+/*
+*	Appends whatever can be read from ioFD without blocking.  On end of file
+*	ioFD is closed and set to -1.  Returns true if anything was read.
+*/
+bool RecipeRunner::ReadAvailable(
+	int&			ioFD,
+	std::string&	ioOutput,
+	bool			inIsError)
+{
+	bool	dataRead = false;
+	while (ioFD >= 0)
+	{
+		char	buffer[0x4000];
+		ssize_t	bytesRead = read(ioFD, buffer, sizeof(buffer));
+		if (bytesRead > 0)
+		{
+			ioOutput.append(buffer, bytesRead);
+			dataRead = true;
+		} else if (bytesRead < 0 && errno == EINTR)
+		{
+			continue;
+		} else if (bytesRead < 0 && errno == EAGAIN)
+		{
+			break;
+		} else	// End of file or an error
+		{
+			close(ioFD);
+			ioFD = -1;
+		}
+	}
+	if (dataRead)
+	{
+		DeliverLines(ioOutput, inIsError, false);
+	}
+	return(dataRead);
+}
+
+/******************************** DeliverLines ********************************/
+/*
+*	If there's an output handler, passes it the complete lines in ioOutput and
+*	removes them.  If inFlush, a final line without a newline is passed too.
+*/
+void RecipeRunner::DeliverLines(
+	std::string&	ioOutput,
+	bool			inIsError,
+	bool			inFlush)
+{
+	if (mOutputHandler && ioOutput.size())
+	{
+		size_t	lineEnd = ioOutput.rfind('\n');
+		if (lineEnd != std::string::npos)
+		{
+			mOutputHandler(ioOutput.substr(0, lineEnd), inIsError);
+			ioOutput.erase(0, lineEnd + 1);
+		}
+		if (inFlush && ioOutput.size())
+		{
+			mOutputHandler(ioOutput, inIsError);
+			ioOutput.clear();
+		}
+	}
+}
+
+/************************************ Poll ************************************/
+bool RecipeRunner::Poll(void)
+{
+	if (mPID)
+	{
+		ReadAvailable(mOutputFD, mOutput, false);
+		ReadAvailable(mErrorFD, mErrorOutput, true);
+		if (mTimeout && !mTimedOut &&
+			std::chrono::steady_clock::now() >= mDeadline)
+		{
+			mTimedOut = true;
+			kill(mPID, SIGKILL);
+		}
+		int		status;
+		pid_t	pid = waitpid(mPID, &status, WNOHANG);
+		if (pid == mPID ||
+			(pid < 0 && errno != EINTR))
+		{
+			/*
+			*	Collect anything written just before the tool exited.  Any pipe
+			*	still open belongs to a process the tool left running, so it
+			*	isn't waited on.
+			*/
+			ReadAvailable(mOutputFD, mOutput, false);
+			ReadAvailable(mErrorFD, mErrorOutput, true);
+			DeliverLines(mOutput, false, true);
+			DeliverLines(mErrorOutput, true, true);
+			if (mOutputFD >= 0)
+			{
+				close(mOutputFD);
+				mOutputFD = -1;
+			}
+			if (mErrorFD >= 0)
+			{
+				close(mErrorFD);
+				mErrorFD = -1;
+			}
+			if (pid < 0)
+			{
+				mExitStatus = 127;
+			} else if (WIFEXITED(status))
+			{
+				mExitStatus = WEXITSTATUS(status);
+			} else
+			{
+				// Same as the shell, 128 + the signal number.
+				mExitStatus = 128 + (WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+			}
+			mPID = 0;
+		}
+	}
+	return(mPID == 0);
+}
+
+/************************************ Wait ************************************/
+void RecipeRunner::Wait(void)
+{
+	while (!WaitFor(1000)){}
+}
+
+/********************************** WaitFor ***********************************/
+bool RecipeRunner::WaitFor(
+	uint32_t	inMilliseconds)
+{
+	std::chrono::steady_clock::time_point	waitEnd =
+		std::chrono::steady_clock::now() + std::chrono::milliseconds(inMilliseconds);
+	bool	exited;
+	while (!(exited = Poll()))
+	{
+		std::chrono::steady_clock::time_point	now = std::chrono::steady_clock::now();
+		if (now >= waitEnd)
+		{
+			break;
+		}
+		/*
+		*	Sleep until there's output, the pipes close, the wait ends, or the
+		*	tool times out.  The sleep is also limited so that a tool that exits
+		*	while a process it started keeps the pipes open is noticed.
+		*/
+		std::chrono::steady_clock::time_point	wakeTime = waitEnd;
+		if (mTimeout && !mTimedOut && mDeadline < wakeTime)
+		{
+			wakeTime = mDeadline;
+		}
+		int	timeout = (int)std::chrono::duration_cast<std::chrono::milliseconds>(wakeTime - now).count() + 1;
+		if (timeout > 100)
+		{
+			timeout = 100;
+		}
+		struct pollfd	pollFDs[2];
+		nfds_t	numFDs = 0;
+		for (int fd : {mOutputFD, mErrorFD})
+		{
+			if (fd >= 0)
+			{
+				pollFDs[numFDs].fd = fd;
+				pollFDs[numFDs].events = POLLIN;
+				pollFDs[numFDs].revents = 0;
+				numFDs++;
+			}
+		}
+		if (numFDs)
+		{
+			poll(pollFDs, numFDs, timeout);
+		} else
+		{
+			// Both pipes are closed, the tool should exit momentarily.
+			usleep(50);
+		}
+	}
+	return(exited);
+}
@@ -0,0 +1,130 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  RecipeRunner.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef RecipeRunner_h
+#define RecipeRunner_h
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+typedef std::vector<std::string> StringVec;
+/*
+*	Receives one or more complete lines of output, without the last line's
+*	newline.  inIsError is true if the lines were written to stderr.
+*/
+typedef std::function<void(const std::string& inLines, bool inIsError)> OutputHandler;
+
+/*
+*	RecipeRunner runs an expanded recipe (e.g. recipe.c.combine.pattern) by
+*	splitting it into arguments and starting the tool directly using
+*	posix_spawn rather than by way of a shell.
+*
+*	Start returns as soon as the tool is launched.  Poll, which doesn't block,
+*	collects any output and returns true once the tool has exited.  Wait blocks
+*	until the tool has exited.
+*
+*	Both pipes are read while the tool runs so a tool with a lot of output
+*	never stalls on a full pipe.  If an output handler is set, the output is
+*	passed to it a line at a time as it arrives rather than being kept.  If a
+*	timeout is set, a tool still running after the timeout is killed.
+*/
+class RecipeRunner
+{
+public:
+							RecipeRunner(void);
+	virtual					~RecipeRunner(void);
+	/*
+	*	Splits inCommandLine into arguments the same way arduino-builder does:
+	*	arguments are separated by spaces, an argument starting with a single
+	*	or double quote continues to the matching closing quote and the quotes
+	*	are removed.  Within a quoted argument a backslash escapes the quote
+	*	character or a backslash.  A quote anywhere else is part of the
+	*	argument.  Returns false if a quote isn't closed.
+	*/
+	static bool				Tokenize(
+								const std::string&		inCommandLine,
+								StringVec&				outArgs);
+	bool					Start(
+								const std::string&		inCommandLine);
+	bool					Start(
+								const StringVec&		inArgs);
+							// Returns true when the tool has exited.
+	bool					Poll(void);
+	void					Wait(void);
+							// Returns true if the tool exits within inMilliseconds.
+	bool					WaitFor(
+								uint32_t				inMilliseconds);
+							// Set before Start
+	void					SetOutputHandler(
+								const OutputHandler&	inOutputHandler)
+								{mOutputHandler = inOutputHandler;}
+							// Set before Start, 0 = no timeout (the default)
+	void					SetTimeout(
+								uint32_t				inSeconds)
+								{mTimeout = inSeconds;}
+							// The tool was killed because it timed out.
+	bool					TimedOut(void) const
+								{return(mTimedOut);}
+	bool					IsRunning(void) const
+								{return(mPID != 0);}
+							// Valid after Poll returns true or Wait returns.
+	int						GetExitStatus(void) const
+								{return(mExitStatus);}
+	const std::string&		GetOutput(void) const
+								{return(mOutput);}
+	const std::string&		GetErrorOutput(void) const
+								{return(mErrorOutput);}
+							// The reason Start failed.
+	const std::string&		GetStartError(void) const
+								{return(mStartError);}
+protected:
+	pid_t		mPID;
+	int			mOutputFD;
+	int			mErrorFD;
+	int			mExitStatus;
+	std::string	mOutput;
+	std::string	mErrorOutput;
+	std::string	mStartError;
+	OutputHandler	mOutputHandler;
+	uint32_t	mTimeout;
+	bool		mTimedOut;
+	std::chrono::steady_clock::time_point	mDeadline;
+
+	bool					ReadAvailable(
+								int&					ioFD,
+								std::string&			ioOutput,
+								bool					inIsError);
+	void					DeliverLines(
+								std::string&			ioOutput,
+								bool					inIsError,
+								bool					inFlush);
+	void					Reset(void);
+};
+
+#endif /* RecipeRunner_h */
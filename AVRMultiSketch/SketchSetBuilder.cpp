@@ -0,0 +1,1215 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  SketchSetBuilder.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "SketchSetBuilder.h"
+#include "BuildTrace.h"
+#include "FileInputBuffer.h"
+#include "FileStager.h"
+#include "FlashImage.h"
+#include "JSONElement.h"
+#include "RecipeRunner.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// A recipe still running after this many seconds is killed.
+static const uint32_t kRecipeTimeout = 300;
+// The files stored in the build cache for each sketch
+static const char* const kBuildCacheExtensions[] = {"elf", "hex", "eep", NULL};
+static const char* const kRelocatableExtensions[] = {"elf", NULL};
+static const uint32_t	kBuildCacheVersion = 3;
+// Follows the version in a key, after the roles 0 to 2 used by GetCacheKey.
+static const uint32_t	kRelocatableRole = 3;
+// Defining AVR_OBJ_DUMP will run avr-objdump for all elf files.
+// Saved as xxxM.ino.elf.txt, where xxx is the sketch name.  The application's
+// targets define it, the command line tool doesn't.
+
+/********************************* IsFolder ***********************************/
+static bool IsFolder(
+	const std::string&	inPath)
+{
+	struct stat	pathStat;
+	return(stat(inPath.c_str(), &pathStat) == 0 && S_ISDIR(pathStat.st_mode));
+}
+
+/******************************** CollectFiles ********************************/
+/*
+*	Appends the paths of the files in inFolder and its subfolders ending with
+*	inSuffix to ioPaths, each preceded by a space.
+*/
+static void CollectFiles(
+	const std::string&	inFolder,
+	const char*			inSuffix,
+	std::string&		ioPaths)
+{
+	DIR*	dir = opendir(inFolder.c_str());
+	if (dir)
+	{
+		size_t	suffixLen = strlen(inSuffix);
+		struct dirent*	entry;
+		while ((entry = readdir(dir)) != NULL)
+		{
+			if (entry->d_name[0] == '.')
+			{
+				continue;
+			}
+			std::string	path(inFolder + "/" + entry->d_name);
+			if (IsFolder(path))
+			{
+				CollectFiles(path, inSuffix, ioPaths);
+			} else if (path.size() > suffixLen &&
+				path.compare(path.size() - suffixLen, suffixLen, inSuffix) == 0)
+			{
+				ioPaths += ' ';
+				ioPaths.append(path);
+			}
+		}
+		closedir(dir);
+	}
+}
+
+/******************************** ReadTextFile ********************************/
+static bool ReadTextFile(
+	const std::string&	inPath,
+	std::string&		outText)
+{
+	FILE*	file = fopen(inPath.c_str(), "r");
+	bool	success = file != NULL;
+	outText.clear();
+	if (success)
+	{
+		char	buffer[0x1000];
+		size_t	bytesRead;
+		while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			outText.append(buffer, bytesRead);
+		}
+		success = ferror(file) == 0;
+		fclose(file);
+	}
+	return(success);
+}
+
+/***************************** FindSpecsDataValue *****************************/
+/*
+*	Returns the offset within inSpecsText of the hex digits of the -Tdata
+*	option value, e.g. the 800100 of -Tdata 0x800100.  outValue is the value.
+*	Returns std::string::npos if there is no -Tdata option.
+*/
+static size_t FindSpecsDataValue(
+	const std::string&	inSpecsText,
+	uint32_t&			outValue)
+{
+	size_t	valueOffset = inSpecsText.find("-Tdata");
+	if (valueOffset != std::string::npos)
+	{
+		size_t	lineEnd = inSpecsText.find('\n', valueOffset);
+		valueOffset = inSpecsText.find("0x", valueOffset);
+		if (valueOffset < lineEnd)
+		{
+			valueOffset += 2;
+			outValue = (uint32_t)strtoul(&inSpecsText[valueOffset], NULL, 16);
+		} else
+		{
+			valueOffset = std::string::npos;
+		}
+	}
+	return(valueOffset);
+}
+
+/****************************** SketchSetBuilder ******************************/
+SketchSetBuilder::SketchSetBuilder(
+	BoardsConfigFiles&	ioConfigFiles,
+	WorkerPool&			ioWorkerPool,
+	const BuildCache&	inBuildCache,
+	HardwareIndex&		ioHardwareIndex,
+	const BoardSnapshots& inBoardSnapshots,
+	LogSink&			ioLogSink)
+	: mConfigFiles(ioConfigFiles), mWorkerPool(ioWorkerPool),
+	  mBuildCache(inBuildCache), mHardwareIndex(ioHardwareIndex),
+	  mBoardSnapshots(inBoardSnapshots), mLogSink(ioLogSink),
+	  mForwarderDataSize(0), mFlashUsed(0)
+{
+}
+
+/***************************** ~SketchSetBuilder ******************************/
+SketchSetBuilder::~SketchSetBuilder(void)
+{
+}
+
+/********************************** PostInfo **********************************/
+void SketchSetBuilder::PostInfo(
+	const char*			inStage,
+	const std::string&	inSketch,
+	const std::string&	inMessage)
+{
+	mLogSink.Push(eLogInfo, inStage, inSketch, inMessage);
+}
+
+/********************************* PostError **********************************/
+void SketchSetBuilder::PostError(
+	const char*			inStage,
+	const std::string&	inSketch,
+	const std::string&	inMessage)
+{
+	mLogSink.Push(eLogError, inStage, inSketch, inMessage);
+}
+
+/******************************* GetSketchInfo ********************************/
+void SketchSetBuilder::GetSketchInfo(
+	uint32_t		inSketchIndex,
+	uint32_t&		outStart,
+	uint32_t&		outLength,
+	std::string&	outFQBN,
+	std::string&	outDeviceName)
+{
+	SSketch&	sketch = mSketches[inSketchIndex];
+	outStart = sketch.start;
+	outLength = sketch.length;
+	outFQBN = sketch.configFile.GetFQBN();
+	outDeviceName.clear();
+	sketch.configFile.RawValueForKey("build.mcu", outDeviceName);
+}
+
+/*********************************** Build ************************************/
+bool SketchSetBuilder::Build(
+	const SketchDescs&	inSketches,
+	const std::string&	inFQBN,
+	const std::string&	inCoreCacheFolder,
+	const std::string&	inWorkFolder,
+	const std::string&	inHexPath,
+	const std::string&	inEepPath)
+{
+	BuildSpan	span("BuildSet", inHexPath.c_str());
+	uint32_t	numSketches = (uint32_t)inSketches.size();
+	/*
+	*	The vector is swapped rather than resized because neither the config
+	*	nor the elf file can be copied.
+	*/
+	{
+		std::vector<SSketch>	sketches(numSketches);
+		mSketches.swap(sketches);
+	}
+	mWorkFolder.assign(inWorkFolder);
+	mSpecsFolder.clear();
+	mModSpecsFolder.assign(mWorkFolder + "/specs");
+	mSubSketchOffsets.clear();
+	memset(&mForwarderAddresses, 0, sizeof(mForwarderAddresses));
+	mForwarderDataSize = 0;
+	mFlashUsed = 0;
+	bool	success = numSketches >= 2;
+	if (!success)
+	{
+		PostError("Stage", std::string(), "A sketch set needs at least a Forwarder and a Selector sketch.");
+	}
+	FileStager	fileStager;
+	if (success)
+	{
+		success = FileStager::MakeFolders(mWorkFolder);
+		if (success && !inCoreCacheFolder.empty())
+		{
+			// Only the core archives are used from an arduino_cache_ folder.
+			std::string	cacheFolder(mWorkFolder + "/cache");
+			FileStager::RemoveFolder(cacheFolder);
+			success = fileStager.StageFolder(inCoreCacheFolder, cacheFolder,
+				[](const std::string& inRelativePath)
+				{
+					return(inRelativePath.compare(0, 5, "core/") == 0 &&
+						inRelativePath.compare(inRelativePath.size() - 2, 2, ".a") == 0);
+				});
+		}
+		if (!success)
+		{
+			PostError("Stage", std::string(), "Unable to create the work folder " + mWorkFolder);
+		}
+	}
+	for (uint32_t sketchIndex = 0; success && sketchIndex < numSketches; sketchIndex++)
+	{
+		SSketch&	sketch = mSketches[sketchIndex];
+		sketch.desc = inSketches[sketchIndex];
+		success = StageSketch(sketch, fileStager);
+		if (success)
+		{
+			BoardsConfigFile*	configFile = InitializeFQBNConfig(sketch);
+			success = configFile != NULL;
+			if (success &&
+				!inFQBN.empty() &&
+				configFile->GetFQBN() != inFQBN)
+			{
+				PostError("Stage", sketch.desc.name, sketch.desc.name + " was built for " + configFile->GetFQBN() + ", not " + inFQBN);
+				success = false;
+			}
+			if (success)
+			{
+				sketch.configFile.Overlay(*configFile);
+				// The Selector's board is the primary board, used to upload.
+				if (sketchIndex == 1)
+				{
+					mConfigFiles.SetPrimaryFQBN(configFile->GetFQBN());
+				}
+			}
+		}
+	}
+	if (success)
+	{
+		char	report[256];
+		snprintf(report, sizeof(report),
+			"Arduino build files staged: %llu KB linked, %llu KB cloned, %llu KB copied, "
+			"%llu KB of %llu KB in the Arduino folders not copied.",
+			(unsigned long long)fileStager.GetBytesStaged(FileStager::eLinked)/1024,
+			(unsigned long long)fileStager.GetBytesStaged(FileStager::eCloned)/1024,
+			(unsigned long long)fileStager.GetBytesStaged(FileStager::eCopied)/1024,
+			(unsigned long long)fileStager.GetBytesAvoided()/1024,
+			(unsigned long long)fileStager.GetBytesInFolders()/1024);
+		PostInfo("Stage", std::string(), report);
+		success = CheckSketches() && CreateModSpecs();
+	}
+	if (success)
+	{
+		/*
+		*	The Forwarder is built first because the Selector and the sub
+		*	sketches are patched using addresses resolved in the Forwarder.
+		*	All of the other sketches only depend on the Forwarder so they're
+		*	built concurrently.
+		*/
+		std::atomic<bool>	allBuilt(true);
+		for (uint32_t sketchIndex = 0; sketchIndex < numSketches; sketchIndex++)
+		{
+			mWorkerPool.Add([this, sketchIndex, &allBuilt]()
+			{
+				if (allBuilt &&
+					!BuildSketch(sketchIndex))
+				{
+					allBuilt = false;
+				}
+			});
+			if (sketchIndex == 0)
+			{
+				mWorkerPool.Wait();
+			}
+		}
+		mWorkerPool.Wait();
+		success = allBuilt;
+	}
+	if (success)
+	{
+		/*
+		*	Add the patched flash and EEPROM content of each sketch to the
+		*	combined images.
+		*/
+		BuildSpan	combineSpan("CombineImages");
+		FlashImage	flashImage;
+		FlashImage	eepromImage;
+		for (uint32_t sketchIndex = 0; success && sketchIndex < numSketches; sketchIndex++)
+		{
+			SSketch&	sketch = mSketches[sketchIndex];
+			HexChunks	chunks;
+			uint32_t	overlapFrom, overlapTo;
+			char	message[256];
+			sketch.elfFile.GetFlashChunks(chunks);
+			if (!flashImage.Add(chunks))
+			{
+				flashImage.GetOverlap(overlapFrom, overlapTo);
+				snprintf(message, sizeof(message), "%s flash addresses 0x%X to 0x%X overlap a previous sketch.",
+					sketch.desc.name.c_str(), overlapFrom, overlapTo);
+				PostError("Combine", sketch.desc.name, message);
+				success = false;
+			}
+			sketch.elfFile.GetEEPROMChunks(chunks);
+			if (!eepromImage.Add(chunks))
+			{
+				eepromImage.GetOverlap(overlapFrom, overlapTo);
+				snprintf(message, sizeof(message), "%s EEPROM addresses 0x%X to 0x%X overlap a previous sketch.",
+					sketch.desc.name.c_str(), overlapFrom, overlapTo);
+				PostError("Combine", sketch.desc.name, message);
+				success = false;
+			}
+		}
+		if (success)
+		{
+			std::string	flashMaxSize;
+			// The Selector's board is the primary board.
+			mSketches[1].configFile.RawValueForKey("upload.maximum_size", flashMaxSize);
+			success = (uint32_t)atoi(flashMaxSize.c_str()) >= mFlashUsed;
+			if (success)
+			{
+				success = flashImage.WriteHexFile(inHexPath.c_str()) &&
+					eepromImage.WriteHexFile(inEepPath.c_str());
+				if (success)
+				{
+					PostInfo("Combine", std::string(), "Combined hex and eep created: " + inHexPath + ", " + inEepPath);
+				} else
+				{
+					PostError("Combine", std::string(), "Combined hex and eep files not created.");
+				}
+			} else
+			{
+				PostError("Combine", std::string(), "Flash size exceeded, should be less than: " + flashMaxSize + ".");
+			}
+		}
+	}
+	return(success);
+}
+
+/******************************** StageSketch *********************************/
+/*
+*	Stages the files of the sketch's build folder used by the link recipe to
+*	its work folder.  Only the files the link recipe uses are staged: the
+*	sketch and library object files, core.a, and build.options.json.  These
+*	are hard linked when possible.  The elf file is patched in place so it
+*	gets a private copy.
+*/
+bool SketchSetBuilder::StageSketch(
+	SSketch&	ioSketch,
+	FileStager&	ioFileStager)
+{
+	const std::string&	name = ioSketch.desc.name;
+	BuildSpan	span("StageSketch", name.c_str());
+	size_t	extensionDot = name.rfind('.');
+	ioSketch.workFolder.assign(mWorkFolder + "/" + name.substr(0, extensionDot));
+	// Remove anything left by a previous build, e.g. a library no longer used.
+	FileStager::RemoveFolder(ioSketch.workFolder);
+	std::string	sketchObjPath("sketch/" + name + ".cpp.o");
+	bool	success = ioFileStager.StageFolder(ioSketch.desc.buildFolder, ioSketch.workFolder,
+		[&sketchObjPath](const std::string& inRelativePath)
+		{
+			return(inRelativePath == sketchObjPath ||
+				inRelativePath == "core/core.a" ||
+				inRelativePath == "build.options.json" ||
+				(inRelativePath.compare(0, 10, "libraries/") == 0 &&
+					inRelativePath.compare(inRelativePath.size() - 2, 2, ".o") == 0));
+		}) &&
+		ioFileStager.StageFile(ioSketch.desc.buildFolder + "/" + name + ".elf", ElfPath(ioSketch), true);
+	if (!success)
+	{
+		PostError("Stage", name, "Unable to stage the Arduino build folder for " + name + ": " + ioSketch.desc.buildFolder);
+	}
+	return(success);
+}
+
+/**************************** InitializeFQBNConfig ****************************/
+/*
+*	Returns the configuration for the FQBN in the sketch's build.options.json,
+*	reading the board's boards.txt and platform.txt the first time the FQBN is
+*	used.  On later calls for the same FQBN the configuration already read is
+*	returned.
+*/
+BoardsConfigFile* SketchSetBuilder::InitializeFQBNConfig(
+	const SSketch&	inSketch)
+{
+	BuildSpan	span("FQBNConfig", inSketch.desc.name.c_str());
+	BoardsConfigFile*	configFile = NULL;
+	FileInputBuffer		jsonFileInput((inSketch.workFolder + "/build.options.json").c_str());
+	JSONObject*			json = jsonFileInput.IsValid() ? (JSONObject*)IJSONElement::Create(jsonFileInput) : NULL;
+	if (json &&
+		json->GetType() == IJSONElement::eObject)
+	{
+		JSONString* customBuildProperties = (JSONString*)json->GetElement("customBuildProperties", IJSONElement::eString);
+		JSONString* fqbn = (JSONString*)json->GetElement("fqbn", IJSONElement::eString);
+		if (fqbn)
+		{
+			configFile = mConfigFiles.GetConfigForFQBN(fqbn->GetString());
+			if (!configFile)
+			{
+				configFile = new BoardsConfigFile(fqbn->GetString());
+				mConfigFiles.AdoptBoardsConfigFile(configFile);	// mConfigFiles adopts/takes ownership of configFile
+				/*
+				*	Look through the hardware folders for the boards.txt and
+				*	platform.txt for this FQBN.  The first hardware folder
+				*	containing the FQBN's package is looked up in the index.
+				*/
+				SArchitecturePaths	architecturePaths;
+				JSONString* hardwareFolders = (JSONString*)json->GetElement("hardwareFolders", IJSONElement::eString);
+				if (hardwareFolders)
+				{
+					StringInputBuffer	inputBuffer(hardwareFolders->GetString());
+					std::string		hardwarePath;
+					bool	morePaths = false;
+					do
+					{
+						morePaths = inputBuffer.ReadTillChar(',', false, hardwarePath);
+						inputBuffer++;
+						hardwarePath += '/';
+						hardwarePath.append(configFile->GetPackage());
+						if (IsFolder(hardwarePath))
+						{
+							if (mHardwareIndex.Find(hardwarePath, configFile->GetArchitecture(), architecturePaths))
+							{
+								configFile->InsertKeyValue("runtime.platform.path",
+									architecturePaths.platformTxtPath.substr(0, architecturePaths.platformTxtPath.rfind('/')));
+							}
+							break;
+						}
+						hardwarePath.clear();
+					} while(morePaths);
+				}
+				const std::string&	boardsTxtPath = architecturePaths.boardsTxtPath;
+				const std::string&	platformTxtPath = architecturePaths.platformTxtPath;
+				if (!boardsTxtPath.empty() && !platformTxtPath.empty())
+				{
+					// The files are only parsed when there's no current snapshot of them.
+					bool	loaded = mBoardSnapshots.Load(boardsTxtPath, platformTxtPath, *configFile);
+					if (!loaded)
+					{
+						BoardSnapshots::SFileStamp	boardsTxtStamp, platformTxtStamp;
+						bool	stamped = BoardSnapshots::GetFileStamp(boardsTxtPath, boardsTxtStamp) &&
+							BoardSnapshots::GetFileStamp(platformTxtPath, platformTxtStamp);
+						loaded = configFile->ReadFile(platformTxtPath.c_str(), false) &&
+							configFile->ReadFile(boardsTxtPath.c_str(), true);
+						if (loaded && stamped)
+						{
+							mBoardSnapshots.Save(boardsTxtPath, boardsTxtStamp,
+								platformTxtPath, platformTxtStamp, *configFile);
+						}
+					}
+					if (loaded)
+					{
+						if (customBuildProperties)
+						{
+							configFile->ReadDelimitedKeyValuesFromString(customBuildProperties->GetString());
+						}
+						/*
+						*	If the customBuildProperties didn't exist (very rare)
+						*	or customBuildProperties doesn't contain the expected
+						*	tools/avr keys THEN
+						*	attempt to add them using the toolsFolders object.
+						*/
+						std::string value;
+						if (!configFile->RawValueForKey("runtime.tools.avr-gcc.path", value))
+						{
+							JSONString* toolsFolders = (JSONString*)json->GetElement("toolsFolders", IJSONElement::eString);
+							if (toolsFolders)
+							{
+								StringInputBuffer	inputBuffer(toolsFolders->GetString());
+								for (uint8_t thisChar = inputBuffer.CurrChar(); thisChar; thisChar = inputBuffer.CurrChar())
+								{
+									inputBuffer.ReadTillChar(',', false, value);
+									if (value.size() < 3 ||
+										value.compare(value.length()-3, 3, "avr"))
+									{
+										value.clear();
+										inputBuffer.NextChar();	// Skip the Delimiter
+										continue;
+									}
+									configFile->InsertKeyValue("runtime.tools.avr-gcc.path", value);
+									configFile->InsertKeyValue("runtime.tools.avrdude.path", value);
+									break;
+								}
+							}
+						}
+#ifdef AVR_OBJ_DUMP
+						// For debugging
+						// Recipes aren't run by a shell so the redirection needs one.
+						configFile->InsertKeyValue("recipe.elfdump.pattern",
+							"/bin/bash -c \"\\\"{compiler.path}avr-objdump\\\" -h -S -d -t -j .data -j .text -j .bss "
+							"\\\"{build.path}/{build.project_name}.elf\\\" > "
+							"\\\"{build.path}/{build.project_name}M.elf.txt\\\"\"");
+#endif
+						// Compile the recipes once here, the sketches' overlays only read them
+						configFile->CompileValueTemplates();
+					} else
+					{
+						mConfigFiles.EraseBoardsConfigFile(fqbn->GetString());
+						configFile = NULL;
+						PostError("Config", inSketch.desc.name, "Unable to load boards.txt and/or platform.txt for " + inSketch.desc.name);
+					}
+				} else
+				{
+					mConfigFiles.EraseBoardsConfigFile(fqbn->GetString());
+					configFile = NULL;
+					PostError("Config", inSketch.desc.name, "Unable to locate boards.txt and/or platform.txt for " + inSketch.desc.name);
+				}
+			}
+		}
+	}
+	if (!configFile && !json)
+	{
+		PostError("Config", inSketch.desc.name, "Unable to read build.options.json for " + inSketch.desc.name);
+	}
+	delete json;
+	return(configFile);
+}
+
+/******************************* FinalizeConfig *******************************/
+/*
+*	Adds the keys normally added by Arduino that are specific to the sketch.
+*/
+bool SketchSetBuilder::FinalizeConfig(
+	SSketch&	ioSketch)
+{
+	BoardsConfigFile&	configFile = ioSketch.configFile;
+	configFile.InsertKeyValue("build.path", ioSketch.workFolder);
+	configFile.InsertKeyValue("build.project_name", ioSketch.desc.name);
+	// object files referenced by the root object_files key
+	std::string	objectFiles(ioSketch.workFolder + "/sketch/" + ioSketch.desc.name + ".cpp.o");
+	CollectFiles(ioSketch.workFolder + "/libraries", ".o", objectFiles);
+	configFile.InsertKeyValue("object_files", objectFiles);
+	/*
+	*	See if there's a cached core.a file with a mangled FQBN prefix.
+	*	If there is then use it. If not, look for the core.a in the core
+	*	folder of the sketch's work folder.  If neither exists and there's
+	*	only one cached core, assume it's the one.
+	*/
+	std::vector<std::string>	cachedCores;
+	std::string	archiveFile;
+	DIR*	dir = opendir((mWorkFolder + "/cache/core").c_str());
+	if (dir)
+	{
+		struct dirent*	entry;
+		while ((entry = readdir(dir)) != NULL)
+		{
+			if (entry->d_name[0] != '.')
+			{
+				cachedCores.push_back(entry->d_name);
+			}
+		}
+		closedir(dir);
+	}
+	const std::string&	cachedCoreNamePrefix = configFile.GetCoreFQBNPrefix();
+	for (const std::string& cachedCore : cachedCores)
+	{
+		if (cachedCore.compare(0, cachedCoreNamePrefix.size(), cachedCoreNamePrefix) == 0)
+		{
+			archiveFile.assign("/../cache/core/" + cachedCore);
+			break;
+		}
+	}
+	if (archiveFile.empty())
+	{
+		struct stat	coreStat;
+		if (stat((ioSketch.workFolder + "/core/core.a").c_str(), &coreStat) == 0)
+		{
+			archiveFile.assign("core/core.a");
+		} else if (cachedCores.size() == 1)
+		{
+			archiveFile.assign("/../cache/core/" + cachedCores[0]);
+		}
+	}
+	bool	success = !archiveFile.empty();
+	if (success)
+	{
+		configFile.InsertKeyValue("archive_file", archiveFile);
+	} else
+	{
+		PostError("Config", ioSketch.desc.name, "Unable to locate core.a or a cached core for " + ioSketch.desc.name);
+	}
+	return(success);
+}
+
+/******************************* CheckSketches ********************************/
+/*
+*	Places the sketches one after another in flash, checks that the first two
+*	are the Forwarder and the Selector, and that the Forwarder forwards every
+*	ISR used by the other sketches.
+*/
+bool SketchSetBuilder::CheckSketches(void)
+{
+	BuildSpan	span("CheckSketches");
+	bool		success = true;
+	uint32_t	offset = 0;
+	IndexVec	forwarderVectors;
+	IndexVec	reqSketchVectors;
+	uint32_t	numSketches = (uint32_t)mSketches.size();
+	for (uint32_t sketchIndex = 0; success && sketchIndex < numSketches; sketchIndex++)
+	{
+		SSketch&	sketch = mSketches[sketchIndex];
+		AVRElfFile	elfFile;
+		success = elfFile.ReadFile(ElfPath(sketch).c_str(), true) &&
+			elfFile.GetVectorIndexes(sketchIndex ? reqSketchVectors : forwarderVectors);
+		if (!success)
+		{
+			PostError("Check", sketch.desc.name, "Unable to open the " + sketch.desc.name +
+				".elf file and/or the elf file is damaged and/or this is not an AVR device.");
+			break;
+		}
+		sketch.start = offset;
+		sketch.length = elfFile.GetFlashUsed();
+		mSubSketchOffsets.push_back((uint16_t)(offset/2));
+		offset += sketch.length;
+		SResolvedSymbols	resolved;
+		switch (sketchIndex)
+		{
+			case 0:	// Forwarder Sketch
+				success = elfFile.ResolveSymbols(kForwarderSymbols, eNumRequiredForwarderSymbols, resolved);
+				if (success)
+				{
+					mForwarderDataSize = elfFile.GetDataSize();
+				} else
+				{
+					PostError("Check", sketch.desc.name, "The first sketch in the list must be the Forwarder sketch, " + sketch.desc.name +
+						" is not a Forwarder.\nExpected symbols not found: " + resolved.missing);
+				}
+				break;
+			case 1:	// Selector Sketch
+				success = elfFile.ResolveSymbols(kSelectorSymbols, eNumSelectorSymbols, resolved);
+				if (!success)
+				{
+					PostError("Check", sketch.desc.name, "The second sketch in the list must be the Selector sketch, " + sketch.desc.name +
+						" is not a Selector.\nExpected symbols not found: " + resolved.missing);
+				} else if (resolved.symbols[eSubSketchAddress].symTblEntry->size < (numSketches - 2)*2)
+				{
+					PostError("Check", sketch.desc.name, "Increase the capacity of the Selector sketch array subSketchAddress to " +
+						std::to_string(numSketches - 2) + ".");
+					success = false;
+				}
+				break;
+		}
+	}
+	mFlashUsed = offset;
+	/*
+	*	If the forwarder sketch doesn't contain all of the ISRs used by all of
+	*	the sketches THEN list the FORWARD_ISR macros to add.
+	*/
+	if (success &&
+		!reqSketchVectors.Diff(forwarderVectors))
+	{
+		std::string	forwarderVecMacros;
+		IndexVecIterator indVedItr(&reqSketchVectors);
+		for (size_t index = indVedItr.Current();
+				index != IndexVecIterator::end;
+						index = indVedItr.Next())
+		{
+			forwarderVecMacros += "\nFORWARD_ISR(" + std::to_string(index) + ")";
+		}
+		success = false;
+		PostError("Check", std::string(), "The following macros need to be added to the forwarder sketch: \n" +
+			forwarderVecMacros + "\n\nWithout these macros not all of the ISRs implemented in the "
+			"sub sketches will be forwarded.");
+	}
+	return(success);
+}
+
+/******************************* CreateModSpecs *******************************/
+/*
+*	Creates or updates the specs-xxxmod file of each device used, the same as
+*	specs-xxx except that -Tdata is offset by the Forwarder's data size.  These
+*	are used when a sketch can't be rebased and is relinked instead.
+*
+*	The files are written to the device-specs folder of mModSpecsFolder, within
+*	the work folder, rather than to the toolchain's device-specs folder.  The
+*	toolchain may be read only, and it's shared by other builds whose
+*	Forwarders may have a different data size.  gcc finds them because
+*	OffsetTextAndData passes mModSpecsFolder by -B.
+*/
+bool SketchSetBuilder::CreateModSpecs(void)
+{
+	BuildSpan	span("CreateModSpecs");
+	std::string	avrGCCPath;
+	mSketches[0].configFile.RawValueForKey("runtime.tools.avr-gcc.path", avrGCCPath);
+	// Only expecting one folder in avr but its name is the gcc version.
+	std::string	gccFolder(avrGCCPath + "/lib/gcc/avr");
+	DIR*	dir = opendir(gccFolder.c_str());
+	if (dir)
+	{
+		struct dirent*	entry;
+		while ((entry = readdir(dir)) != NULL)
+		{
+			if (entry->d_name[0] != '.')
+			{
+				mSpecsFolder.assign(gccFolder + "/" + entry->d_name + "/device-specs");
+				break;
+			}
+		}
+		closedir(dir);
+	}
+	bool	success = IsFolder(mSpecsFolder);
+	if (success)
+	{
+		success = FileStager::MakeFolders(mModSpecsFolder + "/device-specs");
+		if (!success)
+		{
+			PostError("Specs", std::string(), "Unable to create " + mModSpecsFolder + "/device-specs");
+		}
+	} else
+	{
+		PostError("Specs", std::string(), "Unable to locate the avr-gcc device-specs folder in " + avrGCCPath);
+	}
+	if (success)
+	{
+		std::vector<std::string>	deviceNames;
+		for (SSketch& sketch : mSketches)
+		{
+			std::string	deviceName;
+			sketch.configFile.RawValueForKey("build.mcu", deviceName);
+			if (std::find(deviceNames.begin(), deviceNames.end(), deviceName) != deviceNames.end())
+			{
+				continue;
+			}
+			deviceNames.push_back(deviceName);
+			std::string	specsText;
+			std::string	modSpecsText;
+			std::string	modSpecsPath(mModSpecsFolder + "/device-specs/specs-" + deviceName + "mod");
+			uint32_t	value = 0;
+			uint32_t	modValue = 0;
+			size_t		valueOffset;
+			if (ReadTextFile(mSpecsFolder + "/specs-" + deviceName, specsText) &&
+				(valueOffset = FindSpecsDataValue(specsText, value)) != std::string::npos)
+			{
+				value += mForwarderDataSize;	// Add the amount of SRAM used by the Forwarder
+				// If the modified specs file is missing or out of sync, create it.
+				if (!ReadTextFile(modSpecsPath, modSpecsText) ||
+					FindSpecsDataValue(modSpecsText, modValue) == std::string::npos ||
+					modValue != value)
+				{
+					char	valueStr[10];
+					snprintf(valueStr, sizeof(valueStr), "%X", value);
+					size_t	valueLen = strspn(&specsText[valueOffset], "0123456789abcdefABCDEF");
+					specsText.replace(valueOffset, valueLen, valueStr);
+					FILE*	file = fopen(modSpecsPath.c_str(), "w");
+					success = file != NULL;
+					if (success)
+					{
+						success = fwrite(specsText.c_str(), 1, specsText.size(), file) == specsText.size();
+						success = fclose(file) == 0 && success;
+					}
+					if (success)
+					{
+						PostInfo("Specs", std::string(), "Created " + modSpecsPath);
+					} else
+					{
+						PostError("Specs", std::string(), "Unable to create " + modSpecsPath);
+						break;
+					}
+				}
+			}
+		}
+	}
+	return(success);
+}
+
+/******************************** BuildSketch *********************************/
+/*
+*	Relinks (if not the Forwarder), patches, and writes the hex and eep files
+*	for a single sketch.  The Forwarder (inSketchIndex 0) must be built first
+*	because it fills in mForwarderAddresses used by all of the other sketches.
+*	Once the Forwarder is built, the other sketches may be built concurrently.
+*
+*	If the build cache has an entry for the sketch's inputs, the cached elf,
+*	hex, and eep files are used rather than relinking and patching.
+*/
+bool SketchSetBuilder::BuildSketch(
+	uint32_t	inSketchIndex)
+{
+	SSketch&	sketch = mSketches[inSketchIndex];
+	BuildSpan	span("BuildSketch", sketch.desc.name.c_str());
+	std::string	elfPath(ElfPath(sketch));
+	BuildCacheKey	cacheKey;
+	bool	success = FinalizeConfig(sketch);
+	bool	hasCacheKey = success && mBuildCache.IsEnabled() &&
+		GetCacheKey(sketch, inSketchIndex, cacheKey);
+	bool	isCached = hasCacheKey &&
+		mBuildCache.Fetch(cacheKey, sketch.workFolder, sketch.desc.name, kBuildCacheExtensions);
+	if (success && inSketchIndex && !isCached)
+	{
+		// Create a new elf file with offset .text and .data
+		success = RebaseSketch(sketch);
+	}
+	if (success)
+	{
+		success = sketch.elfFile.ReadFile(elfPath.c_str(), true);
+		if (success && isCached)
+		{
+			/*
+			*	The cached elf file has already been patched.  If this is the
+			*	Forwarder the addresses used to patch the other sketches are
+			*	still needed.
+			*/
+			if (inSketchIndex == 0)
+			{
+				SResolvedSymbols	resolved;
+				success = sketch.elfFile.ResolveSymbols(kForwarderSymbols, eNumForwarderSymbols, resolved);
+				if (success)
+				{
+					mForwarderAddresses.currSketchAddress = resolved.symbols[eCurrSketchAddress].symTblEntry->value;
+					mForwarderAddresses.restartAddress = resolved.symbols[eRestart].symTblEntry->value;
+					for (uint32_t i = 0; i < eNumSharedSymbols; i++)
+					{
+						mForwarderAddresses.sharedAddresses[i] = resolved.symbols[eNumRequiredForwarderSymbols + i].symTblEntry->value;
+					}
+				}
+			}
+			if (success)
+			{
+				PostInfo("Build", sketch.desc.name, "Using the cached build for: " + sketch.desc.name + ".");
+			}
+		} else if (success)
+		{
+			BuildSpan	patchSpan("PatchElf", sketch.desc.name.c_str());
+			success = PatchSketch(sketch, inSketchIndex) &&
+				sketch.elfFile.WriteFile(elfPath.c_str());
+		}
+		if (!success)
+		{
+			PostError("Build", sketch.desc.name, "Elf file not created: " + elfPath + ".");
+		}
+	}
+#ifdef AVR_OBJ_DUMP
+	if (success && !isCached)
+	{
+		success = RunRecipe("recipe.elfdump.pattern", sketch.configFile);
+	}
+#endif
+	if (success && !isCached)
+	{
+		/*
+		*	Write the hex and eep files directly from the patched elf file
+		*	rather than running the objcopy recipes.
+		*/
+		BuildSpan	writeSpan("WriteHexAndEep", sketch.desc.name.c_str());
+		std::string	pathBase(elfPath, 0, elfPath.size() - 4);	// Remove .elf
+		success = sketch.elfFile.WriteEepFile((pathBase + ".eep").c_str()) &&
+				sketch.elfFile.WriteHexFile((pathBase + ".hex").c_str());
+		if (success)
+		{
+			PostInfo("Build", sketch.desc.name, "hex and eep files created for: " + sketch.desc.name + ".");
+			if (hasCacheKey)
+			{
+				// A failure to store only means the next build won't be faster.
+				mBuildCache.Store(cacheKey, sketch.workFolder, sketch.desc.name, kBuildCacheExtensions);
+			}
+		} else
+		{
+			PostError("Build", sketch.desc.name, "hex and eep files not created for: " + sketch.desc.name + ".");
+		}
+	}
+	return(success);
+}
+
+/******************************** PatchSketch *********************************/
+/*
+*	The Forwarder gets the address of the Selector (the Forwarder's length) and
+*	its addresses are resolved for the other sketches.  The Selector gets the
+*	Forwarder's addresses and the sub sketch table.  Every sketch other than the
+*	Forwarder has its references to the shared variables redirected to the
+*	Forwarder's.
+*/
+bool SketchSetBuilder::PatchSketch(
+	SSketch&	ioSketch,
+	uint32_t	inSketchIndex)
+{
+	AVRElfFile&	elfFile = ioSketch.elfFile;
+	SResolvedSymbols	resolved;
+	uint16_t*	elfOffset;
+	bool	success = true;
+	if (inSketchIndex == 0)
+	{
+		success = elfFile.ResolveSymbols(kForwarderSymbols, eNumForwarderSymbols, resolved);
+		if (success)
+		{
+			elfOffset = (uint16_t*)resolved.symbols[eCurrSketchAddress].valuePtr;
+			mForwarderAddresses.currSketchAddress = resolved.symbols[eCurrSketchAddress].symTblEntry->value;
+			mForwarderAddresses.restartAddress = resolved.symbols[eRestart].symTblEntry->value;
+			for (uint32_t i = 0; i < eNumSharedSymbols; i++)
+			{
+				mForwarderAddresses.sharedAddresses[i] = resolved.symbols[eNumRequiredForwarderSymbols + i].symTblEntry->value;
+			}
+			success = elfOffset != NULL;
+			if (success)
+			{
+				// The currSketchAddress is fed to an ijmp instruction so it's a word address.
+				uint16_t	selectorAddress = (uint16_t)(ioSketch.length/2);
+				elfFile.Patch(elfOffset, &selectorAddress, sizeof(uint16_t));
+			}
+		} else
+		{
+			PostError("Patch", ioSketch.desc.name, "Forwarder symbols not found: " + resolved.missing);
+		}
+	} else
+	{
+		if (inSketchIndex == 1)
+		{
+			success = elfFile.ResolveSymbols(kSelectorSymbols, eNumSelectorSymbols, resolved);
+			if (success)
+			{
+				elfOffset = (uint16_t*)resolved.symbols[eForwarderCurrSketchAddr].valuePtr;
+				success = elfOffset != NULL;
+				if (success)
+				{
+					uint16_t	currSketchAddress = (uint16_t)mForwarderAddresses.currSketchAddress;
+					elfFile.Patch(elfOffset, &currSketchAddress, sizeof(uint16_t));
+				}
+				elfOffset = (uint16_t*)resolved.symbols[eSubSketchAddress].valuePtr;
+				if (elfOffset &&
+					mSubSketchOffsets.size() > 2 &&
+					resolved.symbols[eSubSketchAddress].symTblEntry->size >= ((mSubSketchOffsets.size()-2)*2))
+				{
+					elfFile.Patch(elfOffset, &mSubSketchOffsets[2], (uint32_t)(mSubSketchOffsets.size()-2)*2);
+				} else
+				{
+					PostError("Patch", ioSketch.desc.name, "There are no sub sketches.");
+					success = false;
+				}
+				elfOffset = (uint16_t*)resolved.symbols[eForwarderRestartPlaceholder].valuePtr;
+				if (elfOffset)
+				{
+					uint32_t	jmpRestart = AVRElfFile::JmpInstructionFor(mForwarderAddresses.restartAddress);
+					elfFile.Patch(elfOffset, &jmpRestart, sizeof(uint32_t));
+				} else
+				{
+					success = false;
+				}
+			} else
+			{
+				PostError("Patch", ioSketch.desc.name, "Selector symbols not found: " + resolved.missing);
+			}
+		}
+		if (success)
+		{
+			// No error checking.  A shared variable may not be used.
+			SAddressReplacement	sharedReplacements[eNumSharedSymbols];
+			for (uint32_t i = 0; i < eNumSharedSymbols; i++)
+			{
+				sharedReplacements[i].symbolName = kForwarderSymbols[eNumRequiredForwarderSymbols + i];
+				sharedReplacements[i].newAddress = (uint16_t)mForwarderAddresses.sharedAddresses[i];
+			}
+			elfFile.ReplaceAddresses(sharedReplacements, eNumSharedSymbols);
+		}
+	}
+	return(success);
+}
+
+/******************************** RebaseSketch ********************************/
+/*
+*	Links the sketch once at its usual addresses keeping the relocations, then
+*	moves it to its place in flash and past the Forwarder's SRAM.  The linked
+*	elf file is cached under a key that doesn't include the addresses.  If the
+*	elf file can't be rebased (e.g. the linker relaxed or added stubs) it's
+*	relinked by OffsetTextAndData.
+*/
+bool SketchSetBuilder::RebaseSketch(
+	SSketch&	ioSketch)
+{
+	std::string	elfPath(ElfPath(ioSketch));
+	BuildCacheKey	relocatableKey;
+	relocatableKey.Add(kBuildCacheVersion);
+	relocatableKey.Add(kRelocatableRole);
+	bool	hasKey = mBuildCache.IsEnabled() &&
+		relocatableKey.AddFile((ioSketch.desc.buildFolder + "/" + ioSketch.desc.name + ".elf").c_str()) &&
+		AddLinkInputs(ioSketch.configFile, relocatableKey);
+	bool	success = hasKey &&
+		mBuildCache.Fetch(relocatableKey, ioSketch.workFolder, ioSketch.desc.name, kRelocatableExtensions);
+	if (!success)
+	{
+		std::string	compilerCElfFlags;
+		ioSketch.configFile.RawValueForKey("compiler.c.elf.flags", compilerCElfFlags);
+		ioSketch.configFile.InsertKeyValue("compiler.c.elf.flags", compilerCElfFlags + " -Wl,--emit-relocs");
+		success = RunRecipe("recipe.c.combine.pattern", ioSketch.configFile);
+		// Restore the flags, OffsetTextAndData adds its own if the rebase fails.
+		ioSketch.configFile.InsertKeyValue("compiler.c.elf.flags", compilerCElfFlags);
+		if (success && hasKey)
+		{
+			mBuildCache.Store(relocatableKey, ioSketch.workFolder, ioSketch.desc.name, kRelocatableExtensions);
+		}
+	}
+	if (success)
+	{
+		AVRElfFile	elfFile;
+		success = elfFile.ReadFile(elfPath.c_str(), true);
+		if (success)
+		{
+			uint32_t	dataStart = elfFile.GetSectEntry(eData)->addrInMem + mForwarderDataSize;
+			success = elfFile.Rebase(ioSketch.start, dataStart) &&
+				elfFile.WriteFile(elfPath.c_str());
+		}
+		if (success)
+		{
+			PostInfo("Rebase", ioSketch.desc.name, "Elf file rebased for: " + ioSketch.desc.name + ".");
+		}
+	}
+	if (!success)
+	{
+		success = OffsetTextAndData(ioSketch);
+	}
+	return(success);
+}
+
+/***************************** OffsetTextAndData ******************************/
+/*
+*	Relinks the sketch with .text at its start and .data past the Forwarder's
+*	SRAM using the specs-xxxmod file.  -B adds mModSpecsFolder to the folders
+*	gcc searches for device-specs/specs-{build.mcu}, see CreateModSpecs.
+*/
+bool SketchSetBuilder::OffsetTextAndData(
+	SSketch&	ioSketch)
+{
+	std::string	deviceName;
+	std::string	compilerCElfFlags;
+	ioSketch.configFile.RawValueForKey("build.mcu", deviceName);
+	ioSketch.configFile.RawValueForKey("compiler.c.elf.flags", compilerCElfFlags);
+	char dotTextStart[64];
+	// --emit-relocs keeps the relocations used by ReplaceAddresses.
+	snprintf(dotTextStart, sizeof(dotTextStart), " -Wl,--emit-relocs -Wl,--section-start=.text=0x%X", ioSketch.start);
+	compilerCElfFlags.append(dotTextStart);
+	compilerCElfFlags.append(" \"-B" + mModSpecsFolder + "/\"");
+	ioSketch.configFile.InsertKeyValue("compiler.c.elf.flags", compilerCElfFlags);
+	// The name of the mcu determines which specs-{build.mcu} is used.
+	ioSketch.configFile.InsertKeyValue("build.mcu", deviceName + "mod");
+	bool	success = RunRecipe("recipe.c.combine.pattern", ioSketch.configFile);
+	// Restore the device name, it's also used by the build cache key.
+	ioSketch.configFile.InsertKeyValue("build.mcu", deviceName);
+	if (success)
+	{
+		PostInfo("Link", ioSketch.desc.name, "Elf file created for: " + ioSketch.desc.name + ".");
+	}
+	return(success);
+}
+
+/******************************** GetCacheKey *********************************/
+/*
+*	Hashes everything the patched elf, hex, and eep files of a sketch are
+*	derived from: the elf built by Arduino, the object files and core archive
+*	it's relinked from, the link settings including the .text start and the
+*	specs-xxxmod file (which contains the Forwarder's data size), and the
+*	values patched into the sketch.  The sketch's name and the work folder
+*	aren't part of the key so that an entry can be reused by other sketch sets
+*	containing the same sketch at the same offset.
+*	Returns false if any of the files can't be read.
+*/
+bool SketchSetBuilder::GetCacheKey(
+	SSketch&		inSketch,
+	uint32_t		inSketchIndex,
+	BuildCacheKey&	outKey)
+{
+	outKey.Add(kBuildCacheVersion);
+	// The Forwarder, the Selector, and the sub sketches are patched differently.
+	outKey.Add(inSketchIndex < 2 ? inSketchIndex : 2);
+	bool	success = outKey.AddFile((inSketch.desc.buildFolder + "/" + inSketch.desc.name + ".elf").c_str());
+	if (success && inSketchIndex == 0)
+	{
+		outKey.Add(inSketch.length);
+	} else if (success)
+	{
+		std::string	deviceName;
+		inSketch.configFile.RawValueForKey("build.mcu", deviceName);
+		outKey.Add(inSketch.start);
+		success = outKey.AddFile((mModSpecsFolder + "/device-specs/specs-" + deviceName + "mod").c_str()) &&
+			AddLinkInputs(inSketch.configFile, outKey);
+		outKey.Add(mForwarderAddresses.sharedAddresses, sizeof(mForwarderAddresses.sharedAddresses));
+		if (inSketchIndex == 1)
+		{
+			outKey.Add(mForwarderAddresses.currSketchAddress);
+			outKey.Add(mForwarderAddresses.restartAddress);
+			outKey.Add(mSubSketchOffsets.data(), mSubSketchOffsets.size() * sizeof(uint16_t));
+		}
+	}
+	return(success);
+}
+
+/******************************* AddLinkInputs ********************************/
+/*
+*	Adds everything that determines the output of recipe.c.combine.pattern
+*	other than the .text and .data starting addresses.
+*/
+bool SketchSetBuilder::AddLinkInputs(
+	BoardsConfigFile&	inConfigFile,
+	BuildCacheKey&		ioKey)
+{
+	std::string	value;
+	uint32_t	keysNotFound = 0;
+	const char*	linkKeys[] = {"recipe.c.combine.pattern", "compiler.c.elf.flags",
+							"compiler.c.elf.extra_flags", "compiler.ldflags", "build.mcu"};
+	for (uint32_t i = 0; i < sizeof(linkKeys)/sizeof(const char*); i++)
+	{
+		value.clear();
+		inConfigFile.RawValueForKey(linkKeys[i], value);
+		ioKey.Add(value);
+	}
+	// The resolved compiler path contains the toolchain version.
+	value.clear();
+	inConfigFile.ValueForKey("compiler.path", value, keysNotFound);
+	ioKey.Add(value);
+	std::string	buildPath;
+	inConfigFile.RawValueForKey("build.path", buildPath);
+	value.clear();
+	inConfigFile.RawValueForKey("archive_file", value);
+	bool	success = ioKey.AddFile((buildPath + "/" + value).c_str());
+	value.clear();
+	inConfigFile.RawValueForKey("object_files", value);
+	for (size_t pathStart = 0; success && pathStart < value.size(); )
+	{
+		size_t	pathEnd = value.find(' ', pathStart);
+		if (pathEnd == std::string::npos)
+		{
+			pathEnd = value.size();
+		}
+		if (pathEnd > pathStart)
+		{
+			success = ioKey.AddFile(value.substr(pathStart, pathEnd - pathStart).c_str());
+		}
+		pathStart = pathEnd + 1;
+	}
+	return(success);
+}
+
+/********************************* RunRecipe **********************************/
+/*
+*	Runs the tool named by the expanded inRecipeKey.  The tool's output is
+*	posted to the log as it arrives.
+*	Returns true if the tool's exit status is 0.
+*/
+bool SketchSetBuilder::RunRecipe(
+	const char*			inRecipeKey,
+	BoardsConfigFile&	inConfigFile)
+{
+	bool		success = false;
+	std::string value;
+	uint32_t keysNotFound = 0;
+	BuildSpan	span("RunRecipe", inRecipeKey);
+	std::string	sketchName;
+	inConfigFile.RawValueForKey("build.project_name", sketchName);
+	inConfigFile.ValueForKey(inRecipeKey, value, keysNotFound);
+	RecipeRunner	recipeRunner;
+	recipeRunner.SetTimeout(kRecipeTimeout);
+	recipeRunner.SetOutputHandler([this, inRecipeKey, &sketchName](const std::string& inLines, bool inIsError)
+	{
+		if (inIsError)
+		{
+			PostError(inRecipeKey, sketchName, inLines);
+		} else
+		{
+			PostInfo(inRecipeKey, sketchName, inLines);
+		}
+	});
+	if (recipeRunner.Start(value))
+	{
+		recipeRunner.Wait();
+		success = recipeRunner.GetExitStatus() == 0;
+		if (recipeRunner.TimedOut())
+		{
+			PostError(inRecipeKey, sketchName, std::string(inRecipeKey) + " timed out after " +
+				std::to_string(kRecipeTimeout) + " seconds.");
+		}
+	} else
+	{
+		PostError(inRecipeKey, sketchName, std::string("Unable to run ") + inRecipeKey + ": " + recipeRunner.GetStartError());
+	}
+	return(success);
+}
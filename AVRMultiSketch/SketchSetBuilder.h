@@ -0,0 +1,225 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  SketchSetBuilder.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef SketchSetBuilder_h
+#define SketchSetBuilder_h
+
+#include "AVRElfFile.h"
+#include "BoardSnapshots.h"
+#include "BuildCache.h"
+#include "ConfigurationFile.h"
+#include "HardwareIndex.h"
+#include "LogSink.h"
+#include <string>
+#include <vector>
+
+class FileStager;
+class WorkerPool;
+
+/*
+*	Symbols resolved in the Forwarder sketch.  Only the first
+*	eNumRequiredForwarderSymbols are needed to identify it as a Forwarder.
+*	The symbols that follow are variables shared by all of the sketches.  Every
+*	reference to one of these in a sub sketch is redirected to the Forwarder's
+*	copy.  To share another variable, add it here and to EForwarderSymbol.
+*/
+static const char* const kForwarderSymbols[] = {
+	"_ZL17currSketchAddress",
+	"restart",
+	"timer0_millis",
+	"timer0_fract",
+	"timer0_overflow_count"
+};
+enum EForwarderSymbol
+{
+	eCurrSketchAddress,
+	eRestart,
+	eNumRequiredForwarderSymbols,
+	eTimer0Millis = eNumRequiredForwarderSymbols,
+	eTimer0Fract,
+	eTimer0OverflowCount,
+	eNumForwarderSymbols,
+	eNumSharedSymbols = eNumForwarderSymbols - eNumRequiredForwarderSymbols
+};
+
+// was _ZL23forwarderCurrSketchAddr pre Catalina, Arduino 1.8.10
+// was _ZL16subSketchAddress
+static const char* const kSelectorSymbols[] = {
+	"forwarderCurrSketchAddr",
+	"forwarderRestartPlaceholder",
+	"subSketchAddress"
+};
+enum ESelectorSymbol
+{
+	eForwarderCurrSketchAddr,
+	eForwarderRestartPlaceholder,
+	eSubSketchAddress,
+	eNumSelectorSymbols
+};
+
+// Addresses resolved in the Forwarder sketch used to patch the other sketches
+struct SForwarderAddresses
+{
+	uint32_t	currSketchAddress;
+	uint32_t	restartAddress;
+	uint32_t	sharedAddresses[eNumSharedSymbols];	// See kForwarderSymbols
+};
+
+typedef std::vector<uint16_t> Uint16Vec;
+
+/*
+*	A sketch of a sketch set.  The first sketch of a set is the Forwarder, the
+*	second is the Selector, and the rest are the sub sketches in the order
+*	they're placed in flash.
+*/
+struct SSketchDesc
+{
+	std::string	name;			// e.g. Blink.ino
+	std::string	buildFolder;	// The Arduino build folder containing name.elf
+};
+typedef std::vector<SSketchDesc> SketchDescs;
+
+/*
+*	SketchSetBuilder creates the combined hex and eep files of a sketch set.
+*	It's the whole pipeline behind both the application's Verify command and
+*	the command line tool, so the two produce the same files and cache keys.
+*
+*	The board configurations, worker pool, build cache, hardware index, and
+*	board snapshots are passed in so they can be shared by all of the sets
+*	built.  A board's boards.txt and platform.txt are only read the first time
+*	a set uses the board, and then only if there's no current snapshot of
+*	them.  Messages are pushed to the log sink from whichever thread builds
+*	the sketch, to be drained by the caller.
+*
+*	Only the Arduino build folders are needed, a running Arduino IDE isn't.
+*	Each sketch's build folder is staged to a folder of inWorkFolder named by
+*	the sketch, and the combined files are written to inHexPath and inEepPath.
+*/
+class SketchSetBuilder
+{
+public:
+							SketchSetBuilder(
+								BoardsConfigFiles&		ioConfigFiles,
+								WorkerPool&				ioWorkerPool,
+								const BuildCache&		inBuildCache,
+								HardwareIndex&			ioHardwareIndex,
+								const BoardSnapshots&	inBoardSnapshots,
+								LogSink&				ioLogSink);
+	virtual					~SketchSetBuilder(void);
+	/*
+	*	If inFQBN isn't empty, every sketch must have been built for it.  An
+	*	arduino_cache_ folder may be passed as inCoreCacheFolder, in which case
+	*	its core archives are used when a build folder doesn't have core.a.
+	*/
+	bool					Build(
+								const SketchDescs&		inSketches,
+								const std::string&		inFQBN,
+								const std::string&		inCoreCacheFolder,
+								const std::string&		inWorkFolder,
+								const std::string&		inHexPath,
+								const std::string&		inEepPath);
+	uint32_t				GetFlashUsed(void) const
+								{return(mFlashUsed);}
+	/*
+	*	Where each sketch of the last set built was placed in flash and the
+	*	board it was built for.  A sketch not reached before Build failed has
+	*	a start and length of 0 and an empty FQBN and device name.
+	*/
+	uint32_t				GetNumSketches(void) const
+								{return((uint32_t)mSketches.size());}
+	void					GetSketchInfo(
+								uint32_t				inSketchIndex,
+								uint32_t&				outStart,
+								uint32_t&				outLength,
+								std::string&			outFQBN,
+								std::string&			outDeviceName);
+protected:
+	struct SSketch
+	{
+		SSketchDesc			desc;
+		std::string			workFolder;	// The staged copy of desc.buildFolder
+		uint32_t			start;
+		uint32_t			length;
+		BoardsConfigFile	configFile;	// This sketch's overlay of its FQBN's
+		AVRElfFile			elfFile;
+	};
+	BoardsConfigFiles&	mConfigFiles;
+	WorkerPool&			mWorkerPool;
+	const BuildCache&	mBuildCache;
+	HardwareIndex&		mHardwareIndex;
+	const BoardSnapshots&	mBoardSnapshots;
+	LogSink&			mLogSink;
+	std::vector<SSketch>	mSketches;
+	std::string			mWorkFolder;
+	std::string			mSpecsFolder;	// gcc's device-specs folder
+	std::string			mModSpecsFolder;	// Passed to gcc by -B, see CreateModSpecs
+	SForwarderAddresses	mForwarderAddresses;
+	Uint16Vec			mSubSketchOffsets;
+	uint32_t			mForwarderDataSize;
+	uint32_t			mFlashUsed;
+
+	void					PostInfo(
+								const char*				inStage,
+								const std::string&		inSketch,
+								const std::string&		inMessage);
+	void					PostError(
+								const char*				inStage,
+								const std::string&		inSketch,
+								const std::string&		inMessage);
+	bool					StageSketch(
+								SSketch&				ioSketch,
+								FileStager&				ioFileStager);
+	BoardsConfigFile*		InitializeFQBNConfig(
+								const SSketch&			inSketch);
+	bool					FinalizeConfig(
+								SSketch&				ioSketch);
+	bool					CheckSketches(void);
+	bool					CreateModSpecs(void);
+	bool					BuildSketch(
+								uint32_t				inSketchIndex);
+	bool					RebaseSketch(
+								SSketch&				ioSketch);
+	bool					OffsetTextAndData(
+								SSketch&				ioSketch);
+	bool					GetCacheKey(
+								SSketch&				inSketch,
+								uint32_t				inSketchIndex,
+								BuildCacheKey&			outKey);
+	bool					AddLinkInputs(
+								BoardsConfigFile&		inConfigFile,
+								BuildCacheKey&			ioKey);
+	bool					PatchSketch(
+								SSketch&				ioSketch,
+								uint32_t				inSketchIndex);
+	bool					RunRecipe(
+								const char*				inRecipeKey,
+								BoardsConfigFile&		inConfigFile);
+	std::string				ElfPath(
+								const SSketch&			inSketch) const
+								{return(inSketch.workFolder + "/" + inSketch.desc.name + ".elf");}
+};
+
+#endif /* SketchSetBuilder_h */
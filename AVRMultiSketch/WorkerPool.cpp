@@ -0,0 +1,115 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  WorkerPool.cpp
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#include "WorkerPool.h"
+
+/********************************* WorkerPool *********************************/
+WorkerPool::WorkerPool(
+	uint32_t	inNumThreads)
+	: mNumRunning(0), mStopping(false)
+{
+	if (inNumThreads == 0)
+	{
+		inNumThreads = std::thread::hardware_concurrency();
+		if (inNumThreads == 0)
+		{
+			inNumThreads = 1;
+		}
+	}
+	for (uint32_t i = 0; i < inNumThreads; i++)
+	{
+		mThreads.push_back(std::thread(&WorkerPool::Run, this));
+	}
+}
+
+/******************************** ~WorkerPool *********************************/
+/*
+*	Any tasks not yet started are run before the threads exit.
+*/
+WorkerPool::~WorkerPool(void)
+{
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		mStopping = true;
+	}
+	mTaskAdded.notify_all();
+	for (std::thread& thread : mThreads)
+	{
+		thread.join();
+	}
+}
+
+/************************************ Add *************************************/
+void WorkerPool::Add(
+	const WorkerTask&	inTask)
+{
+	{
+		std::lock_guard<std::mutex>	lock(mMutex);
+		mTasks.push_back(inTask);
+	}
+	mTaskAdded.notify_one();
+}
+
+/************************************ Wait ************************************/
+void WorkerPool::Wait(void)
+{
+	std::unique_lock<std::mutex>	lock(mMutex);
+	mTasksDone.wait(lock, [this]{return(mTasks.empty() && mNumRunning == 0);});
+}
+
+/********************************** WaitFor ***********************************/
+bool WorkerPool::WaitFor(
+	uint32_t	inMilliseconds)
+{
+	std::unique_lock<std::mutex>	lock(mMutex);
+	return(mTasksDone.wait_for(lock, std::chrono::milliseconds(inMilliseconds),
+		[this]{return(mTasks.empty() && mNumRunning == 0);}));
+}
+
+/************************************ Run *************************************/
+void WorkerPool::Run(void)
+{
+	std::unique_lock<std::mutex>	lock(mMutex);
+	while (true)
+	{
+		mTaskAdded.wait(lock, [this]{return(mStopping || !mTasks.empty());});
+		if (mTasks.empty())
+		{
+			break;	// Stopping
+		}
+		WorkerTask	task(mTasks.front());
+		mTasks.pop_front();
+		mNumRunning++;
+		lock.unlock();
+		task();
+		lock.lock();
+		mNumRunning--;
+		if (mTasks.empty() && mNumRunning == 0)
+		{
+			mTasksDone.notify_all();
+		}
+	}
+}
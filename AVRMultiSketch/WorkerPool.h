@@ -0,0 +1,75 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  WorkerPool.h
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+
+#ifndef WorkerPool_h
+#define WorkerPool_h
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void(void)> WorkerTask;
+
+/*
+*	A fixed set of threads that run the tasks added in the order added.  The
+*	threads are started by the constructor and joined by the destructor.
+*
+*	Tasks added before a call to Wait are all complete when Wait returns, so a
+*	dependency between tasks is expressed by adding the dependent tasks after
+*	the Wait.
+*/
+class WorkerPool
+{
+public:
+							// 0 = one thread per hardware thread
+							WorkerPool(
+								uint32_t				inNumThreads = 0);
+	virtual					~WorkerPool(void);
+	void					Add(
+								const WorkerTask&		inTask);
+	void					Wait(void);
+							// Returns true if all of the tasks added are
+							// complete within inMilliseconds.
+	bool					WaitFor(
+								uint32_t				inMilliseconds);
+	uint32_t				GetNumThreads(void) const
+								{return((uint32_t)mThreads.size());}
+protected:
+	std::vector<std::thread>	mThreads;
+	std::deque<WorkerTask>		mTasks;
+	std::mutex					mMutex;
+	std::condition_variable		mTaskAdded;
+	std::condition_variable		mTasksDone;
+	uint32_t					mNumRunning;	// Tasks being run
+	bool						mStopping;
+
+	void					Run(void);
+};
+
+#endif /* WorkerPool_h */
@@ -0,0 +1,237 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  BoardsTxtBench.cpp
+//  AVRMultiSketchCLI
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+/*
+*	Times reading the key values of one FQBN from a boards.txt the size of
+*	MightyCore's, by the streaming loader BoardsConfigFile::ReadFile uses when
+*	filtering and by the line by line read that filtered in InsertKeyValue,
+*	checking that both keep the same key values.
+*
+*	Usage: BoardsTxtBench [boards.txt FQBN]
+*	With no arguments a boards.txt laid out like MightyCore's, 14 boards each
+*	with variant, pinout, BOD, LTO, clock and bootloader menus, is written to
+*	the temporary folder and read for an ATmega1284.
+*/
+
+#include "ConfigurationFile.h"
+#include "JSONElement.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+static const uint32_t	kRepeats = 2000;
+static const char* const	kFQBN =
+	"MightyCore:avr:1284:variant=modelP,pinout=standard,clock=16MHz_external,"
+	"BOD=2v7,LTO=Os,bootloader=uart0";
+
+struct SClock
+{
+	const char*	option;
+	const char*	name;
+	const char*	frequency;
+};
+
+static const SClock	kClocks[] =
+{
+	{"16MHz_external", "16 MHz", "16000000L"},
+	{"20MHz_external", "20 MHz", "20000000L"},
+	{"18_432MHz_external", "18.432 MHz", "18432000L"},
+	{"12MHz_external", "12 MHz", "12000000L"},
+	{"8MHz_external", "8 MHz", "8000000L"},
+	{"8MHz_internal", "8 MHz", "8000000L"},
+	{"1MHz_internal", "1 MHz", "1000000L"},
+	{"24MHz_external", "24 MHz", "24000000L"},
+	{"22_1184MHz_external", "22.1184 MHz", "22118400L"},
+	{"14_7456MHz_external", "14.7456 MHz", "14745600L"},
+	{"11_0592MHz_external", "11.0592 MHz", "11059200L"},
+	{"7_3728MHz_external", "7.3728 MHz", "7372800L"},
+	{"4MHz_external", "4 MHz", "4000000L"},
+	{"3_6864MHz_external", "3.6864 MHz", "3686400L"},
+	{"2MHz_external", "2 MHz", "2000000L"},
+	{"1_8432MHz_external", "1.8432 MHz", "1843200L"},
+	{"25MHz_external", "25 MHz", "25000000L"},
+	{"32MHz_external", "32 MHz", "32000000L"},
+	{"9_216MHz_external", "9.216 MHz", "9216000L"},
+	{"10MHz_external", "10 MHz", "10000000L"}
+};
+
+/**************************** WriteSyntheticBoards ****************************/
+/*
+*	Writes a boards.txt for 7 of MightyCore's devices and a copy of each under
+*	an X prefixed ID, about 2600 lines, the size of MightyCore's boards.txt.
+*/
+static bool WriteSyntheticBoards(
+	const char*	inPath)
+{
+	static const char* const	kDevices[] = {"1284", "644", "324", "164", "32", "16", "8535"};
+	static const char* const	kPinouts[] = {"standard", "bobuino", "sanguino"};
+	static const char* const	kBODs[][2] = {{"2v7", "0xfd"}, {"4v3", "0xfc"}, {"1v8", "0xfe"}, {"disabled", "0xff"}};
+	static const char* const	kBootloaders[] = {"uart0", "uart1", "no_bootloader"};
+	FILE*	file = fopen(inPath, "w");
+	bool	success = file != NULL;
+	if (success)
+	{
+		fprintf(file, "# MightyCore-like synthetic boards.txt\nmenu.clock=Clock\nmenu.BOD=BOD\n"
+			"menu.LTO=Compiler LTO\nmenu.variant=Variant\nmenu.pinout=Pinout\nmenu.bootloader=Bootloader\n");
+		for (uint32_t copy = 0; copy < 2; copy++)
+		{
+			for (const char* device : kDevices)
+			{
+				std::string	id(copy ? "X" : "");
+				id.append(device);
+				const char*	i = id.c_str();
+				fprintf(file, "\n##############################################################\n\n");
+				fprintf(file, "%s.name=ATmega%s\n%s.upload.tool=avrdude\n%s.upload.protocol=arduino\n"
+					"%s.upload.maximum_size=130048\n%s.upload.maximum_data_size=16384\n"
+					"%s.bootloader.tool=avrdude\n%s.bootloader.unlock_bits=0x3f\n%s.bootloader.lock_bits=0x0f\n"
+					"%s.build.core=MCUdude_corefiles\n%s.build.board=AVR_ATmega%s\n%s.build.variant=standard\n\n",
+					i, device, i, i, i, i, i, i, i, i, i, device, i);
+				static const char* const	kVariants[][2] = {{"modelP", "p"}, {"modelA", "a"}, {"modelNonP", ""}, {"model", ""}};
+				for (const char* const* variant : kVariants)
+				{
+					fprintf(file, "%s.menu.variant.%s=ATmega%s%s\n%s.menu.variant.%s.build.mcu=atmega%s%s\n"
+						"%s.menu.variant.%s.bootloader.extended_fuses=0xfd\n",
+						i, variant[0], device, variant[1], i, variant[0], device, variant[1], i, variant[0]);
+				}
+				for (const char* pinout : kPinouts)
+				{
+					fprintf(file, "%s.menu.pinout.%s=%s pinout\n%s.menu.pinout.%s.build.variant=%s\n",
+						i, pinout, pinout, i, pinout, pinout);
+				}
+				for (const char* const* bod : kBODs)
+				{
+					fprintf(file, "%s.menu.BOD.%s=BOD %s\n%s.menu.BOD.%s.bootloader.extended_fuses=%s\n"
+						"%s.menu.BOD.%s.build.bod=%s\n", i, bod[0], bod[0], i, bod[0], bod[1], i, bod[0], bod[0]);
+				}
+				static const char* const	kLTOs[][2] = {{"Os", "-Os"}, {"Os_flto", "-Os -flto"}};
+				for (const char* const* lto : kLTOs)
+				{
+					fprintf(file, "%s.menu.LTO.%s=%s\n%s.menu.LTO.%s.compiler.c.extra_flags=%s\n"
+						"%s.menu.LTO.%s.compiler.c.elf.extra_flags=%s\n%s.menu.LTO.%s.compiler.cpp.extra_flags=%s\n"
+						"%s.menu.LTO.%s.ltoarcmd=avr-gcc-ar\n",
+						i, lto[0], lto[0], i, lto[0], lto[1], i, lto[0], lto[1], i, lto[0], lto[1], i, lto[0]);
+				}
+				for (const SClock& clock : kClocks)
+				{
+					const char*	o = clock.option;
+					fprintf(file, "%s.menu.clock.%s=%s\n%s.menu.clock.%s.upload.speed=115200\n"
+						"%s.menu.clock.%s.bootloader.low_fuses=0xf7\n%s.menu.clock.%s.bootloader.high_fuses=0xd6\n"
+						"%s.menu.clock.%s.build.f_cpu=%s\n"
+						"%s.menu.clock.%s.bootloader.file=optiboot_flash/bootloaders/atmega%s/%s/optiboot_flash_atmega%s_UART0_115200_%s.hex\n",
+						i, o, clock.name, i, o, i, o, i, o, i, o, clock.frequency,
+						i, o, device, clock.frequency, device, clock.frequency);
+				}
+				for (const char* bootloader : kBootloaders)
+				{
+					fprintf(file, "%s.menu.bootloader.%s=%s\n%s.menu.bootloader.%s.upload.maximum_size=130048\n"
+						"%s.menu.bootloader.%s.build.export_merged_output=true\n"
+						"%s.menu.bootloader.%s.bootloader.high_fuses=0xd6\n",
+						i, bootloader, bootloader, i, bootloader, i, bootloader, i, bootloader);
+				}
+			}
+		}
+		success = fclose(file) == 0;
+	}
+	return(success);
+}
+
+/*********************************** Report ***********************************/
+/*
+*	Prints the average time to read inPath for inFQBN by each loader, and
+*	whether the key values they kept differ.
+*/
+static void Report(
+	const char*	inPath,
+	const char*	inFQBN)
+{
+	BoardsConfigFile	streamed(inFQBN);
+	BoardsConfigFile	lineByLine(inFQBN);
+	lineByLine.DoKeyFiltering(true);
+	if (streamed.ReadFile(inPath, true) &&
+		lineByLine.ConfigurationFile::ReadFile(inPath))
+	{
+		std::string	streamedJSON, lineByLineJSON;
+		streamed.GetRootObject()->Write(0, streamedJSON);
+		lineByLine.GetRootObject()->Write(0, lineByLineJSON);
+		double	readTime[2];
+		uint32_t	numKeyValues = 0;
+		for (uint32_t streaming = 0; streaming < 2; streaming++)
+		{
+			std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+			for (uint32_t repeat = 0; repeat < kRepeats; repeat++)
+			{
+				BoardsConfigFile	configFile(inFQBN);
+				if (streaming)
+				{
+					configFile.ReadFile(inPath, true);
+				} else
+				{
+					configFile.DoKeyFiltering(true);
+					configFile.ConfigurationFile::ReadFile(inPath);
+				}
+				numKeyValues = configFile.GetKeyValues().GetCount();
+			}
+			readTime[streaming] = std::chrono::duration<double, std::micro>(
+				std::chrono::steady_clock::now() - start).count() / kRepeats;
+		}
+		printf("line by line %7.1f us/read, streaming %7.1f us/read, %u key values kept%s\n",
+			readTime[0], readTime[1], numKeyValues,
+			streamedJSON != lineByLineJSON ? " MISMATCH" : "");
+	} else
+	{
+		printf("%s: not a readable boards.txt\n", inPath);
+	}
+}
+
+/************************************ main ************************************/
+int main(
+	int		inArgc,
+	char*	inArgv[])
+{
+	printf("boards.txt read for one FQBN:\n");
+	if (inArgc > 2)
+	{
+		Report(inArgv[1], inArgv[2]);
+	} else
+	{
+		const char*	tempFolder = getenv("TMPDIR");
+		std::string	path(tempFolder && *tempFolder ? tempFolder : "/tmp");
+		path.append("/BoardsTxtBench.XXXXXX");
+		int	fd = mkstemp(&path[0]);
+		if (fd >= 0)
+		{
+			close(fd);
+			if (WriteSyntheticBoards(path.c_str()))
+			{
+				Report(path.c_str(), kFQBN);
+			}
+			unlink(path.c_str());
+		}
+	}
+	return(0);
+}
@@ -0,0 +1,149 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  InstructionDecodeBench.cpp
+//  AVRMultiSketchCLI
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+/*
+*	Times the scalar decode of .text by AVRInstructionIterator, the walk that
+*	finds every two word instruction (LDS, STS, JMP and CALL) when an elf file
+*	has no relocations.  AVRElfFile::GetLongInstructions does it once per file.
+*
+*	Usage: InstructionDecodeBench [file.elf ...]
+*	With no arguments .text of 32 KB to 256 KB is generated from single word
+*	instructions with a two word instruction every 12 words on average.  Pass
+*	a sketch's elf file to time its .text.
+*/
+
+#include "AVRElfFile.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static const uint32_t	kRepeats = 200;
+static const uint32_t	kTextSizes[] = {32, 64, 128, 256};	// KB
+
+/*********************************** Report ***********************************/
+/*
+*	Prints the average time to decode [inStart, inEnd) and the number of two
+*	word instructions found.
+*/
+static void Report(
+	uint16_t*	inStart,
+	uint16_t*	inEnd,
+	const char*	inLabel)
+{
+	uint32_t	numLongInstructions = 0;
+	uint32_t	mismatches = 0;
+	std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+	for (uint32_t repeat = 0; repeat < kRepeats; repeat++)
+	{
+		uint32_t	found = 0;
+		AVRInstructionIterator	itr(inStart, inEnd);
+		while (itr.Next())
+		{
+			found++;
+		}
+		mismatches += repeat && found != numLongInstructions;
+		numLongInstructions = found;
+	}
+	double	decodeTime = std::chrono::duration<double, std::micro>(
+		std::chrono::steady_clock::now() - start).count() / kRepeats;
+	uint32_t	textSize = (uint32_t)((inEnd - inStart) * sizeof(uint16_t));
+	printf("%-20s %4u KB .text: %8.1f us/decode, %6.1f MB/s, %u two word instructions%s\n",
+		inLabel, textSize / 1024, decodeTime, textSize / decodeTime, numLongInstructions,
+		mismatches ? " MISMATCH" : "");
+}
+
+/******************************* GenerateText *********************************/
+/*
+*	Fills outText with random single word instructions, placing an LDS, STS,
+*	JMP or CALL with a random operand every 4 to 20 words.
+*/
+static void GenerateText(
+	uint32_t				inTextSize,
+	std::vector<uint16_t>&	outText)
+{
+	static const uint16_t	kLongOpcodes[] = {0x9100, 0x9300, 0x940C, 0x940E};
+	uint32_t	seed = 12345;
+	auto	random = [&seed](void)
+	{
+		seed = seed * 1103515245 + 12345;
+		return((uint16_t)(seed >> 16));
+	};
+	outText.resize(inTextSize / sizeof(uint16_t));
+	uint32_t	wordIndex = 0;
+	while (wordIndex < outText.size())
+	{
+		uint32_t	numShort = 4 + random() % 17;
+		for (; numShort && wordIndex < outText.size(); numShort--)
+		{
+			uint16_t	word;
+			do
+			{
+				word = random();
+			} while (AVRInstructionIterator::Decode(word) != AVRInstructionIterator::eOther);
+			outText[wordIndex++] = word;
+		}
+		if (wordIndex + 2 <= outText.size())
+		{
+			outText[wordIndex++] = kLongOpcodes[random() & 3] | (random() & 0x01F0);
+			outText[wordIndex++] = random();
+		}
+	}
+}
+
+/************************************ main ************************************/
+int main(
+	int		inArgc,
+	char*	inArgv[])
+{
+	printf("Instruction decode, the scalar walk of .text for two word instructions:\n");
+	if (inArgc > 1)
+	{
+		for (int argIndex = 1; argIndex < inArgc; argIndex++)
+		{
+			AVRElfFile	elfFile;
+			const char*	name = strrchr(inArgv[argIndex], '/');
+			if (elfFile.ReadFile(inArgv[argIndex], true) &&
+				elfFile.GetSectEntry(eText))
+			{
+				uint16_t*	textEnd = (uint16_t*)&elfFile.GetTextPtr()[elfFile.GetSectEntry(eText)->size & ~1];
+				Report(elfFile.GetCodeStart(), textEnd, name ? name + 1 : inArgv[argIndex]);
+			} else
+			{
+				printf("%s: not a readable elf file\n", inArgv[argIndex]);
+			}
+		}
+	} else
+	{
+		std::vector<uint16_t>	text;
+		for (uint32_t textSize : kTextSizes)
+		{
+			GenerateText(textSize * 1024, text);
+			Report(text.data(), &text.data()[text.size()], "synthetic");
+		}
+	}
+	return(0);
+}
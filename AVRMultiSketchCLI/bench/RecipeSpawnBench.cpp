@@ -0,0 +1,102 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  RecipeSpawnBench.cpp
+//  AVRMultiSketchCLI
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+/*
+*	Times running a recipe with RecipeRunner, which starts the tool directly,
+*	against running the same command line through bash -c as recipes were
+*	run before.  The tool is true, so the time measured is the cost of
+*	starting a recipe rather than the work the recipe does.  Its full path is
+*	used so that bash runs it rather than its builtin.  The command line is
+*	the length of a typical link recipe.
+*
+*	Usage: RecipeSpawnBench [runs]
+*/
+
+#include "RecipeRunner.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const char* const kRecipeArgs =
+	" -w -Os -g -flto -fuse-linker-plugin -Wl,--gc-sections -mmcu=atmega328pmod "
+	"-Wl,--emit-relocs -Wl,--section-start=.text=0x1A00 "
+	"-o \"/tmp/arduino_build_123456/Sub1.ino.elf\" "
+	"/tmp/arduino_build_123456/sketch/Sub1.ino.cpp.o "
+	"/tmp/arduino_build_123456/libraries/Wire/Wire.cpp.o "
+	"/tmp/arduino_build_123456/libraries/Wire/utility/twi.c.o "
+	"\"/tmp/arduino_build_123456/../arduino_cache_654321/core/core_arduino_avr_uno_0c812875ac70eb4a9b385d8fb077f54c.a\" "
+	"\"-L/tmp/arduino_build_123456\" -lm";
+
+/*********************************** TimeIt ***********************************/
+/*
+*	Returns the average time in milliseconds to run inArgs (or inRecipe when
+*	inArgs is empty) to completion.  outFailures is the number of runs that
+*	didn't start or didn't exit with 0.
+*/
+static double TimeIt(
+	const std::string&	inRecipe,
+	const StringVec&	inArgs,
+	uint32_t			inRuns,
+	uint32_t&			outFailures)
+{
+	outFailures = 0;
+	std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+	for (uint32_t run = 0; run < inRuns; run++)
+	{
+		RecipeRunner	recipeRunner;
+		bool	started = inArgs.empty() ? recipeRunner.Start(inRecipe) : recipeRunner.Start(inArgs);
+		if (started)
+		{
+			recipeRunner.Wait();
+		}
+		if (!started ||
+			recipeRunner.GetExitStatus() != 0)
+		{
+			outFailures++;
+		}
+	}
+	return(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / inRuns);
+}
+
+/************************************ main ************************************/
+int main(
+	int		inArgc,
+	char*	inArgv[])
+{
+	uint32_t	runs = inArgc > 1 ? (uint32_t)atoi(inArgv[1]) : 500;
+	const char*	shell = access("/bin/bash", X_OK) == 0 ? "/bin/bash" : "/bin/sh";
+	std::string	recipe(access("/bin/true", X_OK) == 0 ? "\"/bin/true\"" : "\"/usr/bin/true\"");
+	recipe.append(kRecipeArgs);
+	StringVec	shellArgs = {shell, "-c", recipe};
+	uint32_t	directFailures, shellFailures;
+	double	directTime = TimeIt(recipe, StringVec(), runs, directFailures);
+	double	shellTime = TimeIt(recipe, shellArgs, runs, shellFailures);
+	printf("Recipe spawn, a link sized command line run through true, %u runs:\n", runs);
+	printf("direct %.3f ms/recipe, %s -c %.3f ms/recipe%s\n", directTime, shell, shellTime,
+		directFailures || shellFailures ? " (some runs failed)" : "");
+	return(0);
+}
@@ -0,0 +1,260 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  SymbolLookupBench.cpp
+//  AVRMultiSketchCLI
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+/*
+*	Times looking up the Forwarder and Selector symbols by the hashed symbol
+*	index of ElfFile::FindSymbol and by a linear scan of the symbol table using
+*	strcmp, and the time taken to build the index on the first lookup.
+*
+*	Usage: SymbolLookupBench [file.elf ...]
+*	With no arguments, 32 bit elf files with symbol tables of the sizes below
+*	are written to the temporary folder, the symbols looked up at the end of
+*	the table.  Pass a sketch's elf file to time a real symbol table.
+*/
+
+#include "ElfFile.h"
+#include "SketchSetBuilder.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static const uint32_t	kRepeats = 500;
+static const uint32_t	kSymbolTableSizes[] = {500, 2000, 20000};
+
+/******************************** ScanForSymbol *******************************/
+/*
+*	The linear scan FindSymbol replaced, the reference for the comparison.
+*/
+static const SSymbolTblEntry* ScanForSymbol(
+	ElfFile&	inElfFile,
+	const char*	inSymbolName)
+{
+	uint32_t	numSymbols;
+	const SSymbolTblEntry*	symbolTblEntry = inElfFile.GetSymbolTable(numSymbols);
+	const SSymbolTblEntry*	endSymbolTblEntry = &symbolTblEntry[numSymbols];
+	for (; symbolTblEntry < endSymbolTblEntry; symbolTblEntry++)
+	{
+		if (strcmp(inSymbolName, inElfFile.GetSymbolName(symbolTblEntry)) == 0)
+		{
+			return(symbolTblEntry);
+		}
+	}
+	return(NULL);
+}
+
+/******************************* AppendSection ********************************/
+static void AppendSection(
+	std::vector<SSectEntry>&	ioSectTable,
+	std::string&				ioShStringTable,
+	const char*					inName,
+	uint32_t					inType,
+	uint32_t					inOffset,
+	uint32_t					inSize,
+	uint32_t					inEntrySize,
+	uint32_t					inLink)
+{
+	SSectEntry	sectEntry = {0};
+	sectEntry.nameOffset = (uint32_t)ioShStringTable.size();
+	sectEntry.type = inType;
+	sectEntry.offset = inOffset;
+	sectEntry.size = inSize;
+	sectEntry.entrySize = inEntrySize;
+	sectEntry.link = inLink;
+	ioSectTable.push_back(sectEntry);
+	ioShStringTable.append(inName);
+	ioShStringTable += '\0';
+}
+
+/****************************** WriteSyntheticElf *****************************/
+/*
+*	Writes an AVR elf file containing an empty .text and inNumSymbols symbols,
+*	the last of which are the Forwarder and Selector symbols.
+*/
+static bool WriteSyntheticElf(
+	const char*	inPath,
+	uint32_t	inNumSymbols)
+{
+	std::vector<SSymbolTblEntry>	symbolTable(1);	// Entry 0 is the null symbol
+	std::string	stringTable(1, '\0');
+	std::vector<std::string>	names;
+	for (uint32_t i = 0; i < inNumSymbols - eNumForwarderSymbols - eNumSelectorSymbols; i++)
+	{
+		names.push_back("_ZN14HardwareSerial5writeEh." + std::to_string(i));
+	}
+	names.insert(names.end(), kForwarderSymbols, &kForwarderSymbols[eNumForwarderSymbols]);
+	names.insert(names.end(), kSelectorSymbols, &kSelectorSymbols[eNumSelectorSymbols]);
+	for (const std::string& name : names)
+	{
+		SSymbolTblEntry	symbolTblEntry = {0};
+		symbolTblEntry.name = (uint32_t)stringTable.size();
+		symbolTblEntry.value = 0x800100 + (uint32_t)symbolTable.size()*2;
+		symbolTblEntry.size = 2;
+		symbolTblEntry.shndx = 1;
+		symbolTable.push_back(symbolTblEntry);
+		stringTable.append(name);
+		stringTable += '\0';
+	}
+	uint32_t	textOffset = sizeof(SElfHeader);
+	uint32_t	symbolTableOffset = textOffset + 4;
+	uint32_t	symbolTableSize = (uint32_t)(symbolTable.size() * sizeof(SSymbolTblEntry));
+	uint32_t	stringTableOffset = symbolTableOffset + symbolTableSize;
+	uint32_t	shStringTableOffset = stringTableOffset + (uint32_t)stringTable.size();
+	std::vector<SSectEntry>	sectTable;
+	std::string	shStringTable(1, '\0');
+	AppendSection(sectTable, shStringTable, "", 0, 0, 0, 0, 0);
+	AppendSection(sectTable, shStringTable, ".text", 1, textOffset, 4, 0, 0);
+	AppendSection(sectTable, shStringTable, ".symtab", 2, symbolTableOffset, symbolTableSize, sizeof(SSymbolTblEntry), 3);
+	AppendSection(sectTable, shStringTable, ".strtab", 3, stringTableOffset, (uint32_t)stringTable.size(), 0, 0);
+	AppendSection(sectTable, shStringTable, ".shstrtab", 3, shStringTableOffset, 0, 0, 0);
+	shStringTable.resize((shStringTable.size() + 3) & ~3);
+	sectTable.back().size = (uint32_t)shStringTable.size();
+	SElfHeader	header = {0};
+	header.magicNumber = 0x464c457f;
+	header.formatType = 1;
+	header.endianType = 1;
+	header.version = 1;
+	header.objFileType = 2;
+	header.isa = 0x53;
+	header.version1 = 1;
+	header.sectHdrOffset = shStringTableOffset + (uint32_t)shStringTable.size();
+	header.headerSize = sizeof(SElfHeader);
+	header.sectHdrSize = sizeof(SSectEntry);
+	header.numSectEntries = (uint16_t)sectTable.size();
+	header.sectEntryNamesIndex = (uint16_t)(sectTable.size() - 1);
+	static const uint8_t	kText[4] = {0};
+	FILE*	file = fopen(inPath, "wb");
+	bool	success = file != NULL;
+	if (success)
+	{
+		success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(kText, sizeof(kText), 1, file) == 1 &&
+			fwrite(symbolTable.data(), symbolTableSize, 1, file) == 1 &&
+			fwrite(stringTable.data(), stringTable.size(), 1, file) == 1 &&
+			fwrite(shStringTable.data(), shStringTable.size(), 1, file) == 1 &&
+			fwrite(sectTable.data(), sectTable.size() * sizeof(SSectEntry), 1, file) == 1;
+		success = fclose(file) == 0 && success;
+	}
+	return(success);
+}
+
+/*********************************** Report ***********************************/
+/*
+*	Prints the average time of a lookup by scanning and by the index, and the
+*	time FindSymbol takes to build the index on the first lookup.
+*/
+static void Report(
+	const char*	inPath,
+	const char*	inLabel)
+{
+	std::vector<const char*>	names(kForwarderSymbols, &kForwarderSymbols[eNumForwarderSymbols]);
+	names.insert(names.end(), kSelectorSymbols, &kSelectorSymbols[eNumSelectorSymbols]);
+	ElfFile	elfFile;
+	uint32_t	numSymbols = 0;
+	if (elfFile.ReadFile(inPath, true))
+	{
+		elfFile.GetSymbolTable(numSymbols);
+		double	buildTime = 0;
+		for (uint32_t repeat = 0; repeat < kRepeats/10; repeat++)
+		{
+			ElfFile	freshElfFile;
+			freshElfFile.ReadFile(inPath, true);
+			std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+			freshElfFile.FindSymbol(names[0]);
+			buildTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		}
+		buildTime /= kRepeats/10;
+		elfFile.FindSymbol(names[0]);	// Build the index
+		uint32_t	mismatches = 0;
+		uint32_t	found = 0;
+		for (const char* name : names)
+		{
+			const SSymbolTblEntry*	symbolTblEntry = elfFile.FindSymbol(name);
+			mismatches += symbolTblEntry != ScanForSymbol(elfFile, name);
+			found += symbolTblEntry != NULL;
+		}
+		double	lookupTime[2];
+		for (uint32_t useIndex = 0; useIndex < 2; useIndex++)
+		{
+			uint32_t	hits = 0;
+			std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+			for (uint32_t repeat = 0; repeat < kRepeats; repeat++)
+			{
+				for (const char* name : names)
+				{
+					hits += (useIndex ? elfFile.FindSymbol(name) : ScanForSymbol(elfFile, name)) != NULL;
+				}
+			}
+			lookupTime[useIndex] = std::chrono::duration<double, std::micro>(
+				std::chrono::steady_clock::now() - start).count() / (kRepeats * names.size());
+			mismatches += hits != found * kRepeats;
+		}
+		printf("%-20s %6u symbols: scan %8.3f us/lookup, index %6.3f us/lookup, index built in %7.1f us (%u of %u found)%s\n",
+			inLabel, numSymbols, lookupTime[0], lookupTime[1], buildTime, found, (uint32_t)names.size(),
+			mismatches ? " MISMATCH" : "");
+	} else
+	{
+		printf("%s: not a readable elf file\n", inPath);
+	}
+}
+
+/************************************ main ************************************/
+int main(
+	int		inArgc,
+	char*	inArgv[])
+{
+	printf("Symbol lookup, the Forwarder and Selector symbols:\n");
+	if (inArgc > 1)
+	{
+		for (int argIndex = 1; argIndex < inArgc; argIndex++)
+		{
+			const char*	name = strrchr(inArgv[argIndex], '/');
+			Report(inArgv[argIndex], name ? name + 1 : inArgv[argIndex]);
+		}
+	} else
+	{
+		const char*	tempFolder = getenv("TMPDIR");
+		std::string	path(tempFolder && *tempFolder ? tempFolder : "/tmp");
+		path.append("/SymbolLookupBench.XXXXXX");
+		int	fd = mkstemp(&path[0]);
+		if (fd >= 0)
+		{
+			close(fd);
+			for (uint32_t numSymbols : kSymbolTableSizes)
+			{
+				if (WriteSyntheticElf(path.c_str(), numSymbols))
+				{
+					Report(path.c_str(), "synthetic");
+				}
+			}
+			unlink(path.c_str());
+		}
+	}
+	return(0);
+}
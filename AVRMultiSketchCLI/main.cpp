@@ -0,0 +1,399 @@
+/*******************************************************************************
+	License
+	****************************************************************************
+	This program is free software; you can redistribute it
+	and/or modify it under the terms of the GNU General
+	Public License as published by the Free Software
+	Foundation; either version 3 of the License, or
+	(at your option) any later version.
+ 
+	This program is distributed in the hope that it will
+	be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A
+	PARTICULAR PURPOSE. See the GNU General Public
+	License for more details.
+ 
+	Licence can be viewed at
+	http://www.gnu.org/licenses/gpl-3.0.txt
+
+	Please maintain this license information along with authorship
+	and copyright notices in any redistribution of this code
+*******************************************************************************/
+//  main.cpp
+//  AVRMultiSketchCLI
+//
+//  Copyright © 2018 Jon Mackey. All rights reserved.
+//
+/*
+*	Builds the combined hex and eep files of one or more sketch sets without
+*	the application, e.g. on a build server.  The sketch sets are described by
+*	a JSON manifest:
+*
+*	{
+*		"workFolder": "work",
+*		"cacheFolder": "cache",
+*		"cacheMaxSize": 256,
+*		"outputFolder": "out",
+*		"threads": 4,
+*		"sets": [
+*			{
+*				"name": "MultiSketch",
+*				"fqbn": "arduino:avr:uno",
+*				"coreCacheFolder": "arduino_cache_12345",
+*				"sketches": [
+*					{"name": "Forwarder.ino", "buildFolder": "arduino_build_1"},
+*					{"name": "Selector.ino", "buildFolder": "arduino_build_2"},
+*					{"buildFolder": "arduino_build_3"}
+*				]
+*			}
+*		]
+*	}
+*
+*	Relative paths are relative to the manifest's folder.  Only "sets",
+*	"sketches", and each sketch's "buildFolder" are required.  If a sketch's
+*	name is omitted it's taken from the single .elf file in its build folder.
+*	The sketches of a set are in flash order: the Forwarder, the Selector, then
+*	the sub sketches.  Each set's files are written to the output folder as
+*	<name>.hex and <name>.eep.  After the sets are built, the least recently
+*	used entries of the build cache are removed to keep it within
+*	cacheMaxSize megabytes (256 if omitted.)
+*
+*	The sets are built one after the other.  The board configurations, the
+*	worker pool, the build cache, and the hardware index are shared by all of
+*	the sets.
+*/
+
+#include "BoardSnapshots.h"
+#include "BuildCache.h"
+#include "BuildTrace.h"
+#include "ConfigurationFile.h"
+#include "FileInputBuffer.h"
+#include "FileStager.h"
+#include "HardwareIndex.h"
+#include "JSONElement.h"
+#include "LogSink.h"
+#include "SketchSetBuilder.h"
+#include "WorkerPool.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+static const char kUsage[] =
+	"usage: AVRMultiSketchCLI [-j threads] [-c cacheFolder] [-w workFolder] [-t trace.json] manifest.json\n"
+	"  -j  the number of sketches linked concurrently (default: one per hardware thread)\n"
+	"  -c  the build cache folder, overrides the manifest's cacheFolder\n"
+	"  -w  the work folder, overrides the manifest's workFolder\n"
+	"  -t  write a Chrome trace of the build's stages and print a summary\n";
+
+/******************************** ResolvePath *********************************/
+static std::string ResolvePath(
+	const std::string&	inBaseFolder,
+	const std::string&	inPath)
+{
+	return((inPath.empty() || inPath[0] == '/') ? inPath : (inBaseFolder + "/" + inPath));
+}
+
+/********************************* GetString **********************************/
+static std::string GetString(
+	const JSONObject*	inObject,
+	const char*			inKey)
+{
+	JSONString*	jsonString = (JSONString*)inObject->GetElement(inKey, IJSONElement::eString);
+	return(jsonString ? jsonString->GetString() : std::string());
+}
+
+/******************************* FindSketchName *******************************/
+/*
+*	Returns the name of the sketch built in inBuildFolder, e.g. Blink.ino for
+*	Blink.ino.elf, or an empty string if there isn't exactly one elf file.
+*/
+static std::string FindSketchName(
+	const std::string&	inBuildFolder)
+{
+	std::string	sketchName;
+	uint32_t	elfFilesFound = 0;
+	DIR*	dir = opendir(inBuildFolder.c_str());
+	if (dir)
+	{
+		struct dirent*	entry;
+		while ((entry = readdir(dir)) != NULL)
+		{
+			size_t	nameLen = strlen(entry->d_name);
+			if (nameLen > 4 &&
+				strcmp(&entry->d_name[nameLen - 4], ".elf") == 0)
+			{
+				sketchName.assign(entry->d_name, nameLen - 4);
+				elfFilesFound++;
+			}
+		}
+		closedir(dir);
+	}
+	if (elfFilesFound != 1)
+	{
+		sketchName.clear();
+	}
+	return(sketchName);
+}
+
+/******************************* WriteLogEvents *******************************/
+/*
+*	Writes each event to stderr as [time] message, or [time] Error: message.
+*	If events were dropped since the last call, the number dropped is written.
+*/
+static void WriteLogEvents(
+	const LogEvents&	inEvents,
+	const LogSink&		inLogSink,
+	uint64_t&			ioDroppedReported)
+{
+	for (const SLogEvent& event : inEvents)
+	{
+		time_t	seconds = std::chrono::system_clock::to_time_t(event.time);
+		uint32_t	milliseconds = (uint32_t)(std::chrono::duration_cast<std::chrono::milliseconds>(
+			event.time.time_since_epoch()).count() % 1000);
+		struct tm	localTime;
+		localtime_r(&seconds, &localTime);
+		fprintf(stderr, "[%02d:%02d:%02d.%03u] %s%s\n", localTime.tm_hour, localTime.tm_min,
+			localTime.tm_sec, milliseconds,
+			event.level == eLogError ? "Error: " : (event.level == eLogWarning ? "Warning: " : ""),
+			event.message.c_str());
+	}
+	uint64_t	droppedCount = inLogSink.GetDroppedCount();
+	if (droppedCount > ioDroppedReported)
+	{
+		fprintf(stderr, "%llu log messages dropped.\n", (unsigned long long)(droppedCount - ioDroppedReported));
+		ioDroppedReported = droppedCount;
+	}
+}
+
+/************************************ main ************************************/
+int main(
+	int		argc,
+	char*	argv[])
+{
+	uint32_t	numThreads = 0;
+	std::string	cacheFolder;
+	std::string	workFolder;
+	std::string	tracePath;
+	bool	threadsSet = false;
+	int		option;
+	setvbuf(stdout, NULL, _IOLBF, 0);	// Keep stdout and stderr in order
+	while ((option = getopt(argc, argv, "j:c:w:t:")) != -1)
+	{
+		switch (option)
+		{
+			case 'j':
+				numThreads = (uint32_t)atoi(optarg);
+				threadsSet = true;
+				break;
+			case 'c':
+				cacheFolder.assign(optarg);
+				break;
+			case 'w':
+				workFolder.assign(optarg);
+				break;
+			case 't':
+				tracePath.assign(optarg);
+				break;
+			default:
+				fputs(kUsage, stderr);
+				return(2);
+		}
+	}
+	if (optind != argc - 1)
+	{
+		fputs(kUsage, stderr);
+		return(2);
+	}
+	std::string	manifestPath(argv[optind]);
+	std::string	manifestFolder(".");
+	size_t	lastSlash = manifestPath.rfind('/');
+	if (lastSlash != std::string::npos)
+	{
+		manifestFolder.assign(manifestPath, 0, lastSlash);
+	}
+	FileInputBuffer	manifestInput(manifestPath.c_str());
+	JSONObject*	manifest = manifestInput.IsValid() ? (JSONObject*)IJSONElement::Create(manifestInput) : NULL;
+	JSONArray*	sets = NULL;
+	if (manifest &&
+		manifest->IsJSONObject())
+	{
+		sets = (JSONArray*)manifest->GetElement("sets", IJSONElement::eArray);
+	}
+	if (!sets)
+	{
+		fprintf(stderr, "Unable to read the sketch sets from %s\n", manifestPath.c_str());
+		delete manifest;
+		return(1);
+	}
+	if (workFolder.empty())
+	{
+		workFolder = ResolvePath(manifestFolder, GetString(manifest, "workFolder"));
+		if (workFolder.empty())
+		{
+			workFolder.assign("/tmp/AVRMultiSketch");
+		}
+	}
+	if (cacheFolder.empty())
+	{
+		cacheFolder = ResolvePath(manifestFolder, GetString(manifest, "cacheFolder"));
+	}
+	std::string	outputFolder(ResolvePath(manifestFolder, GetString(manifest, "outputFolder")));
+	if (outputFolder.empty())
+	{
+		outputFolder.assign(manifestFolder);
+	}
+	JSONNumber*	threads = (JSONNumber*)manifest->GetElement("threads", IJSONElement::eNumber);
+	if (threads && !threadsSet)
+	{
+		numThreads = (uint32_t)threads->GetValue();
+	}
+
+	BoardsConfigFiles	configFiles;
+	WorkerPool			workerPool(numThreads);
+	BuildCache			buildCache;
+	if (!cacheFolder.empty() &&
+		FileStager::MakeFolders(cacheFolder))
+	{
+		buildCache.SetFolder(cacheFolder);
+		JSONNumber*	cacheMaxSize = (JSONNumber*)manifest->GetElement("cacheMaxSize", IJSONElement::eNumber);
+		if (cacheMaxSize)
+		{
+			buildCache.SetMaxSize((uint64_t)cacheMaxSize->GetValue() * 1024 * 1024);
+		}
+	}
+	/*
+	*	The hardware index and board snapshots are kept with the build cache,
+	*	or in the work folder if there's no cache, so that later runs don't
+	*	walk the hardware packages or parse the boards.txt files again.
+	*/
+	HardwareIndex		hardwareIndex;
+	BoardSnapshots		boardSnapshots;
+	std::string	indexFolder(buildCache.IsEnabled() ? cacheFolder : workFolder);
+	if (FileStager::MakeFolders(indexFolder))
+	{
+		hardwareIndex.SetFilePath(indexFolder + "/HardwareIndex.txt");
+		boardSnapshots.SetFolder(indexFolder);
+	}
+	LogSink				logSink;
+	SketchSetBuilder	builder(configFiles, workerPool, buildCache, hardwareIndex, boardSnapshots, logSink);
+	/*
+	*	The log is drained to stderr on its own thread so that the sketches
+	*	being built never wait on the output.
+	*/
+	std::atomic<bool>	stopLogging(false);
+	std::thread	logThread([&logSink, &stopLogging]()
+	{
+		LogEvents	events;
+		uint64_t	droppedReported = 0;
+		bool		stopping;
+		do
+		{
+			stopping = stopLogging;
+			events.clear();
+			logSink.Drain(events);
+			WriteLogEvents(events, logSink, droppedReported);
+			if (!stopping)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(16));
+			}
+		} while (!stopping);
+	});
+	if (!tracePath.empty())
+	{
+		BuildTrace::Start();
+	}
+	uint32_t	setsFailed = 0;
+	bool	outputFolderExists = FileStager::MakeFolders(outputFolder);
+	if (!outputFolderExists)
+	{
+		fprintf(stderr, "Unable to create the output folder %s\n", outputFolder.c_str());
+	}
+	const JSONElementVec&	setVec = sets->GetVec();
+	for (size_t setIndex = 0; outputFolderExists && setIndex < setVec.size(); setIndex++)
+	{
+		const JSONObject*	set = (const JSONObject*)setVec[setIndex];
+		JSONArray*	sketches = set->IsJSONObject() ?
+			(JSONArray*)set->GetElement("sketches", IJSONElement::eArray) : NULL;
+		std::string	setName;
+		if (sketches)
+		{
+			setName = GetString(set, "name");
+		}
+		if (setName.empty())
+		{
+			setName = "set" + std::to_string(setIndex + 1);
+		}
+		SketchDescs	sketchDescs;
+		bool	success = sketches != NULL;
+		if (success)
+		{
+			const JSONElementVec&	sketchVec = sketches->GetVec();
+			for (size_t sketchIndex = 0; success && sketchIndex < sketchVec.size(); sketchIndex++)
+			{
+				const JSONObject*	sketch = (const JSONObject*)sketchVec[sketchIndex];
+				SSketchDesc	sketchDesc;
+				success = sketch->IsJSONObject();
+				if (success)
+				{
+					sketchDesc.buildFolder = ResolvePath(manifestFolder, GetString(sketch, "buildFolder"));
+					sketchDesc.name = GetString(sketch, "name");
+					if (sketchDesc.name.empty())
+					{
+						sketchDesc.name = FindSketchName(sketchDesc.buildFolder);
+					}
+					success = !sketchDesc.buildFolder.empty() && !sketchDesc.name.empty();
+				}
+				if (success)
+				{
+					sketchDescs.push_back(sketchDesc);
+				} else
+				{
+					logSink.Push(eLogError, "Manifest", std::string(), setName + ": sketch " +
+						std::to_string(sketchIndex + 1) + " needs a buildFolder containing a single elf file or a name.");
+				}
+			}
+		} else
+		{
+			logSink.Push(eLogError, "Manifest", std::string(), setName + ": no sketches.");
+		}
+		if (success)
+		{
+			logSink.Push(eLogInfo, "Build", std::string(), "Building " + setName);
+			success = builder.Build(sketchDescs, GetString(set, "fqbn"),
+				ResolvePath(manifestFolder, GetString(set, "coreCacheFolder")),
+				workFolder + "/" + setName,
+				outputFolder + "/" + setName + ".hex",
+				outputFolder + "/" + setName + ".eep");
+			if (success)
+			{
+				logSink.Push(eLogInfo, "Build", std::string(), setName + ": " +
+					std::to_string(builder.GetFlashUsed()) + " bytes of flash used.");
+			}
+		}
+		if (!success)
+		{
+			logSink.Push(eLogError, "Build", std::string(), setName + " failed.");
+			setsFailed++;
+		}
+	}
+	buildCache.Prune();
+	stopLogging = true;
+	logThread.join();
+	if (!tracePath.empty())
+	{
+		BuildTrace::Stop();
+		std::string	summary;
+		BuildTrace::GetSummary(summary);
+		printf("%s\n", summary.c_str());
+		if (!BuildTrace::WriteChromeTrace(tracePath.c_str()))
+		{
+			fprintf(stderr, "Unable to write the trace file %s\n", tracePath.c_str());
+		}
+	}
+	delete manifest;
+	return((setsFailed || !outputFolderExists) ? 1 : 0);
+}